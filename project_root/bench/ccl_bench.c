@@ -0,0 +1,124 @@
+// ccl_bench.c
+// Agreement and timing of the connected component labelers.
+//
+//   make bench
+//   OCR_THREADS=4 ./bench/ccl_bench [iterations] image...    (e.g. TestImages/*.png)
+//
+// Each image is binarized with Otsu and labeled with the serial run
+// labeler and with the strip-parallel one; both lists must be identical
+// (same components, same order). Exits with 1 on any difference.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../components/components.h"
+#include "../gray_image/gray_image.h"
+#include "../image_cleaner/image_cleaner.h"
+#include "../thread_pool/thread_pool.h"
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Default Auto Process binarization: luminance and histogram in one pass, then Otsu
+static GrayImage *binarize_page(SDL_Surface *s, BitImage **mask)
+{
+    int histogram[GRAY_LEVELS];
+    GrayImage *g = gray_from_surface_hist(s, histogram);
+    if (g) apply_otsu_thresholding_hist(g, histogram, mask);
+    return g;
+}
+
+typedef int (*label_fn)(const GrayImage *, ComponentList *);
+
+static double time_label(label_fn fn, const GrayImage *g, int iters, ComponentList *out)
+{
+    double t0 = now_sec();
+    for (int i = 0; i < iters; ++i) {
+        components_free(out);
+        fn(g, out);
+    }
+    return (now_sec() - t0) * 1e3 / iters;
+}
+
+static int same_field(const void *a, const void *b, int n, size_t size)
+{
+    return n == 0 || memcmp(a, b, (size_t)n * size) == 0;
+}
+
+static int same_list(const ComponentList *a, const ComponentList *b)
+{
+    int n = a->n;
+    return a->n == b->n
+        && same_field(a->minx, b->minx, n, sizeof(int))
+        && same_field(a->maxx, b->maxx, n, sizeof(int))
+        && same_field(a->miny, b->miny, n, sizeof(int))
+        && same_field(a->maxy, b->maxy, n, sizeof(int))
+        && same_field(a->area, b->area, n, sizeof(int))
+        && same_field(a->cx, b->cx, n, sizeof(float))
+        && same_field(a->cy, b->cy, n, sizeof(float))
+        && same_field(a->mx, b->mx, n, sizeof(float))
+        && same_field(a->my, b->my, n, sizeof(float));
+}
+
+int main(int argc, char **argv)
+{
+    int first = 1, iters = 10;
+    if (argc > 1 && atoi(argv[1]) > 0) {
+        iters = atoi(argv[1]);
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [iterations] image...\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+    printf("%d thread(s)\n", thread_pool_size());
+    printf("%-24s %8s | %8s %8s  (ms)\n", "image", "comps", "serial", "strips");
+
+    for (int a = first; a < argc; ++a) {
+        SDL_Surface *in = IMG_Load(argv[a]);
+        if (!in) {
+            fprintf(stderr, "ccl_bench: cannot load %s\n", argv[a]);
+            continue;
+        }
+        SDL_Surface *s = SDL_ConvertSurfaceFormat(in, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(in);
+        if (!s) continue;
+
+        GrayImage *g = binarize_page(s, NULL);
+        SDL_FreeSurface(s);
+        if (!g) continue;
+
+        ComponentList ser, par;
+        memset(&ser, 0, sizeof(ser));
+        memset(&par, 0, sizeof(par));
+        double ms_ser = time_label(components_label_serial, g, iters, &ser);
+        double ms_par = time_label(components_label_strips, g, iters, &par);
+        int ok = same_list(&ser, &par);
+        if (!ok) failures++;
+
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        printf("%-24s %8d | %8.2f %8.2f%s\n", name, ser.n, ms_ser, ms_par,
+               ok ? "" : "  MISMATCH");
+
+        components_free(&ser);
+        components_free(&par);
+        gray_free(g);
+    }
+
+    if (failures) {
+        printf("%d image(s) labeled differently\n", failures);
+        return 1;
+    }
+    printf("all labelings agree\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+// denoise_bench.c
+// A/B check and timing of the 3x3 noise removal implementations.
+//
+//   make bench
+//   ./bench/denoise_bench [image] [iterations]
+//
+// Binarizes the image (or a random speckled page when no image is given),
+// then runs apply_noise_removal (32-bit surface), apply_noise_removal_gray
+// (packed rows over the gray plane) and bit_noise_removal (packed bitmap)
+// for every threshold 0..9, checks that the three outputs are identical
+// and reports MPixel/s for each.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../gray_image/gray_image.h"
+#include "../image_cleaner/image_cleaner.h"
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Default Auto Process binarization: luminance and histogram in one pass, then Otsu
+static GrayImage *binarize_page(SDL_Surface *s, BitImage **mask)
+{
+    int histogram[GRAY_LEVELS];
+    GrayImage *g = gray_from_surface_hist(s, histogram);
+    if (g) apply_otsu_thresholding_hist(g, histogram, mask);
+    return g;
+}
+
+static GrayImage *random_page(int w, int h)
+{
+    GrayImage *img = gray_create(w, h);
+    if (!img) return NULL;
+    unsigned seed = 42u;
+    for (int y = 0; y < h; ++y) {
+        Uint8 *row = gray_row(img, y);
+        for (int x = 0; x < w; ++x) {
+            seed = seed * 1103515245u + 12345u;
+            row[x] = ((seed >> 16) & 7) == 0 ? 0 : 255;
+        }
+    }
+    return img;
+}
+
+/* Number of pixels where the surface and the plane disagree on black. */
+static long diff_surface(SDL_Surface *s, const GrayImage *g)
+{
+    long bad = 0;
+    for (int y = 0; y < g->h; ++y) {
+        const Uint32 *row = (const Uint32*)((const Uint8*)s->pixels
+                                            + (size_t)y * s->pitch);
+        const Uint8 *ref = gray_row(g, y);
+        for (int x = 0; x < g->w; ++x) {
+            Uint8 r, gg, b;
+            SDL_GetRGB(row[x], s->format, &r, &gg, &b);
+            if ((r == 0) != (ref[x] == 0)) bad++;
+        }
+    }
+    return bad;
+}
+
+static long diff_bits(const BitImage *bits, const GrayImage *g)
+{
+    long bad = 0;
+    for (int y = 0; y < g->h; ++y) {
+        const Uint64 *row = bit_row(bits, y);
+        const Uint8 *ref = gray_row(g, y);
+        for (int x = 0; x < g->w; ++x)
+            if ((int)((row[x >> 6] >> (x & 63)) & 1) != (ref[x] == 0)) bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    int iters = argc > 2 ? atoi(argv[2]) : 5;
+    if (iters <= 0) iters = 1;
+
+    GrayImage *page = NULL;
+    if (argc > 1) {
+        SDL_Surface *in = IMG_Load(argv[1]);
+        if (!in) {
+            fprintf(stderr, "denoise_bench: cannot load %s\n", argv[1]);
+            return 1;
+        }
+        page = binarize_page(in, NULL);
+        SDL_FreeSurface(in);
+    } else {
+        page = random_page(2480, 3508);
+    }
+    if (!page) return 1;
+
+    double mpix = (double)page->w * page->h / 1e6;
+    printf("noise removal %dx%d, %d iterations\n", page->w, page->h, iters);
+
+    int status = 0;
+    for (int t = 0; t <= 9; ++t) {
+        double t_surf = 0, t_gray = 0, t_bits = 0;
+        long bad_surf = 0, bad_bits = 0;
+
+        for (int i = 0; i < iters; ++i) {
+            SDL_Surface *s = gray_to_new_surface(page);
+            GrayImage *g = gray_clone(page);
+            BitImage *b = bit_from_gray(page);
+            if (!s || !g || !b) return 1;
+
+            double t0 = now_sec();
+            apply_noise_removal(s, t);
+            double t1 = now_sec();
+            apply_noise_removal_gray(g, t);
+            double t2 = now_sec();
+            bit_noise_removal(b, t);
+            double t3 = now_sec();
+
+            t_surf += t1 - t0;
+            t_gray += t2 - t1;
+            t_bits += t3 - t2;
+            bad_surf += diff_surface(s, g);
+            bad_bits += diff_bits(b, g);
+
+            SDL_FreeSurface(s);
+            gray_free(g);
+            bit_free(b);
+        }
+
+        printf("  threshold %d: surface %7.1f  gray %7.1f  bits %7.1f MPixel/s%s\n",
+               t, mpix * iters / t_surf, mpix * iters / t_gray,
+               mpix * iters / t_bits,
+               (bad_surf || bad_bits) ? "  MISMATCH" : "");
+        if (bad_surf || bad_bits) status = 1;
+    }
+
+    gray_free(page);
+    return status;
+}
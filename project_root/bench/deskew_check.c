@@ -0,0 +1,103 @@
+// deskew_check.c
+// Agreement and timing of the deskew Hough kernels.
+//
+//   make bench
+//   ./bench/deskew_check image...    (e.g. TestImages/*.png)
+//
+// Each image is binarized with Otsu, then also rotated by a few extra
+// angles. The deskew angle is estimated with the fixed-point parallel
+// kernel and with the double precision reference; they must agree within
+// 0.1 degree. Exits with 1 on any disagreement.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gray_image/gray_image.h"
+#include "../image_cleaner/image_cleaner.h"
+#include "../rotation/rotation.h"
+
+#define MAX_DIFF 0.1
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Default Auto Process binarization: luminance and histogram in one pass, then Otsu
+static GrayImage *binarize_page(SDL_Surface *s, BitImage **mask)
+{
+    int histogram[GRAY_LEVELS];
+    GrayImage *g = gray_from_surface_hist(s, histogram);
+    if (g) apply_otsu_thresholding_hist(g, histogram, mask);
+    return g;
+}
+
+static double estimate(const GrayImage *g, DeskewHough mode, double *ms)
+{
+    set_deskew_hough(mode);
+    double t0 = now_sec();
+    double angle = auto_deskew_correction_gray(g);
+    *ms = (now_sec() - t0) * 1e3;
+    return angle;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s image...\n", argv[0]);
+        return 1;
+    }
+
+    static const double extra[] = { 0.0, 2.3, -7.5, 15.0 };
+    int failures = 0;
+
+    printf("%-24s %6s | %8s %8s | %8s %8s\n", "image", "rot",
+           "double", "ms", "fixed", "ms");
+
+    for (int a = 1; a < argc; ++a) {
+        SDL_Surface *in = IMG_Load(argv[a]);
+        if (!in) {
+            fprintf(stderr, "deskew_check: cannot load %s\n", argv[a]);
+            continue;
+        }
+        SDL_Surface *s = SDL_ConvertSurfaceFormat(in, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(in);
+        if (!s) continue;
+
+        GrayImage *g = binarize_page(s, NULL);
+        SDL_FreeSurface(s);
+        if (!g) continue;
+
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        for (size_t k = 0; k < sizeof(extra) / sizeof(extra[0]); ++k) {
+            GrayImage *r = extra[k] != 0.0
+                ? rotate_gray_ex(g, extra[k], ROTATE_NEAREST, 0) : g;
+            if (!r) continue;
+
+            double ms_ref, ms_fix;
+            double ref = estimate(r, DESKEW_HOUGH_DOUBLE, &ms_ref);
+            double fix = estimate(r, DESKEW_HOUGH_FIXED, &ms_fix);
+            int ok = fabs(ref - fix) <= MAX_DIFF + 1e-9;
+            if (!ok) failures++;
+
+            printf("%-24s %6.1f | %8.2f %8.1f | %8.2f %8.1f%s\n", name, extra[k],
+                   ref, ms_ref, fix, ms_fix, ok ? "" : "  MISMATCH");
+            if (r != g) gray_free(r);
+        }
+        gray_free(g);
+    }
+
+    set_deskew_hough(DESKEW_HOUGH_FIXED);
+    if (failures) {
+        printf("%d disagreement(s) above %.1f degree\n", failures, MAX_DIFF);
+        return 1;
+    }
+    printf("all estimates agree within %.1f degree\n", MAX_DIFF);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// export_check.c
+// Round trip of the 'grid' export file with several puzzles.
+//
+//   make bench
+//   ./bench/export_check [path]      (default: export_check.grid, removed)
+//
+// Two puzzles of different sizes are written with write_grid_block, as
+// the pipeline does for a page with two grids, and read back with
+// read_grid_blocks: both blocks must come back with their size, letters
+// (unread cells as '?') and words. read_grid_from_file must still return
+// the first grid. Exits with 1 on any difference.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../solver/solver.h"
+
+typedef struct {
+    int rows, cols;
+    const char *cells;   // rows * cols letters, row-major
+    const char *expect;  // cells as read back
+    const char *words[4];
+    int n_words;
+} Sample;
+
+static const Sample samples[] = {
+    { 3, 4, "CATSOWLEDOGX", "CATSOWLEDOGX", { "CAT", "OWL", "DOG" }, 3 },
+    { 5, 2, "AB?DEF1HIJ", "AB?DEF?HIJ", { "ADE", "BIJ" }, 2 },
+};
+#define N_SAMPLES (int)(sizeof(samples) / sizeof(samples[0]))
+
+static int write_sample(FILE *f, const Sample *s)
+{
+    char rowbuf[8][8];
+    char *grid[8];
+    for (int i = 0; i < s->rows; ++i) {
+        memcpy(rowbuf[i], s->cells + i * s->cols, (size_t)s->cols);
+        grid[i] = rowbuf[i];
+    }
+    return write_grid_block(f, grid, s->rows, s->cols, (char **)s->words,
+                            s->n_words);
+}
+
+static int check_block(int b, const GridBlock *g, const Sample *s)
+{
+    int bad = 0;
+    if (g->rows != s->rows || g->cols != s->cols) {
+        printf("block %d: size %dx%d, expected %dx%d\n", b, g->rows, g->cols,
+               s->rows, s->cols);
+        return 1;
+    }
+    for (int i = 0; i < s->rows; ++i)
+        for (int j = 0; j < s->cols; ++j)
+            if (g->grid[i][j] != s->expect[i * s->cols + j]) {
+                printf("block %d: cell (%d,%d) '%c', expected '%c'\n", b, i, j,
+                       g->grid[i][j], s->expect[i * s->cols + j]);
+                bad = 1;
+            }
+    if (g->n_words != s->n_words) {
+        printf("block %d: %d words, expected %d\n", b, g->n_words, s->n_words);
+        return 1;
+    }
+    for (int w = 0; w < s->n_words; ++w)
+        if (strcmp(g->words[w], s->words[w]) != 0) {
+            printf("block %d: word %d '%s', expected '%s'\n", b, w,
+                   g->words[w], s->words[w]);
+            bad = 1;
+        }
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "export_check.grid";
+    int failures = 0;
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("export_check: fopen");
+        return 1;
+    }
+    for (int p = 0; p < N_SAMPLES; ++p)
+        if (write_sample(f, &samples[p]) != 0) failures++;
+    fclose(f);
+
+    GridBlock *blocks = NULL;
+    int count = 0;
+    if (read_grid_blocks(path, &blocks, &count) != 0) {
+        printf("read_grid_blocks failed\n");
+        failures++;
+    } else if (count != N_SAMPLES) {
+        printf("%d blocks read, expected %d\n", count, N_SAMPLES);
+        failures++;
+    } else {
+        for (int b = 0; b < count; ++b)
+            failures += check_block(b, &blocks[b], &samples[b]);
+    }
+    free_grid_blocks(blocks, count);
+
+    int rows = 0, cols = 0;
+    char **first = read_grid_from_file(path, &rows, &cols);
+    if (!first || rows != samples[0].rows || cols != samples[0].cols ||
+        memcmp(first[0], samples[0].expect, (size_t)cols) != 0) {
+        printf("read_grid_from_file: first grid differs\n");
+        failures++;
+    }
+    freeMatrix(first, rows);
+
+    if (argc <= 1) remove(path);
+    if (failures) {
+        printf("export_check: %d difference(s)\n", failures);
+        return 1;
+    }
+    printf("export_check: %d puzzles round trip\n", N_SAMPLES);
+    return 0;
+}
@@ -0,0 +1,144 @@
+// gray_bench.c
+// Micro-benchmark of the grayscale conversion kernels.
+//
+//   make bench
+//   ./bench/gray_bench [width] [height] [iterations]
+//
+// Reports MPixel/s for the legacy double/SDL_GetRGB loop and for every
+// fixed-point kernel the CPU supports, on ARGB8888 and RGBA8888 pages,
+// and checks that all the kernels produce the same bytes.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gray_image/gray_image.h"
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Scanned-page-like content: mostly light paper, some dark ink, a few
+ * transparent pixels to exercise the alpha folding. */
+static void fill_page(SDL_Surface *s, unsigned seed)
+{
+    const SDL_PixelFormat *f = s->format;
+    for (int y = 0; y < s->h; ++y) {
+        Uint32 *row = (Uint32*)((Uint8*)s->pixels + (size_t)y * s->pitch);
+        for (int x = 0; x < s->w; ++x) {
+            seed = seed * 1103515245u + 12345u;
+            Uint8 base = (seed >> 24) < 40 ? 20 : 230;
+            Uint8 r = (Uint8)(base + ((seed >> 8) & 15));
+            Uint8 g = (Uint8)(base + ((seed >> 12) & 15));
+            Uint8 b = (Uint8)(base + ((seed >> 16) & 15));
+            Uint8 a = ((seed >> 4) & 255) < 4 ? 0 : 255;
+            row[x] = ((Uint32)r << f->Rshift) | ((Uint32)g << f->Gshift)
+                   | ((Uint32)b << f->Bshift) | ((Uint32)a << f->Ashift);
+        }
+    }
+}
+
+/* What convert_to_grayscale() used to do per pixel. */
+static void legacy_convert(SDL_Surface *s, Uint8 *out)
+{
+    for (int y = 0; y < s->h; ++y) {
+        const Uint32 *row = (const Uint32*)((const Uint8*)s->pixels
+                                            + (size_t)y * s->pitch);
+        for (int x = 0; x < s->w; ++x) {
+            Uint8 r, g, b;
+            SDL_GetRGB(row[x], s->format, &r, &g, &b);
+            out[(size_t)y * s->w + x] = (Uint8)(0.299*r + 0.587*g + 0.114*b);
+        }
+    }
+}
+
+static void kernel_convert(SDL_Surface *s, Uint8 *out)
+{
+    for (int y = 0; y < s->h; ++y) {
+        const Uint32 *row = (const Uint32*)((const Uint8*)s->pixels
+                                            + (size_t)y * s->pitch);
+        gray_luma_row(row, out + (size_t)y * s->w, s->w, s->format, 1);
+    }
+}
+
+static void report(const char *layout, const char *name, double sec,
+                   long long pixels, int iters)
+{
+    double mpix = (double)pixels * iters / sec / 1e6;
+    printf("  %-10s %-8s %8.1f MPixel/s\n", layout, name, mpix);
+}
+
+static int bench_layout(Uint32 format, const char *layout, int w, int h, int iters)
+{
+    static const GrayLumaKernel kernels[] = {
+        GRAY_LUMA_SCALAR, GRAY_LUMA_SSE2, GRAY_LUMA_AVX2
+    };
+
+    SDL_Surface *s = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, format);
+    if (!s) {
+        fprintf(stderr, "gray_bench: %s\n", SDL_GetError());
+        return -1;
+    }
+    fill_page(s, 1234u);
+
+    long long pixels = (long long)w * h;
+    Uint8 *ref = malloc((size_t)pixels);
+    Uint8 *out = malloc((size_t)pixels);
+    if (!ref || !out) {
+        free(ref);
+        free(out);
+        SDL_FreeSurface(s);
+        return -1;
+    }
+
+    double t0 = now_sec();
+    for (int i = 0; i < iters; ++i) legacy_convert(s, out);
+    report(layout, "legacy", now_sec() - t0, pixels, iters);
+
+    int status = 0;
+    for (size_t k = 0; k < sizeof kernels / sizeof kernels[0]; ++k) {
+        if (gray_luma_select(kernels[k]) != 0) continue;
+
+        Uint8 *dst = (kernels[k] == GRAY_LUMA_SCALAR) ? ref : out;
+        kernel_convert(s, dst);                       // warm-up
+        t0 = now_sec();
+        for (int i = 0; i < iters; ++i) kernel_convert(s, dst);
+        report(layout, gray_luma_name(), now_sec() - t0, pixels, iters);
+
+        if (dst != ref && memcmp(ref, dst, (size_t)pixels) != 0) {
+            fprintf(stderr, "gray_bench: %s differs from scalar on %s\n",
+                    gray_luma_name(), layout);
+            status = -1;
+        }
+    }
+
+    free(ref);
+    free(out);
+    SDL_FreeSurface(s);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    int w     = argc > 1 ? atoi(argv[1]) : 2480;     // A4 at 300 dpi
+    int h     = argc > 2 ? atoi(argv[2]) : 3508;
+    int iters = argc > 3 ? atoi(argv[3]) : 10;
+    if (w <= 0 || h <= 0 || iters <= 0) {
+        fprintf(stderr, "usage: %s [width] [height] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    printf("grayscale %dx%d, %d iterations\n", w, h, iters);
+    int status = 0;
+    if (bench_layout(SDL_PIXELFORMAT_ARGB8888, "ARGB8888", w, h, iters) != 0) status = 1;
+    if (bench_layout(SDL_PIXELFORMAT_RGBA8888, "RGBA8888", w, h, iters) != 0) status = 1;
+
+    gray_luma_select(GRAY_LUMA_AUTO);
+    printf("auto-selected kernel: %s\n", gray_luma_name());
+    return status;
+}
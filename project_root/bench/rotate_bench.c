@@ -0,0 +1,194 @@
+// rotate_bench.c
+// Timing and agreement of the rotation paths on binarized pages.
+//
+//   make bench
+//   ./bench/rotate_bench [iterations] image...    (e.g. TestImages/*.png)
+//
+// Each image is binarized with Otsu, then rotated by its deskew angle and
+// by 5 and 25 degrees with every path: 2D mapping (nearest / bilinear) and
+// three shears, on the 32 bpp surface, on the gray plane and on the packed
+// bitmap. Reports milliseconds per rotation.
+//
+// The three-shear results on the gray plane and on the bitmap are also
+// checked against the nearest 2D mapping (rotate_gray_ex, ROTATE_NEAREST),
+// cropped and expanded: sizes must match exactly, at most MAX_DIFF of the
+// pixels may differ and at most MAX_FAR may be farther than one pixel from
+// a matching one. Exits with 1 on any mismatch.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gray_image/gray_image.h"
+#include "../image_cleaner/image_cleaner.h"
+#include "../rotation/rotation.h"
+
+// Bounds as a fraction of the output pixels: shear rounding moves ink
+// edges by one pixel, but almost never farther.
+#define MAX_DIFF 0.10
+#define MAX_FAR  0.002
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Default Auto Process binarization: luminance and histogram in one pass, then Otsu
+static GrayImage *binarize_page(SDL_Surface *s, BitImage **mask)
+{
+    int histogram[GRAY_LEVELS];
+    GrayImage *g = gray_from_surface_hist(s, histogram);
+    if (g) apply_otsu_thresholding_hist(g, histogram, mask);
+    return g;
+}
+
+typedef enum { ON_SURFACE, ON_GRAY, ON_BITS } Target;
+
+static double time_rotation(SDL_Surface *s, const GrayImage *g, const BitImage *b,
+                            Target target, RotateFilter filter, double angle,
+                            int iters)
+{
+    double t0 = now_sec();
+    for (int i = 0; i < iters; ++i) {
+        if (target == ON_SURFACE) {
+            SDL_FreeSurface(rotate_ex(s, angle, filter, 0));
+        } else if (target == ON_GRAY) {
+            gray_free(rotate_gray_ex(g, angle, filter, 0));
+        } else {
+            bit_free(rotate_bits(b, angle, 0));
+        }
+    }
+    return (now_sec() - t0) * 1e3 / iters;
+}
+
+// Pixels of a that differ from b (*diff), and those whose value does not
+// even occur in the 3x3 neighbourhood of b (*far). Returns 0 when the
+// counts are within bounds, -1 otherwise (both counts are -1 when the
+// sizes differ).
+static int compare(const GrayImage *a, const GrayImage *b, long *diff, long *far)
+{
+    *diff = *far = -1;
+    if (a->w != b->w || a->h != b->h) return -1;
+    *diff = *far = 0;
+    for (int y = 0; y < a->h; ++y) {
+        const Uint8 *ra = gray_row(a, y), *rb = gray_row(b, y);
+        for (int x = 0; x < a->w; ++x) {
+            if (ra[x] == rb[x]) continue;
+            (*diff)++;
+            int near = 0;
+            for (int dy = -1; dy <= 1 && !near; ++dy) {
+                if (y + dy < 0 || y + dy >= b->h) continue;
+                const Uint8 *r = gray_row(b, y + dy);
+                for (int dx = -1; dx <= 1; ++dx)
+                    if (x + dx >= 0 && x + dx < b->w && r[x + dx] == ra[x]) near = 1;
+            }
+            *far += !near;
+        }
+    }
+    double n = (double)a->w * a->h;
+    return (*diff <= MAX_DIFF * n && *far <= MAX_FAR * n) ? 0 : -1;
+}
+
+// Shear paths against the nearest 2D mapping; returns 1 when both agree.
+static int check_rotation(const char *name, const GrayImage *g, const BitImage *b,
+                          double angle, int expand)
+{
+    GrayImage *ref = rotate_gray_ex(g, angle, ROTATE_NEAREST, expand);
+    GrayImage *shr = rotate_shear_gray(g, angle, expand);
+    BitImage *bits = rotate_bits(b, angle, expand);
+    GrayImage *unpacked = bits ? gray_create(bits->w, bits->h) : NULL;
+
+    int ok = 0;
+    if (ref && shr && unpacked && bit_to_gray(bits, unpacked) == 0) {
+        long dg, fg, db, fb;
+        ok = compare(shr, ref, &dg, &fg) == 0;
+        ok = compare(unpacked, ref, &db, &fb) == 0 && ok;
+        printf("%-24s %7.2f %s | %4dx%-4d | gray %6ld %4ld | bits %6ld %4ld%s\n",
+               name, angle, expand ? "expand" : "crop  ", ref->w, ref->h,
+               dg, fg, db, fb, ok ? "" : "  MISMATCH");
+    } else {
+        printf("%-24s %7.2f %s | rotation failed  MISMATCH\n", name, angle,
+               expand ? "expand" : "crop  ");
+    }
+
+    gray_free(ref);
+    gray_free(shr);
+    gray_free(unpacked);
+    bit_free(bits);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int first = 1, iters = 10;
+    if (argc > 1 && atoi(argv[1]) > 0) {
+        iters = atoi(argv[1]);
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [iterations] image...\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+
+    for (int a = first; a < argc; ++a) {
+        SDL_Surface *in = IMG_Load(argv[a]);
+        if (!in) {
+            fprintf(stderr, "rotate_bench: cannot load %s\n", argv[a]);
+            continue;
+        }
+        SDL_Surface *s = SDL_ConvertSurfaceFormat(in, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(in);
+        if (!s) continue;
+
+        BitImage *b = NULL;
+        GrayImage *g = binarize_page(s, &b);
+        if (!g || !b) {
+            SDL_FreeSurface(s);
+            gray_free(g);
+            bit_free(b);
+            continue;
+        }
+        gray_to_surface(g, s);
+
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        double angles[3] = { auto_deskew_correction_gray(g), 5.0, 25.0 };
+
+        for (int k = 0; k < 3; ++k)
+            for (int expand = 0; expand <= 1; ++expand)
+                if (!check_rotation(name, g, b, angles[k], expand)) failures++;
+
+        printf("%-24s %7s | %8s %8s %8s | %8s %8s %8s | %8s  (ms)\n", "image", "angle",
+               "surf nn", "surf bil", "surf shr", "gray nn", "gray bil", "gray shr",
+               "bits shr");
+        for (int k = 0; k < 3; ++k) {
+            double ang = angles[k];
+            printf("%-24s %7.2f | %8.2f %8.2f %8.2f | %8.2f %8.2f %8.2f | %8.2f\n",
+                   name, ang,
+                   time_rotation(s, g, b, ON_SURFACE, ROTATE_NEAREST, ang, iters),
+                   time_rotation(s, g, b, ON_SURFACE, ROTATE_BILINEAR, ang, iters),
+                   time_rotation(s, g, b, ON_SURFACE, ROTATE_SHEAR, ang, iters),
+                   time_rotation(s, g, b, ON_GRAY, ROTATE_NEAREST, ang, iters),
+                   time_rotation(s, g, b, ON_GRAY, ROTATE_BILINEAR, ang, iters),
+                   time_rotation(s, g, b, ON_GRAY, ROTATE_SHEAR, ang, iters),
+                   time_rotation(s, g, b, ON_BITS, ROTATE_SHEAR, ang, iters));
+        }
+
+        SDL_FreeSurface(s);
+        gray_free(g);
+        bit_free(b);
+    }
+
+    if (failures) {
+        printf("%d shear rotation(s) differ from the 2D mapping\n", failures);
+        return 1;
+    }
+    printf("shear rotations agree with the 2D mapping\n");
+    return 0;
+}
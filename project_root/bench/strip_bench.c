@@ -0,0 +1,128 @@
+// strip_bench.c
+// Timing and memory of the strip streaming mode.
+//
+//   make bench
+//   ./bench/strip_bench image [strip_rows]
+//   ./bench/strip_bench --synth WIDTHxHEIGHT file.pgm
+//
+// A binary PGM / PPM is streamed from disk (the page is never loaded); any
+// other format goes through IMG_Load and is streamed from the surface.
+// Prints the Otsu threshold, the number of components, MPixel/s and the
+// peak resident size. --synth writes a large speckled test page.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "strip_stream/strip_stream.h"
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/* Page of small dark blocks on a light background, written row by row. */
+static int write_synth(const char *spec, const char *path)
+{
+    int w, h;
+    if (sscanf(spec, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return -1;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    fprintf(f, "P5\n%d %d\n255\n", w, h);
+
+    Uint8 *row = malloc((size_t)w);
+    if (!row) {
+        fclose(f);
+        return -1;
+    }
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            unsigned cell = (unsigned)(x / 24) * 2654435761u ^ (unsigned)(y / 32) * 40503u;
+            int ink = (cell >> 7) & 1;
+            int block = ink && x % 24 >= 6 && x % 24 < 18
+                        && y % 32 >= 4 && y % 32 < 28;
+            row[x] = (Uint8)(block ? (x + y) % 48 : 200 + (x ^ y) % 48);
+        }
+        fwrite(row, 1, (size_t)w, f);
+    }
+    free(row);
+    fclose(f);
+    return 0;
+}
+
+static int is_pnm(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    char m[2] = {0, 0};
+    int ok = fread(m, 1, 2, f) == 2 && m[0] == 'P' && (m[1] == '5' || m[1] == '6');
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 3 && strcmp(argv[1], "--synth") == 0) {
+        if (write_synth(argv[2], argv[3]) != 0) {
+            fprintf(stderr, "strip_bench: cannot write %s\n", argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s image [strip_rows]\n", argv[0]);
+        return 1;
+    }
+
+    SDL_Surface *surface = NULL;
+    StripSource *src = NULL;
+    if (is_pnm(argv[1])) {
+        src = strip_source_pnm(argv[1]);
+    } else {
+        SDL_Surface *in = IMG_Load(argv[1]);
+        if (in) surface = SDL_ConvertSurfaceFormat(in, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(in);
+        if (surface) src = strip_source_surface(surface);
+    }
+    if (!src) {
+        fprintf(stderr, "strip_bench: cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    StripOptions opt;
+    strip_options_init(&opt);
+    if (argc > 2) opt.strip_rows = atoi(argv[2]);
+
+    int w = strip_source_width(src), h = strip_source_height(src);
+    double t0 = now_sec();
+    StripResult res;
+    int rc = strip_process(src, &opt, &res);
+    double t1 = now_sec();
+
+    if (rc == 0) {
+        printf("%dx%d (%s), strips of %d rows\n", w, h,
+               surface ? "surface" : "streamed", opt.strip_rows);
+        printf("  threshold %d, %zu components\n", res.threshold, res.ncomp);
+        printf("  %.2f s, %.1f MPixel/s, peak RSS %ld MB\n", t1 - t0,
+               (double)w * h / 1e6 / (t1 - t0), peak_rss_kb() / 1024);
+    }
+
+    strip_result_free(&res);
+    strip_source_close(src);
+    SDL_FreeSurface(surface);
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,521 @@
+// strip_stream.c
+#include "strip_stream.h"
+#include "../../image_cleaner/image_cleaner.h"
+#include "../../thread_pool/thread_pool.h"
+
+#include <stdio.h>      // FILE, fopen, fread, fseeko, fprintf
+#include <stdlib.h>     // malloc, realloc, free
+#include <string.h>     // memset
+#include <sys/types.h>  // off_t
+
+/* Smallest band of strip rows handed to a thread. */
+#define STRIP_MIN_ROWS 8
+
+/* ---------------------------------------------------------------------------
+ * Sources
+ * -------------------------------------------------------------------------- */
+
+struct StripSource {
+    int w, h;
+
+    SDL_Surface *surface;   // surface source, or
+    FILE        *file;      // PNM source
+    int          channels;  // 1 (P5) or 3 (P6)
+    off_t        data_offset;
+    Uint8       *raw;       // file bytes of one strip
+    size_t       raw_size;
+};
+
+StripSource *strip_source_surface(SDL_Surface *surface)
+{
+    if (!surface || !surface->format || surface->format->BytesPerPixel != 4) {
+        fprintf(stderr, "strip_source_surface: need a 32 bpp surface\n");
+        return NULL;
+    }
+
+    StripSource *src = calloc(1, sizeof(StripSource));
+    if (!src) return NULL;
+    src->w = surface->w;
+    src->h = surface->h;
+    src->surface = surface;
+    return src;
+}
+
+/* Next header token of a PNM file (skips blanks and # comments). */
+static int pnm_token(FILE *f, long *value)
+{
+    int c = fgetc(f);
+    for (;;) {
+        if (c == '#') {
+            while (c != '\n' && c != EOF) c = fgetc(f);
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            c = fgetc(f);
+        } else {
+            break;
+        }
+    }
+    if (c < '0' || c > '9') return -1;
+
+    long v = 0;
+    while (c >= '0' && c <= '9') {
+        v = v * 10 + (c - '0');
+        if (v > 1000000000L) return -1;
+        c = fgetc(f);
+    }
+    *value = v;
+    // c is the single blank that ends the token (before the raster for maxval)
+    return c == EOF ? -1 : 0;
+}
+
+StripSource *strip_source_pnm(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "strip_source_pnm: cannot open %s\n", path);
+        return NULL;
+    }
+
+    char magic[2];
+    long w, h, maxval;
+    if (fread(magic, 1, 2, f) != 2 || magic[0] != 'P'
+        || (magic[1] != '5' && magic[1] != '6')
+        || pnm_token(f, &w) || pnm_token(f, &h) || pnm_token(f, &maxval)
+        || w <= 0 || h <= 0 || maxval != 255) {
+        fprintf(stderr, "strip_source_pnm: %s is not an 8-bit P5/P6 file\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    StripSource *src = calloc(1, sizeof(StripSource));
+    if (!src) {
+        fclose(f);
+        return NULL;
+    }
+    src->w = (int)w;
+    src->h = (int)h;
+    src->file = f;
+    src->channels = magic[1] == '6' ? 3 : 1;
+    src->data_offset = ftello(f);
+    return src;
+}
+
+void strip_source_close(StripSource *src)
+{
+    if (!src) return;
+    if (src->file) fclose(src->file);
+    free(src->raw);
+    free(src);
+}
+
+int strip_source_width(const StripSource *src)
+{
+    return src ? src->w : 0;
+}
+
+int strip_source_height(const StripSource *src)
+{
+    return src ? src->h : 0;
+}
+
+typedef struct {
+    const StripSource *src;
+    GrayImage         *strip;
+    int                y0;
+} LumaJob;
+
+static void luma_band(void *arg, int r0, int r1, int band)
+{
+    LumaJob *job = arg;
+    const StripSource *src = job->src;
+    (void)band;
+
+    for (int r = r0; r < r1; ++r) {
+        Uint8 *dst = gray_row(job->strip, r);
+        if (src->surface) {
+            const Uint32 *row = (const Uint32*)((const Uint8*)src->surface->pixels
+                                + (size_t)(job->y0 + r) * src->surface->pitch);
+            gray_luma_row(row, dst, src->w, src->surface->format, 1);
+        } else {
+            const Uint8 *row = src->raw + (size_t)r * src->w * src->channels;
+            if (src->channels == 3) gray_luma_rgb24(row, dst, src->w);
+            else memcpy(dst, row, (size_t)src->w);
+        }
+    }
+}
+
+/* Luminance of rows [y0, y0 + rows) into the first rows of strip. */
+static int source_read(StripSource *src, int y0, int rows, GrayImage *strip)
+{
+    if (src->file) {
+        size_t row_bytes = (size_t)src->w * src->channels;
+        size_t need = row_bytes * rows;
+        if (need > src->raw_size) {
+            Uint8 *raw = realloc(src->raw, need);
+            if (!raw) return -1;
+            src->raw = raw;
+            src->raw_size = need;
+        }
+        off_t at = src->data_offset + (off_t)y0 * (off_t)row_bytes;
+        if (fseeko(src->file, at, SEEK_SET) != 0
+            || fread(src->raw, 1, need, src->file) != need) {
+            fprintf(stderr, "strip_source: truncated file\n");
+            return -1;
+        }
+    }
+
+    LumaJob job = { src, strip, y0 };
+    if (src->surface && SDL_MUSTLOCK(src->surface)) SDL_LockSurface(src->surface);
+    parallel_for(rows, STRIP_MIN_ROWS, luma_band, &job);
+    if (src->surface && SDL_MUSTLOCK(src->surface)) SDL_UnlockSurface(src->surface);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Histogram and threshold of a strip
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const GrayImage *strip;
+    int            (*partial)[256];
+} HistJob;
+
+static void hist_band(void *arg, int r0, int r1, int band)
+{
+    HistJob *job = arg;
+    int *hist = job->partial[band];
+    memset(hist, 0, 256 * sizeof(int));
+    for (int r = r0; r < r1; ++r) {
+        const Uint8 *row = gray_row(job->strip, r);
+        for (int x = 0; x < job->strip->w; ++x) hist[row[x]]++;
+    }
+}
+
+typedef struct {
+    const GrayImage *strip;
+    BitImage        *out;
+    int              out_y0;     // row of out receiving strip row 0
+    int              threshold;
+} PackJob;
+
+static void pack_band(void *arg, int r0, int r1, int band)
+{
+    PackJob *job = arg;
+    int w = job->strip->w, t = job->threshold;
+    (void)band;
+
+    for (int r = r0; r < r1; ++r) {
+        const Uint8 *row = gray_row(job->strip, r);
+        Uint64 *dst = bit_row(job->out, job->out_y0 + r);
+        for (int i = 0; i < job->out->words; ++i) {
+            int base = i * 64;
+            int n = w - base < 64 ? w - base : 64;
+            Uint64 m = 0;
+            for (int b = 0; b < n; ++b)
+                m |= (Uint64)(row[base + b] < t) << b;
+            dst[i] = m;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Streaming labeler
+ *
+ * Runs of black pixels are labeled row by row. Only the components touching
+ * the previous row are kept ("active"); each new row gets a small union-find
+ * made of those actives followed by one node per run of the row. Actives no
+ * run reached are complete and emitted, the others are compacted into the
+ * next active table. Memory is O(width), whatever the page height.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int x0, x1;
+    int label;      // index in the active table
+} Run;
+
+typedef struct {
+    int       parent;
+    int       minx, maxx, miny, maxy;
+    long long area;
+} Node;
+
+typedef struct {
+    int     w;
+    Run    *prev, *cur;
+    int     nprev, ncur;
+    Node   *act, *next_act;
+    int     nact;
+    Node   *nodes;
+    int    *remap;
+
+    StripResult *res;
+    long long    min_area;
+    int          failed;
+} Labeler;
+
+static int labeler_init(Labeler *lb, int w, StripResult *res, long long min_area)
+{
+    int max_runs = (w + 1) / 2;
+
+    memset(lb, 0, sizeof(Labeler));
+    lb->w = w;
+    lb->res = res;
+    lb->min_area = min_area;
+    lb->prev = malloc((size_t)max_runs * sizeof(Run));
+    lb->cur = malloc((size_t)max_runs * sizeof(Run));
+    lb->act = malloc((size_t)max_runs * sizeof(Node));
+    lb->next_act = malloc((size_t)max_runs * sizeof(Node));
+    lb->nodes = malloc((size_t)2 * max_runs * sizeof(Node));
+    lb->remap = malloc((size_t)2 * max_runs * sizeof(int));
+    return (lb->prev && lb->cur && lb->act && lb->next_act && lb->nodes
+            && lb->remap) ? 0 : -1;
+}
+
+static void labeler_free(Labeler *lb)
+{
+    free(lb->prev);
+    free(lb->cur);
+    free(lb->act);
+    free(lb->next_act);
+    free(lb->nodes);
+    free(lb->remap);
+}
+
+static void emit(Labeler *lb, const Node *n)
+{
+    if (n->area < lb->min_area) return;
+
+    StripResult *res = lb->res;
+    if (res->ncomp == res->cap) {
+        size_t cap = res->cap ? res->cap * 2 : 1024;
+        StripComponent *c = realloc(res->comps, cap * sizeof(StripComponent));
+        if (!c) {
+            lb->failed = 1;
+            return;
+        }
+        res->comps = c;
+        res->cap = cap;
+    }
+
+    StripComponent *c = &res->comps[res->ncomp++];
+    c->minx = n->minx;
+    c->maxx = n->maxx;
+    c->miny = n->miny;
+    c->maxy = n->maxy;
+    c->area = n->area;
+}
+
+static int find_root(Node *nodes, int i)
+{
+    while (nodes[i].parent != i) {
+        nodes[i].parent = nodes[nodes[i].parent].parent;   // path halving
+        i = nodes[i].parent;
+    }
+    return i;
+}
+
+static void unite(Node *nodes, int a, int b)
+{
+    a = find_root(nodes, a);
+    b = find_root(nodes, b);
+    if (a == b) return;
+    if (b < a) { int t = a; a = b; b = t; }   // keep the oldest root
+
+    Node *r = &nodes[a], *o = &nodes[b];
+    o->parent = a;
+    if (o->minx < r->minx) r->minx = o->minx;
+    if (o->maxx > r->maxx) r->maxx = o->maxx;
+    if (o->miny < r->miny) r->miny = o->miny;
+    if (o->maxy > r->maxy) r->maxy = o->maxy;
+    r->area += o->area;
+}
+
+/* Runs of set bits of a packed row (padding bits are clear). */
+static int row_runs(const Uint64 *row, int words, int w, Run *runs)
+{
+    int n = 0, x = 0;
+    while (x < w) {
+        int i = x >> 6;
+        Uint64 m = row[i] & (~0ULL << (x & 63));
+        while (!m && ++i < words) m = row[i];
+        if (!m) break;
+        int start = i * 64 + __builtin_ctzll(m);
+
+        x = start;
+        i = x >> 6;
+        m = ~row[i] & (~0ULL << (x & 63));
+        while (!m && ++i < words) m = ~row[i];
+        int end = m ? i * 64 + __builtin_ctzll(m) : words * 64;
+        if (end > w) end = w;
+
+        runs[n].x0 = start;
+        runs[n].x1 = end - 1;
+        n++;
+        x = end;
+    }
+    return n;
+}
+
+static void labeler_row(Labeler *lb, const Uint64 *bits, int words, int y)
+{
+    int nact = lb->nact;
+    Node *nodes = lb->nodes;
+
+    lb->ncur = row_runs(bits, words, lb->w, lb->cur);
+
+    for (int i = 0; i < nact; ++i) {
+        nodes[i] = lb->act[i];
+        nodes[i].parent = i;
+    }
+    for (int k = 0; k < lb->ncur; ++k) {
+        Node *n = &nodes[nact + k];
+        n->parent = nact + k;
+        n->minx = lb->cur[k].x0;
+        n->maxx = lb->cur[k].x1;
+        n->miny = n->maxy = y;
+        n->area = lb->cur[k].x1 - lb->cur[k].x0 + 1;
+    }
+
+    // 8-connexity: runs touch when they overlap after widening by one
+    int i = 0;
+    for (int k = 0; k < lb->ncur; ++k) {
+        const Run *c = &lb->cur[k];
+        while (i < lb->nprev && lb->prev[i].x1 < c->x0 - 1) i++;
+        for (int j = i; j < lb->nprev && lb->prev[j].x0 <= c->x1 + 1; ++j)
+            unite(nodes, nact + k, lb->prev[j].label);
+    }
+
+    int total = nact + lb->ncur;
+    for (int n = 0; n < total; ++n) lb->remap[n] = -1;
+
+    int next = 0;
+    for (int k = 0; k < lb->ncur; ++k) {
+        int r = find_root(nodes, nact + k);
+        if (lb->remap[r] < 0) {
+            lb->remap[r] = next;
+            lb->next_act[next++] = nodes[r];
+        }
+        lb->cur[k].label = lb->remap[r];
+    }
+
+    // Active roots no run of this row reached are complete
+    for (int n = 0; n < nact; ++n)
+        if (nodes[n].parent == n && lb->remap[n] < 0) emit(lb, &nodes[n]);
+
+    Node *ta = lb->act; lb->act = lb->next_act; lb->next_act = ta;
+    Run *tr = lb->prev; lb->prev = lb->cur; lb->cur = tr;
+    lb->nact = next;
+    lb->nprev = lb->ncur;
+}
+
+static void labeler_finish(Labeler *lb)
+{
+    for (int n = 0; n < lb->nact; ++n) emit(lb, &lb->act[n]);
+    lb->nact = 0;
+    lb->nprev = 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Driver
+ * -------------------------------------------------------------------------- */
+
+void strip_options_init(StripOptions *opt)
+{
+    opt->strip_rows = STRIP_DEFAULT_ROWS;
+    opt->threshold = -1;
+    opt->keep_mask = 0;
+    opt->min_area = 1;
+}
+
+void strip_result_free(StripResult *res)
+{
+    if (!res) return;
+    bit_free(res->mask);
+    free(res->comps);
+    memset(res, 0, sizeof(StripResult));
+}
+
+/* First pass: Otsu threshold of the whole page. */
+static int stream_otsu(StripSource *src, GrayImage *strip, int rows)
+{
+    long long hist[256] = {0};
+    int partial[THREAD_POOL_MAX][256];
+
+    for (int y0 = 0; y0 < src->h; y0 += rows) {
+        int n = src->h - y0 < rows ? src->h - y0 : rows;
+        if (source_read(src, y0, n, strip) != 0) return -1;
+
+        HistJob job = { strip, partial };
+        int nb = parallel_bands(n, STRIP_MIN_ROWS);
+        // strip->h may exceed n on the last strip: band over n rows only
+        parallel_for(n, STRIP_MIN_ROWS, hist_band, &job);
+        for (int b = 0; b < nb; ++b)
+            for (int v = 0; v < 256; ++v) hist[v] += partial[b][v];
+    }
+
+    return compute_otsu_threshold_wide(hist, (long long)src->w * src->h);
+}
+
+int strip_process(StripSource *src, const StripOptions *opt_in, StripResult *res)
+{
+    if (!src || !res) return -1;
+    memset(res, 0, sizeof(StripResult));
+
+    StripOptions opt;
+    if (opt_in) opt = *opt_in;
+    else strip_options_init(&opt);
+
+    int w = src->w, h = src->h;
+    int rows = opt.strip_rows > 0 ? opt.strip_rows : STRIP_DEFAULT_ROWS;
+    if (rows > h) rows = h;
+
+    GrayImage *strip = gray_create(w, rows);
+    BitImage *bits = opt.keep_mask ? bit_create(w, h) : bit_create(w, rows);
+    Labeler lb;
+    int lb_ok = labeler_init(&lb, w, res, opt.min_area) == 0;
+    if (!strip || !bits || !lb_ok) {
+        fprintf(stderr, "strip_process: out of memory\n");
+        gray_free(strip);
+        bit_free(bits);
+        labeler_free(&lb);
+        return -1;
+    }
+
+    int threshold = opt.threshold;
+    if (threshold < 0) threshold = stream_otsu(src, strip, rows);
+
+    int status = threshold < 0 ? -1 : 0;
+    for (int y0 = 0; status == 0 && y0 < h; y0 += rows) {
+        int n = h - y0 < rows ? h - y0 : rows;
+        if (source_read(src, y0, n, strip) != 0) {
+            status = -1;
+            break;
+        }
+
+        int out_y0 = opt.keep_mask ? y0 : 0;
+        PackJob job = { strip, bits, out_y0, threshold };
+        parallel_for(n, STRIP_MIN_ROWS, pack_band, &job);
+
+        for (int r = 0; r < n; ++r)
+            labeler_row(&lb, bit_row(bits, out_y0 + r), bits->words, y0 + r);
+        if (lb.failed) status = -1;
+    }
+
+    if (status == 0) {
+        labeler_finish(&lb);
+        if (lb.failed) status = -1;
+    }
+
+    gray_free(strip);
+    labeler_free(&lb);
+
+    if (status != 0) {
+        bit_free(bits);
+        strip_result_free(res);
+        return -1;
+    }
+
+    res->threshold = threshold;
+    if (opt.keep_mask) res->mask = bits;
+    else bit_free(bits);
+    return 0;
+}
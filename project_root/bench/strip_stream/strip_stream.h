@@ -0,0 +1,61 @@
+#ifndef STRIP_STREAM_H
+#define STRIP_STREAM_H
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include "../../gray_image/gray_image.h"
+
+/* Rows converted, thresholded and labeled at a time. */
+#define STRIP_DEFAULT_ROWS 256
+
+/* Row source of the streaming mode: only one strip of it is converted to
+ * luminance at a time. */
+typedef struct StripSource StripSource;
+
+/* Rows of an already loaded 32 bpp surface (owned by the caller, must
+ * outlive the source). Returns NULL on error. */
+StripSource *strip_source_surface(SDL_Surface *surface);
+
+/* Rows read straight from a binary PGM (P5) or PPM (P6) file with maxval
+ * 255, so the page is never resident. Returns NULL on error. */
+StripSource *strip_source_pnm(const char *path);
+
+void strip_source_close(StripSource *src);
+
+int strip_source_width(const StripSource *src);
+int strip_source_height(const StripSource *src);
+
+/* Connected component of black pixels (8-connexity). */
+typedef struct {
+    int minx, maxx;
+    int miny, maxy;
+    long long area;      // pixel count
+} StripComponent;
+
+typedef struct {
+    int       strip_rows;  // <= 0 : STRIP_DEFAULT_ROWS
+    int       threshold;   // black if v < threshold; < 0 : Otsu (extra pass)
+    int       keep_mask;   // also return the whole page as a packed bitmap
+    long long min_area;    // smaller components are not reported
+} StripOptions;
+
+typedef struct {
+    int             threshold;  // threshold actually used
+    BitImage       *mask;       // packed page (keep_mask), else NULL
+    StripComponent *comps;      // in order of completion
+    size_t          ncomp;
+    size_t          cap;
+} StripResult;
+
+/* Defaults: STRIP_DEFAULT_ROWS, Otsu, no mask, min_area 1. */
+void strip_options_init(StripOptions *opt);
+
+/* Grayscale, threshold and label src one strip at a time. Memory is bounded
+ * by a strip, a few rows of labels and the components found (plus the
+ * 1 bit per pixel mask when requested). Returns 0 on success, -1 on error
+ * (res is then freed). */
+int strip_process(StripSource *src, const StripOptions *opt, StripResult *res);
+
+void strip_result_free(StripResult *res);
+
+#endif
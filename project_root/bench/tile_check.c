@@ -0,0 +1,209 @@
+// tile_check.c
+// Letter tiles of a virtually rotated page.
+//
+//   make bench
+//   ./bench/tile_check
+//
+// A synthetic page of letter-like blobs is read through GrayView at a few
+// angles. Each 28x28 tile of gray_view_to_28 must match a single direct
+// sample of the source (double precision bilinear at every point of the
+// tile lattice, averaged per output pixel) within MAX_DIFF gray levels.
+// The tile of the former two-step path (rotated ROI rendered, then
+// gray_to_28) is printed for comparison. On NEAREST and shear views the
+// sampled lattice must equal the rendered ROI pixel for pixel, and on an
+// identity view the tile must equal gray_to_28 exactly. Exits with 1 on
+// any mismatch.
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../gray_image/gray_image.h"
+#include "../neural_network/digitalisation.h"
+#include "../rotation/rotation.h"
+
+#define PAGE_W 640
+#define PAGE_H 480
+#define MAX_DIFF 2
+
+// Letter-like page: rings and bars of anti-aliased ink on white paper
+static GrayImage *make_page(void)
+{
+    GrayImage *g = gray_create(PAGE_W, PAGE_H);
+    if (!g) return NULL;
+    for (int y = 0; y < PAGE_H; ++y) {
+        Uint8 *row = gray_row(g, y);
+        for (int x = 0; x < PAGE_W; ++x) {
+            double cx = fmod(x, 40.0) - 20.0, cy = fmod(y, 40.0) - 20.0;
+            double r = sqrt(cx * cx + cy * cy);
+            double ring = fabs(r - 11.0) - 3.0;        // O
+            double bar = fabs(cx + 0.3 * cy) - 2.5;    // slanted stroke
+            double d = ring < bar ? ring : bar;        // distance to the ink
+            double ink = d <= -0.5 ? 1.0 : d >= 0.5 ? 0.0 : 0.5 - d;
+            row[x] = (Uint8)lround(255.0 - 235.0 * ink);
+        }
+    }
+    return g;
+}
+
+// Source value at (sx, sy), pixel centres on integers, white outside
+static double tap(const GrayImage *g, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= g->w || y >= g->h) return 255.0;
+    return gray_row(g, y)[x];
+}
+
+static double bilinear(const GrayImage *g, double sx, double sy)
+{
+    double x0 = floor(sx), y0 = floor(sy);
+    double fx = sx - x0, fy = sy - y0;
+    int x = (int)x0, y = (int)y0;
+    double top = tap(g, x, y) * (1.0 - fx) + tap(g, x + 1, y) * fx;
+    double bot = tap(g, x, y + 1) * (1.0 - fx) + tap(g, x + 1, y + 1) * fx;
+    return top * (1.0 - fy) + bot * fy;
+}
+
+// Reference tile: the same lattice as gray_view_to_28, every point mapped
+// to the source and interpolated once in double precision
+static void direct_tile(const GrayView *view, int px, int py, int w, int h,
+                        int ox, int oy, int side, Uint8 out[784])
+{
+    int n = (side + 27) / 28;
+    if (n < 2) n = 2;
+    if (n > 4) n = 4;    // VIEW28_MAX_SUB
+    double step = (double)side / (28 * n);
+    for (int qy = 0; qy < 28; ++qy) {
+        for (int qx = 0; qx < 28; ++qx) {
+            double ink = 0.0;
+            for (int a = qy * n; a < (qy + 1) * n; ++a) {
+                double wy = (a + 0.5) * step;
+                int iy = (int)floor(wy);
+                if (iy < oy || iy >= oy + h) continue;
+                for (int b = qx * n; b < (qx + 1) * n; ++b) {
+                    double wx = (b + 0.5) * step;
+                    int ix = (int)floor(wx);
+                    if (ix < ox || ix >= ox + w) continue;
+                    double sx, sy;
+                    rotate_view_to_source(view, px - ox + wx - 0.5,
+                                          py - oy + wy - 0.5, &sx, &sy);
+                    ink += 255.0 - bilinear(view->src, sx, sy);
+                }
+            }
+            out[qy * 28 + qx] = (Uint8)lround(255.0 - ink / (n * n));
+        }
+    }
+}
+
+static int max_diff(const Uint8 *a, const Uint8 *b)
+{
+    int m = 0;
+    for (int i = 0; i < 784; ++i) {
+        int d = abs((int)a[i] - (int)b[i]);
+        if (d > m) m = d;
+    }
+    return m;
+}
+
+int main(void)
+{
+    GrayImage *page = make_page();
+    if (!page) return 1;
+
+    // Patches (page coordinates, size) and their place in the side x side
+    // window, as extract_cell lays them out
+    static const int patch[][7] = {
+        { 300, 220, 30, 30, 4, 4, 38 },
+        { 180, 140, 24, 33, 9, 3, 39 },
+        { 402, 261, 61, 58, 6, 8, 75 },
+        { 250, 300, 12, 16, 5, 3, 22 },
+        { 120, 60, 140, 150, 9, 4, 158 },   // large cell: 4 x 4 samples
+    };
+    static const double angles[] = { 3.5, -7.0, 12.0, 33.0 };
+    int npatch = (int)(sizeof(patch) / sizeof(patch[0]));
+    int failures = 0;
+
+    printf("%8s %6s | %8s %8s\n", "angle", "patch", "sampled", "2-step");
+    for (size_t a = 0; a < sizeof(angles) / sizeof(angles[0]); ++a) {
+        GrayView view;
+        rotate_view_init(&view, page, angles[a], ROTATE_BILINEAR, 1);
+        for (int p = 0; p < npatch; ++p) {
+            const int *q = patch[p];
+            Uint8 got[784], ref[784], old[784];
+            if (gray_view_to_28(&view, q[0], q[1], q[2], q[3], q[4], q[5], q[6],
+                                got) != 0) {
+                printf("%8.1f %6d | gray_view_to_28 failed\n", angles[a], p);
+                failures++;
+                continue;
+            }
+            direct_tile(&view, q[0], q[1], q[2], q[3], q[4], q[5], q[6], ref);
+
+            int d_old = -1;
+            GrayImage *roi = rotate_view_roi(&view, q[0], q[1], q[2], q[3]);
+            if (roi) {
+                if (gray_to_28(roi->data, roi->stride, q[2], q[3], q[4], q[5],
+                               q[6], old) == 0)
+                    d_old = max_diff(old, ref);
+                gray_free(roi);
+            }
+
+            int d = max_diff(got, ref);
+            int ok = d <= MAX_DIFF;
+            if (!ok) failures++;
+            printf("%8.1f %6d | %8d %8d%s\n", angles[a], p, d, d_old,
+                   ok ? "" : "  MISMATCH");
+        }
+    }
+
+    // NEAREST and shear views: the sampler picks the very pixels the ROI
+    // renderer copies, so letter boxes found on an ROI line up with tiles
+    static const RotateFilter coarse[] = { ROTATE_NEAREST, ROTATE_SHEAR };
+    for (size_t f = 0; f < sizeof(coarse) / sizeof(coarse[0]); ++f) {
+        for (size_t a = 0; a < sizeof(angles) / sizeof(angles[0]); ++a) {
+            GrayView view;
+            rotate_view_init(&view, page, angles[a], coarse[f], 1);
+            int x = view.w / 3, y = view.h / 3, w = 97, h = 61;
+            GrayImage *roi = rotate_view_roi(&view, x, y, w, h);
+            Uint8 *got = (Uint8 *)malloc((size_t)w * (size_t)h);
+            int diff = -1;
+            if (roi && got) {
+                rotate_view_sample(&view, x, y, 1.0, w, h, got, w);
+                diff = 0;
+                for (int r = 0; r < h; ++r)
+                    for (int c = 0; c < w; ++c)
+                        diff += got[r * w + c] != gray_row(roi, r)[c];
+            }
+            if (diff != 0) failures++;
+            printf("%8.1f %6s | %8d %8s%s\n", angles[a],
+                   rotate_filter_name(coarse[f]), diff, "roi",
+                   diff == 0 ? "" : "  MISMATCH");
+            free(got);
+            gray_free(roi);
+        }
+    }
+
+    // Identity view: the plane is read in place, exactly as gray_to_28
+    GrayView id;
+    rotate_view_init(&id, page, 0.0, ROTATE_BILINEAR, 1);
+    for (int p = 0; p < npatch; ++p) {
+        const int *q = patch[p];
+        Uint8 got[784], ref[784];
+        int rc = gray_view_to_28(&id, q[0], q[1], q[2], q[3], q[4], q[5], q[6],
+                                 got);
+        gray_to_28(gray_row(page, q[1]) + q[0], page->stride, q[2], q[3], q[4],
+                   q[5], q[6], ref);
+        int d = rc == 0 ? max_diff(got, ref) : 255;
+        if (d != 0) failures++;
+        printf("%8.1f %6d | %8d %8s%s\n", 0.0, p, d, "-",
+               d == 0 ? "" : "  MISMATCH");
+    }
+
+    gray_free(page);
+    if (failures) {
+        printf("tile_check: %d mismatch(es)\n", failures);
+        return 1;
+    }
+    printf("tile_check: all tiles match\n");
+    return 0;
+}
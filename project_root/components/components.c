@@ -0,0 +1,365 @@
+// components.c
+#include "components.h"
+#include "../thread_pool/thread_pool.h"
+
+#include <stdio.h>      // fprintf
+#include <stdlib.h>     // malloc, realloc, free
+#include <string.h>     // memset, memcpy
+
+/* Smallest band of rows labeled by one thread. */
+#define COMPONENTS_MIN_ROWS 64
+
+/* ---------------------------------------------------------------------------
+ * Runs
+ *
+ * Every run of black pixels of the page is a union-find node. A run only
+ * ever links to an older run (smaller index), so the root of a component is
+ * its first run in raster order and parent[i] <= i holds throughout.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int x0, x1;
+    int y;
+} Run;
+
+typedef struct {
+    Run *runs;
+    int *parent;
+    int  n, cap;
+} RunTable;
+
+static int run_push(RunTable *t, int x0, int x1, int y)
+{
+    if (t->n == t->cap) {
+        int cap = t->cap ? t->cap * 2 : 4096;
+        Run *r = realloc(t->runs, (size_t)cap * sizeof(Run));
+        if (!r) return -1;
+        t->runs = r;
+        int *p = realloc(t->parent, (size_t)cap * sizeof(int));
+        if (!p) return -1;
+        t->parent = p;
+        t->cap = cap;
+    }
+    t->runs[t->n] = (Run){ x0, x1, y };
+    t->parent[t->n] = t->n;
+    t->n++;
+    return 0;
+}
+
+static int find_root(int *parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];   // path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+static void unite(int *parent, int a, int b)
+{
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a == b) return;
+    if (b < a) { int t = a; a = b; b = t; }   // keep the oldest root
+    parent[b] = a;
+}
+
+/* Join the runs [k0, k1) of a row to the runs [p0, p1) of the row above. */
+static void join_rows(RunTable *t, int p0, int p1, int k0, int k1)
+{
+    // 8-connexity: runs touch when they overlap after widening by one
+    int i = p0;
+    for (int k = k0; k < k1; ++k) {
+        const Run *c = &t->runs[k];
+        while (i < p1 && t->runs[i].x1 < c->x0 - 1) i++;
+        for (int j = i; j < p1 && t->runs[j].x0 <= c->x1 + 1; ++j)
+            unite(t->parent, k, j);
+    }
+}
+
+/* Append the runs of row y and join them to the runs [p0, p1) of the
+ * previous row. */
+static int label_row(RunTable *t, const Uint8 *row, int w, int y, int p0, int p1)
+{
+    int first = t->n;
+    int x = 0;
+    while (x < w) {
+        while (x < w && row[x] >= 128) x++;
+        if (x == w) break;
+        int start = x;
+        while (x < w && row[x] < 128) x++;
+        if (run_push(t, start, x - 1, y) != 0) return -1;
+    }
+
+    join_rows(t, p0, p1, first, t->n);
+    return 0;
+}
+
+/* Label rows [y0, y1) into t. The runs of the first row end at *first_end,
+ * the runs of the last row start at *last. */
+static int label_rows(RunTable *t, const GrayImage *img, int y0, int y1,
+                      int *first_end, int *last)
+{
+    int p0 = t->n, p1 = t->n;   // runs of the previous row (none yet)
+    *first_end = *last = t->n;
+    for (int y = y0; y < y1; ++y) {
+        int first = t->n;
+        if (label_row(t, gray_row(img, y), img->w, y, p0, p1) != 0)
+            return -1;
+        if (y == y0) *first_end = t->n;
+        p0 = first;
+        p1 = t->n;
+    }
+    *last = p0;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Reduction
+ * -------------------------------------------------------------------------- */
+
+/* Open a component holding run r (area and sums are added by the caller). */
+static int list_open(ComponentList *out, const Run *r)
+{
+    if (out->n == out->cap && components_reserve(out, out->n + 1) != 0) return -1;
+
+    int k = out->n++;
+    out->minx[k] = r->x0;
+    out->maxx[k] = r->x1;
+    out->miny[k] = out->maxy[k] = r->y;
+    out->area[k] = 0;
+    return 0;
+}
+
+/* Turn parent[] into component indices in place and accumulate the
+ * statistics. Runs are visited in order, so when run i is reached every
+ * older run already holds its component index: a root opens a new
+ * component, any other run takes the index of its (older) parent. */
+static int reduce_runs(RunTable *t, ComponentList *out)
+{
+    long long *sums = NULL;   // sum of x, sum of y per component
+    int sums_cap = 0;
+
+    for (int i = 0; i < t->n; ++i) {
+        const Run *r = &t->runs[i];
+        int k;
+        if (t->parent[i] == i) {
+            if (list_open(out, r) != 0) {
+                free(sums);
+                return -1;
+            }
+            k = out->n - 1;
+            if (out->n > sums_cap) {
+                int cap = out->cap;
+                long long *s = realloc(sums, (size_t)cap * 2 * sizeof(long long));
+                if (!s) {
+                    free(sums);
+                    return -1;
+                }
+                sums = s;
+                sums_cap = cap;
+            }
+            sums[2 * k] = sums[2 * k + 1] = 0;
+        } else {
+            k = t->parent[t->parent[i]];
+        }
+        t->parent[i] = k;
+
+        int len = r->x1 - r->x0 + 1;
+        if (r->x0 < out->minx[k]) out->minx[k] = r->x0;
+        if (r->x1 > out->maxx[k]) out->maxx[k] = r->x1;
+        out->maxy[k] = r->y;   // runs come row by row
+        out->area[k] += len;
+        sums[2 * k] += (long long)(r->x0 + r->x1) * len / 2;
+        sums[2 * k + 1] += (long long)r->y * len;
+    }
+
+    for (int k = 0; k < out->n; ++k) {
+        out->cx[k] = 0.5f * (float)(out->minx[k] + out->maxx[k]);
+        out->cy[k] = 0.5f * (float)(out->miny[k] + out->maxy[k]);
+        out->mx[k] = (float)((double)sums[2 * k] / out->area[k]);
+        out->my[k] = (float)((double)sums[2 * k + 1] / out->area[k]);
+    }
+    free(sums);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Strips
+ *
+ * Each band of rows is labeled on its own thread into a private table.
+ * The tables are then appended in band order, which keeps the runs in
+ * raster order (and every link pointing to an older run), and the runs of
+ * the two rows meeting at each band border are joined. The reduction is
+ * the serial one, so the result is identical to components_label_serial.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const GrayImage *img;
+    RunTable         tables[THREAD_POOL_MAX];
+    int              first_end[THREAD_POOL_MAX];   // end of the first row's runs
+    int              last[THREAD_POOL_MAX];        // start of the last row's runs
+    int              failed[THREAD_POOL_MAX];
+} StripJob;
+
+static void strip_band(void *arg, int y0, int y1, int band)
+{
+    StripJob *job = arg;
+    job->failed[band] = label_rows(&job->tables[band], job->img, y0, y1,
+                                   &job->first_end[band], &job->last[band]) != 0;
+}
+
+/* Append src to dst (allocated large enough), shifting its links by dst->n. */
+static void table_append(RunTable *dst, const RunTable *src)
+{
+    int base = dst->n;
+    memcpy(dst->runs + base, src->runs, (size_t)src->n * sizeof(Run));
+    for (int i = 0; i < src->n; ++i) dst->parent[base + i] = src->parent[i] + base;
+    dst->n += src->n;
+}
+
+/* ---------------------------------------------------------------------------
+ * API
+ * -------------------------------------------------------------------------- */
+
+int components_label_serial(const GrayImage *img, ComponentList *out)
+{
+    if (!out) return -1;
+    memset(out, 0, sizeof(ComponentList));
+    if (!img) return -1;
+
+    RunTable t = { NULL, NULL, 0, 0 };
+    int first_end, last;
+    int status = label_rows(&t, img, 0, img->h, &first_end, &last);
+    if (status == 0) status = reduce_runs(&t, out);
+    free(t.runs);
+    free(t.parent);
+
+    if (status != 0) {
+        fprintf(stderr, "components_label: out of memory\n");
+        components_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+int components_label_strips(const GrayImage *img, ComponentList *out)
+{
+    if (!out) return -1;
+    memset(out, 0, sizeof(ComponentList));
+    if (!img) return -1;
+
+    int nb = parallel_bands(img->h, COMPONENTS_MIN_ROWS);
+    if (nb <= 1) return components_label_serial(img, out);
+
+    StripJob *job = calloc(1, sizeof(StripJob));
+    if (!job) {
+        fprintf(stderr, "components_label: out of memory\n");
+        return -1;
+    }
+    job->img = img;
+    parallel_for(img->h, COMPONENTS_MIN_ROWS, strip_band, job);
+
+    int status = 0, total = 0;
+    for (int b = 0; b < nb; ++b) {
+        if (job->failed[b]) status = -1;
+        total += job->tables[b].n;
+    }
+
+    RunTable t = { NULL, NULL, 0, total };
+    if (status == 0) {
+        t.runs = malloc((size_t)(total ? total : 1) * sizeof(Run));
+        t.parent = malloc((size_t)(total ? total : 1) * sizeof(int));
+        if (!t.runs || !t.parent) status = -1;
+    }
+
+    // Appending in band order keeps the raster order; the rows meeting at
+    // each border are then joined
+    int prev_last = 0;
+    for (int b = 0; b < nb && status == 0; ++b) {
+        int base = t.n;
+        table_append(&t, &job->tables[b]);
+        if (b > 0) join_rows(&t, prev_last, base, base, base + job->first_end[b]);
+        prev_last = base + job->last[b];
+    }
+
+    if (status == 0) status = reduce_runs(&t, out);
+    free(t.runs);
+    free(t.parent);
+    for (int b = 0; b < nb; ++b) {
+        free(job->tables[b].runs);
+        free(job->tables[b].parent);
+    }
+    free(job);
+
+    if (status != 0) {
+        fprintf(stderr, "components_label: out of memory\n");
+        components_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+int components_label(const GrayImage *img, ComponentList *out)
+{
+    if (img && (long long)img->w * img->h >= COMPONENTS_PARALLEL_MIN_PIXELS)
+        return components_label_strips(img, out);
+    return components_label_serial(img, out);
+}
+
+int components_reserve(ComponentList *list, int cap)
+{
+    if (cap <= list->cap) return 0;
+    if (cap < 2 * list->cap) cap = 2 * list->cap;
+    if (cap < 1024) cap = 1024;
+
+    // Fields are grown one by one: on failure the ones already grown simply
+    // keep their extra room, list->cap stays the common capacity
+    int   **ints[5]   = { &list->minx, &list->maxx, &list->miny, &list->maxy,
+                          &list->area };
+    float **floats[4] = { &list->cx, &list->cy, &list->mx, &list->my };
+    for (int f = 0; f < 5; ++f) {
+        int *p = realloc(*ints[f], (size_t)cap * sizeof(int));
+        if (!p) return -1;
+        *ints[f] = p;
+    }
+    for (int f = 0; f < 4; ++f) {
+        float *p = realloc(*floats[f], (size_t)cap * sizeof(float));
+        if (!p) return -1;
+        *floats[f] = p;
+    }
+    list->cap = cap;
+    return 0;
+}
+
+int components_append(ComponentList *dst, const ComponentList *src, int i)
+{
+    if (dst->n == dst->cap && components_reserve(dst, dst->n + 1) != 0) return -1;
+
+    int k = dst->n++;
+    dst->minx[k] = src->minx[i];
+    dst->maxx[k] = src->maxx[i];
+    dst->miny[k] = src->miny[i];
+    dst->maxy[k] = src->maxy[i];
+    dst->area[k] = src->area[i];
+    dst->cx[k] = src->cx[i];
+    dst->cy[k] = src->cy[i];
+    dst->mx[k] = src->mx[i];
+    dst->my[k] = src->my[i];
+    return 0;
+}
+
+void components_free(ComponentList *list)
+{
+    if (!list) return;
+    free(list->minx);
+    free(list->maxx);
+    free(list->miny);
+    free(list->maxy);
+    free(list->area);
+    free(list->cx);
+    free(list->cy);
+    free(list->mx);
+    free(list->my);
+    memset(list, 0, sizeof(ComponentList));
+}
@@ -0,0 +1,52 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "../gray_image/gray_image.h"
+
+/* Connected components of black pixels (v < 128, 8-connexity), stored as
+ * one array per field: component i is (minx[i], maxx[i], ...). Scans over
+ * one field (sorting by cx, gaps between centres) stay contiguous. */
+typedef struct {
+    int   *minx, *maxx;
+    int   *miny, *maxy;
+    int   *area;        // pixel count
+    float *cx, *cy;     // centre of the bounding box
+    float *mx, *my;     // centroid (mean pixel position)
+    int    n, cap;
+} ComponentList;
+
+/* Make room for at least cap components (amortized: the capacity at least
+ * doubles). Returns 0 on success, -1 on error (list unchanged). */
+int components_reserve(ComponentList *list, int cap);
+
+/* Append component i of src to dst. Returns 0 on success, -1 on error. */
+int components_append(ComponentList *dst, const ComponentList *src, int i);
+
+/* Pages of at least this many pixels are labeled by strips in parallel. */
+#define COMPONENTS_PARALLEL_MIN_PIXELS (1 << 20)
+
+/* Label the black pixels of img, in raster order of the first pixel of
+ * each component (the order a top-left to bottom-right flood fill would
+ * find them): runs of each row are joined to the runs they touch on the
+ * previous row with a union-find, then the statistics are reduced per
+ * label in one pass over the runs. Memory is proportional
+ * to the number of runs, not of pixels. Returns 0 on success, -1 on error
+ * (out is then empty).
+ * Pages of COMPONENTS_PARALLEL_MIN_PIXELS or more go through
+ * components_label_strips, smaller ones through components_label_serial;
+ * both give the same list. */
+int components_label(const GrayImage *img, ComponentList *out);
+
+/* Single-threaded labeling of the whole page. */
+int components_label_serial(const GrayImage *img, ComponentList *out);
+
+/* Bands of rows labeled on the thread pool, then merged: the runs of the
+ * two rows meeting at each band border are joined with the same
+ * union-find, and the statistics are reduced once over the merged runs. */
+int components_label_strips(const GrayImage *img, ComponentList *out);
+
+/* Free the arrays of list (the struct itself is the caller's) and leave it
+ * empty, ready for reuse. */
+void components_free(ComponentList *list);
+
+#endif
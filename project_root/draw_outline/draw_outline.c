@@ -221,3 +221,28 @@ void rectangle(SDL_Renderer *renderer,
                     (float)left,  (float)top,
                     stroke);
 }
+
+// ========================= QUADRILATERAL ========================= //
+
+// Draw the outline of the quadrilateral (xs[0], ys[0]) -> ... -> (xs[3], ys[3])
+void quadrilateral(SDL_Renderer *renderer,
+                   const int xs[4], const int ys[4],
+                   int stroke)
+{
+    if (!renderer)
+        return;
+
+    if (stroke <= 0)
+        stroke = 1;
+
+    // Same random bright color as rectangle()
+    set_random_color(renderer);
+
+    for (int i = 0; i < 4; i++) {
+        int j = (i + 1) % 4;
+        draw_thick_line(renderer,
+                        (float)xs[i], (float)ys[i],
+                        (float)xs[j], (float)ys[j],
+                        stroke);
+    }
+}
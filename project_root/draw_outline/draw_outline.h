@@ -25,4 +25,10 @@ void rectangle(SDL_Renderer *renderer,
                int x1, int y1, int x2, int y2,
                int width, int stroke);
 
+// Draw the outline of any quadrilateral (e.g. a rectangle seen through a
+// rotation), corners given in drawing order.
+void quadrilateral(SDL_Renderer *renderer,
+                   const int xs[4], const int ys[4],
+                   int stroke);
+
 #endif
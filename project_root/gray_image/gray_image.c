@@ -0,0 +1,361 @@
+// gray_image.c
+#include "gray_image.h"
+#include "../thread_pool/thread_pool.h"
+
+#include <stdio.h>      // fprintf
+#include <stdlib.h>     // aligned_alloc, free
+#include <string.h>     // memset, memcpy
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Smallest band of rows handed to a thread */
+#define GRAY_MIN_ROWS 16
+
+/* ---------------------------------------------------------------------------
+ * Allocation
+ * -------------------------------------------------------------------------- */
+
+GrayImage *gray_create(int w, int h) {
+    if (w <= 0 || h <= 0) return NULL;
+
+    GrayImage *img = (GrayImage*)malloc(sizeof(GrayImage));
+    if (!img) return NULL;
+
+    // Round stride up so that every row starts on a GRAY_ALIGN boundary
+    int stride = (w + GRAY_ALIGN - 1) & ~(GRAY_ALIGN - 1);
+    size_t size = (size_t)stride * (size_t)h;
+
+    img->data = (Uint8*)aligned_alloc(GRAY_ALIGN, size);
+    if (!img->data) {
+        free(img);
+        return NULL;
+    }
+    memset(img->data, 255, size);
+
+    img->w = w;
+    img->h = h;
+    img->stride = stride;
+    return img;
+}
+
+void gray_free(GrayImage *img) {
+    if (!img) return;
+    free(img->data);
+    free(img);
+}
+
+GrayImage *gray_clone(const GrayImage *img) {
+    if (!img) return NULL;
+    GrayImage *copy = gray_create(img->w, img->h);
+    if (!copy) return NULL;
+    memcpy(copy->data, img->data, (size_t)img->stride * (size_t)img->h);
+    return copy;
+}
+
+BitImage *bit_create(int w, int h) {
+    if (w <= 0 || h <= 0) return NULL;
+
+    BitImage *img = (BitImage*)malloc(sizeof(BitImage));
+    if (!img) return NULL;
+
+    img->w = w;
+    img->h = h;
+    img->words = (w + 63) >> 6;
+    img->bits = (Uint64*)calloc((size_t)img->words * (size_t)h, sizeof(Uint64));
+    if (!img->bits) {
+        free(img);
+        return NULL;
+    }
+    return img;
+}
+
+void bit_free(BitImage *img) {
+    if (!img) return;
+    free(img->bits);
+    free(img);
+}
+
+void bit_pack_row(const Uint8 *src, int w, Uint64 *dst) {
+    int words = (w + 63) >> 6;
+    int wx = 0;
+
+#ifdef __SSE2__
+    // Full words: one compare + movemask per 16 pixels
+    const __m128i zero = _mm_setzero_si128();
+    for (; (wx + 1) * 64 <= w; ++wx) {
+        const __m128i *p = (const __m128i*)(src + wx * 64);
+        Uint64 m0 = (Uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 0), zero));
+        Uint64 m1 = (Uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 1), zero));
+        Uint64 m2 = (Uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), zero));
+        Uint64 m3 = (Uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 3), zero));
+        dst[wx] = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+    }
+#endif
+
+    for (; wx < words; ++wx) {
+        int x0 = wx * 64;
+        int n = (w - x0 < 64) ? w - x0 : 64;
+        Uint64 word = 0;
+        for (int i = 0; i < n; ++i)
+            word |= (Uint64)(src[x0 + i] == 0) << i;
+        dst[wx] = word;
+    }
+}
+
+BitImage *bit_from_gray(const GrayImage *img) {
+    if (!img) return NULL;
+    BitImage *bits = bit_create(img->w, img->h);
+    if (!bits) return NULL;
+    for (int y = 0; y < img->h; ++y)
+        bit_pack_row(gray_row(img, y), img->w, bit_row(bits, y));
+    return bits;
+}
+
+int bit_to_gray(const BitImage *bits, GrayImage *img) {
+    if (!bits || !img) return -1;
+    if (bits->w != img->w || bits->h != img->h) return -1;
+
+    for (int y = 0; y < img->h; ++y) {
+        const Uint64 *src = bit_row(bits, y);
+        Uint8 *dst = gray_row(img, y);
+        for (int x = 0; x < img->w; ++x)
+            dst[x] = ((src[x >> 6] >> (x & 63)) & 1) ? 0 : 255;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Surface <-> plane conversions
+ * -------------------------------------------------------------------------- */
+
+GrayImage *gray_from_surface(SDL_Surface *surface) {
+    return gray_from_surface_hist(surface, NULL);
+}
+
+typedef struct {
+    SDL_Surface *src;
+    GrayImage   *img;
+    int        (*partial)[256];   // one histogram per band, or NULL
+} LumaJob;
+
+static void luma_band(void *arg, int y0, int y1, int band)
+{
+    LumaJob *job = arg;
+    int *histogram = job->partial ? job->partial[band] : NULL;
+    int w = job->img->w;
+
+    if (histogram) memset(histogram, 0, 256 * sizeof(int));
+
+    for (int y = y0; y < y1; ++y) {
+        const Uint32 *src = (const Uint32*)((const Uint8*)job->src->pixels
+                                            + (size_t)y * job->src->pitch);
+        Uint8 *dst = gray_row(job->img, y);
+        gray_luma_row(src, dst, w, job->src->format, 1);
+
+        // Row is still in cache: count it now instead of a second pass
+        if (histogram)
+            for (int x = 0; x < w; ++x) histogram[dst[x]]++;
+    }
+}
+
+GrayImage *gray_from_surface_hist(SDL_Surface *surface, int histogram[256]) {
+    if (!surface) return NULL;
+
+    // Work on a 32 bpp view of the surface (convert only if needed)
+    SDL_Surface *s32 = surface;
+    if (surface->format->BytesPerPixel != 4) {
+        s32 = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (!s32) {
+            fprintf(stderr, "gray_from_surface: %s\n", SDL_GetError());
+            return NULL;
+        }
+    }
+
+    GrayImage *img = gray_create(s32->w, s32->h);
+    if (!img) {
+        if (s32 != surface) SDL_FreeSurface(s32);
+        return NULL;
+    }
+
+    int partial[THREAD_POOL_MAX][256];
+    LumaJob job = { s32, img, histogram ? partial : NULL };
+    int nbands = parallel_bands(img->h, GRAY_MIN_ROWS);
+
+    if (SDL_MUSTLOCK(s32)) SDL_LockSurface(s32);
+    parallel_for(img->h, GRAY_MIN_ROWS, luma_band, &job);
+    if (SDL_MUSTLOCK(s32)) SDL_UnlockSurface(s32);
+    if (s32 != surface) SDL_FreeSurface(s32);
+
+    // Per-band histograms summed in band order
+    if (histogram) {
+        memset(histogram, 0, 256 * sizeof(int));
+        for (int b = 0; b < nbands; ++b)
+            for (int i = 0; i < 256; ++i) histogram[i] += partial[b][i];
+    }
+
+    return img;
+}
+
+int gray_to_surface(const GrayImage *img, SDL_Surface *surface) {
+    if (!img || !surface) return -1;
+    if (surface->w != img->w || surface->h != img->h) return -1;
+    if (surface->format->BytesPerPixel != 4) return -1;
+
+    const SDL_PixelFormat *fmt = surface->format;
+    int rs = fmt->Rshift, gs = fmt->Gshift, bs = fmt->Bshift;
+    Uint32 amask = fmt->Amask;              // opaque
+
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+
+    for (int y = 0; y < img->h; ++y) {
+        const Uint8 *src = gray_row(img, y);
+        Uint32 *dst = (Uint32*)((Uint8*)surface->pixels + (size_t)y * surface->pitch);
+        for (int x = 0; x < img->w; ++x) {
+            Uint32 v = src[x];
+            dst[x] = (v << rs) | (v << gs) | (v << bs) | amask;
+        }
+    }
+
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+    return 0;
+}
+
+SDL_Surface *gray_to_new_surface(const GrayImage *img) {
+    if (!img) return NULL;
+
+    SDL_Surface *s = SDL_CreateRGBSurfaceWithFormat(
+        0, img->w, img->h, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (!s) {
+        fprintf(stderr, "gray_to_new_surface: %s\n", SDL_GetError());
+        return NULL;
+    }
+    if (gray_to_surface(img, s) != 0) {
+        SDL_FreeSurface(s);
+        return NULL;
+    }
+    return s;
+}
+
+/* ---------------------------------------------------------------------------
+ * Area-averaging resample
+ *
+ * In units where the page is sw * dw wide, source pixel i covers
+ * [i * dw, (i + 1) * dw) and destination pixel x covers [x * sw, (x + 1) * sw):
+ * all overlaps are integers. Rows are first averaged horizontally into 8.8
+ * fixed point, then accumulated vertically with the same scheme.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int first, last;       // source span
+    Uint32 w_first, w_last; // partial overlaps (w_first alone if first == last)
+} AreaSpan;
+
+static void area_spans(AreaSpan *spans, int sn, int dn)
+{
+    for (int x = 0; x < dn; ++x) {
+        long long a = (long long)x * sn, b = (long long)(x + 1) * sn;
+        AreaSpan *s = &spans[x];
+        s->first = (int)(a / dn);
+        s->last  = (int)((b - 1) / dn);
+        if (s->first == s->last) {
+            s->w_first = (Uint32)sn;
+            s->w_last = 0;
+        } else {
+            s->w_first = (Uint32)((long long)(s->first + 1) * dn - a);
+            s->w_last  = (Uint32)(b - (long long)s->last * dn);
+        }
+    }
+}
+
+typedef struct {
+    const GrayImage *src;
+    GrayImage       *dst;
+    const AreaSpan  *xs, *ys;
+    int              failed;    // set by a band that ran out of memory
+} AreaJob;
+
+/* Horizontal average of one source row, 8.8 fixed point. */
+static void area_row(const AreaJob *job, int sy, Uint16 *out)
+{
+    const Uint8 *row = gray_row(job->src, sy);
+    int sw = job->src->w, dw = job->dst->w;
+
+    for (int x = 0; x < dw; ++x) {
+        const AreaSpan *s = &job->xs[x];
+        Uint64 acc = (Uint64)row[s->first] * s->w_first;
+        if (s->last != s->first) {
+            for (int i = s->first + 1; i < s->last; ++i) acc += row[i] * (Uint64)dw;
+            acc += (Uint64)row[s->last] * s->w_last;
+        }
+        // acc / sw is the mean; keep 8 fractional bits
+        out[x] = (Uint16)((acc * 256 + (Uint64)sw / 2) / (Uint64)sw);
+    }
+}
+
+static void area_band(void *arg, int y0, int y1, int band)
+{
+    AreaJob *job = arg;
+    int dw = job->dst->w, dh = job->dst->h, sh = job->src->h;
+    (void)band;
+
+    Uint16 *tmp = malloc((size_t)dw * sizeof(Uint16));
+    Uint64 *acc = malloc((size_t)dw * sizeof(Uint64));
+    if (!tmp || !acc) {
+        // The plane would miss this band: fail the whole resample
+        free(tmp);
+        free(acc);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        const AreaSpan *s = &job->ys[y];
+        memset(acc, 0, (size_t)dw * sizeof(Uint64));
+
+        for (int sy = s->first; sy <= s->last; ++sy) {
+            Uint32 wy = (sy == s->first) ? s->w_first
+                      : (sy == s->last) ? s->w_last : (Uint32)dh;
+            area_row(job, sy, tmp);
+            for (int x = 0; x < dw; ++x) acc[x] += (Uint64)tmp[x] * wy;
+        }
+
+        Uint8 *dst = gray_row(job->dst, y);
+        Uint64 den = (Uint64)sh * 256;
+        for (int x = 0; x < dw; ++x)
+            dst[x] = (Uint8)((acc[x] + den / 2) / den);
+    }
+
+    free(tmp);
+    free(acc);
+}
+
+GrayImage *gray_resize_area(const GrayImage *src, int dw, int dh) {
+    if (!src || dw <= 0 || dh <= 0) return NULL;
+
+    GrayImage *dst = gray_create(dw, dh);
+    AreaSpan *xs = malloc((size_t)dw * sizeof(AreaSpan));
+    AreaSpan *ys = malloc((size_t)dh * sizeof(AreaSpan));
+    if (!dst || !xs || !ys) {
+        gray_free(dst);
+        free(xs);
+        free(ys);
+        return NULL;
+    }
+
+    area_spans(xs, src->w, dw);
+    area_spans(ys, src->h, dh);
+
+    AreaJob job = { src, dst, xs, ys, 0 };
+    parallel_for(dh, GRAY_MIN_ROWS, area_band, &job);
+
+    free(xs);
+    free(ys);
+    if (job.failed) {
+        fprintf(stderr, "gray_resize_area: out of memory\n");
+        gray_free(dst);
+        return NULL;
+    }
+    return dst;
+}
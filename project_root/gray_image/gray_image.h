@@ -0,0 +1,127 @@
+#ifndef GRAY_IMAGE_H
+#define GRAY_IMAGE_H
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+/* Row alignment (bytes) of every GrayImage plane. */
+#define GRAY_ALIGN 32
+
+/* 8-bit luminance plane shared by all the processing stages.
+ *  - data   : GRAY_ALIGN-aligned buffer of h * stride bytes
+ *  - stride : bytes between two rows (multiple of GRAY_ALIGN, >= w)
+ *  - pixel (x, y) is data[y * stride + x], 0 = black (ink), 255 = white
+ */
+typedef struct {
+    int    w, h;
+    int    stride;
+    Uint8 *data;
+} GrayImage;
+
+/* Pointer to the first pixel of row y. */
+static inline Uint8 *gray_row(const GrayImage *img, int y)
+{
+    return img->data + (size_t)y * (size_t)img->stride;
+}
+
+/* The w x h window of img starting at (x, y), sharing its pixels: a header
+ * only, never passed to gray_free. Rows keep img's stride; the first pixel
+ * is no longer GRAY_ALIGN-aligned. */
+static inline GrayImage gray_sub(const GrayImage *img, int x, int y, int w, int h)
+{
+    GrayImage sub = { w, h, img->stride, gray_row(img, y) + x };
+    return sub;
+}
+
+/* Allocate a w x h plane filled with white. Returns NULL on error. */
+GrayImage *gray_create(int w, int h);
+
+/* Free a plane created by any gray_* function (NULL is accepted). */
+void gray_free(GrayImage *img);
+
+/* Deep copy of img. Returns NULL on error. */
+GrayImage *gray_clone(const GrayImage *img);
+
+/* Compute the luminance plane of a 32 bpp surface (any channel order).
+ * Pixels with alpha < 128 are considered background and become white.
+ * Returns NULL on error. */
+GrayImage *gray_from_surface(SDL_Surface *surface);
+
+/* Same as gray_from_surface, and fills histogram[256] with the luminance
+ * histogram during the same pass (histogram may be NULL). */
+GrayImage *gray_from_surface_hist(SDL_Surface *surface, int histogram[256]);
+
+/* Write img back into a surface of the same size as opaque gray pixels.
+ * Returns 0 on success, -1 on error. */
+int gray_to_surface(const GrayImage *img, SDL_Surface *surface);
+
+/* New RGBA8888 surface holding img (caller must SDL_FreeSurface).
+ * Returns NULL on error. */
+SDL_Surface *gray_to_new_surface(const GrayImage *img);
+
+/* Area-averaging resample of src to dw x dh (each destination pixel is the
+ * mean of the source area it covers; meant for downscaling).
+ * Returns NULL on error. */
+GrayImage *gray_resize_area(const GrayImage *src, int dw, int dh);
+
+/* ---- Packed binary plane ---------------------------------------------- */
+
+/* 1 bit per pixel, 64 pixels per word, bit (x & 63) of word x >> 6.
+ *  - bit set = black (ink), clear = white
+ *  - padding bits past w are always clear
+ */
+typedef struct {
+    int     w, h;
+    int     words;   // Uint64 words per row
+    Uint64 *bits;
+} BitImage;
+
+static inline Uint64 *bit_row(const BitImage *img, int y)
+{
+    return img->bits + (size_t)y * (size_t)img->words;
+}
+
+/* Allocate an all-white w x h bitmap. Returns NULL on error. */
+BitImage *bit_create(int w, int h);
+
+/* Free a bitmap (NULL is accepted). */
+void bit_free(BitImage *img);
+
+/* Pack w gray pixels into (w + 63) / 64 words: bit set where src == 0. */
+void bit_pack_row(const Uint8 *src, int w, Uint64 *dst);
+
+/* Bitmap of the black (== 0) pixels of img. Returns NULL on error. */
+BitImage *bit_from_gray(const GrayImage *img);
+
+/* Write bits back as 0 (set) / 255 (clear) into a plane of the same size.
+ * Returns 0 on success, -1 on error. */
+int bit_to_gray(const BitImage *bits, GrayImage *img);
+
+/* ---- Luminance kernels (gray_luma.c) ---------------------------------- */
+
+/* Kernel variants; GRAY_LUMA_AUTO picks the fastest one the CPU supports. */
+typedef enum {
+    GRAY_LUMA_AUTO = 0,
+    GRAY_LUMA_SCALAR,
+    GRAY_LUMA_SSE2,
+    GRAY_LUMA_AVX2
+} GrayLumaKernel;
+
+/* Force a kernel variant (the first conversion otherwise selects
+ * GRAY_LUMA_AUTO, once, whatever the thread). Call it before any
+ * conversion is dispatched. Returns 0 on success, -1 if the CPU lacks it. */
+int gray_luma_select(GrayLumaKernel k);
+
+/* Name of the kernel in use ("scalar", "sse2", "avx2"). */
+const char *gray_luma_name(void);
+
+/* Fixed-point luminance of n 32 bpp pixels laid out as described by fmt.
+ * All variants give the same bytes. With fold_alpha, pixels with
+ * alpha < 128 become white. */
+void gray_luma_row(const Uint32 *src, Uint8 *dst, int n,
+                   const SDL_PixelFormat *fmt, int fold_alpha);
+
+/* Same weights on n packed R, G, B byte triplets (PPM rows). */
+void gray_luma_rgb24(const Uint8 *src, Uint8 *dst, int n);
+
+#endif
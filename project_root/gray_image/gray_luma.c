@@ -0,0 +1,278 @@
+// gray_luma.c
+#include "gray_image.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GRAY_LUMA_X86 1
+#include <immintrin.h>
+#endif
+
+/* Luminance weights 0.299 / 0.587 / 0.114 in 1.15 fixed point (sum = 32768),
+ * so a pixel with r = g = b = v gives back exactly v. */
+#define LUMA_WR 9798
+#define LUMA_WG 19235
+#define LUMA_WB 3735
+
+/* Channel positions of a 32 bpp layout, resolved once per row. */
+typedef struct {
+    int rs, gs, bs;
+    int as;          // -1 : no alpha folding
+} LumaLayout;
+
+typedef void (*luma_row_fn)(const Uint32 *src, Uint8 *dst, int n,
+                            const LumaLayout *lay);
+
+/* ---------------------------------------------------------------------------
+ * Scalar kernel (reference, also used for the tails of the SIMD kernels)
+ * -------------------------------------------------------------------------- */
+
+static void luma_row_scalar(const Uint32 *src, Uint8 *dst, int n,
+                            const LumaLayout *lay)
+{
+    int rs = lay->rs, gs = lay->gs, bs = lay->bs, as = lay->as;
+
+    for (int x = 0; x < n; ++x) {
+        Uint32 v = src[x];
+        Uint32 r = (v >> rs) & 0xFF;
+        Uint32 g = (v >> gs) & 0xFF;
+        Uint32 b = (v >> bs) & 0xFF;
+        Uint32 l = (LUMA_WR * r + LUMA_WG * g + LUMA_WB * b) >> 15;
+
+        // Transparent pixels (e.g. rotation corners) are background
+        if (as >= 0 && ((v >> as) & 0xFF) < 128) l = 255;
+        dst[x] = (Uint8)l;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * SIMD kernels
+ *
+ * R and B sit 16 bits apart in every layout the app produces (ARGB8888,
+ * RGBA8888 and their BGR twins): after one shift and a 0x00FF00FF mask each
+ * 32-bit lane holds the pair [lo, hi] as two int16, and a single madd gives
+ * lo * w_lo + hi * w_hi. G is isolated the same way and madd'ed with
+ * [w_g, 0]. The result is bit-exact with luma_row_scalar.
+ * -------------------------------------------------------------------------- */
+
+#ifdef GRAY_LUMA_X86
+
+/* Shift of the lower of R/B and the matching packed weights, or -1 when the
+ * layout does not fit the [lo, hi] trick. */
+static int luma_pair(const LumaLayout *lay, int *w_pair)
+{
+    if (lay->bs + 16 == lay->rs) {
+        *w_pair = (LUMA_WR << 16) | LUMA_WB;
+        return lay->bs;
+    }
+    if (lay->rs + 16 == lay->bs) {
+        *w_pair = (LUMA_WB << 16) | LUMA_WR;
+        return lay->rs;
+    }
+    return -1;
+}
+
+__attribute__((target("sse2")))
+static inline __m128i luma4_sse2(__m128i v, __m128i sh_lo, __m128i sh_g,
+                                 __m128i sh_a, int fold, __m128i w_pair,
+                                 __m128i w_g)
+{
+    const __m128i m_pair = _mm_set1_epi32(0x00FF00FF);
+    const __m128i m_byte = _mm_set1_epi32(0xFF);
+
+    __m128i pair = _mm_and_si128(_mm_srl_epi32(v, sh_lo), m_pair);
+    __m128i g    = _mm_and_si128(_mm_srl_epi32(v, sh_g), m_byte);
+    __m128i acc  = _mm_add_epi32(_mm_madd_epi16(pair, w_pair),
+                                 _mm_madd_epi16(g, w_g));
+    __m128i l    = _mm_srli_epi32(acc, 15);
+
+    if (fold) {
+        // alpha < 128 <=> bit 7 of alpha is clear -> force white
+        __m128i a7 = _mm_and_si128(_mm_srl_epi32(v, sh_a), _mm_set1_epi32(1));
+        __m128i tr = _mm_cmpeq_epi32(a7, _mm_setzero_si128());
+        l = _mm_or_si128(l, _mm_and_si128(tr, m_byte));
+    }
+    return l;
+}
+
+__attribute__((target("sse2")))
+static void luma_row_sse2(const Uint32 *src, Uint8 *dst, int n,
+                          const LumaLayout *lay)
+{
+    int w = 0;
+    int lo = luma_pair(lay, &w);
+    if (lo < 0) {
+        luma_row_scalar(src, dst, n, lay);
+        return;
+    }
+
+    int fold = (lay->as >= 0);
+    __m128i sh_lo  = _mm_cvtsi32_si128(lo);
+    __m128i sh_g   = _mm_cvtsi32_si128(lay->gs);
+    __m128i sh_a   = _mm_cvtsi32_si128(fold ? lay->as + 7 : 0);
+    __m128i w_pair = _mm_set1_epi32(w);
+    __m128i w_g    = _mm_set1_epi32(LUMA_WG);
+
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        const __m128i *p = (const __m128i*)(src + x);
+        __m128i l0 = luma4_sse2(_mm_loadu_si128(p + 0), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m128i l1 = luma4_sse2(_mm_loadu_si128(p + 1), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m128i l2 = luma4_sse2(_mm_loadu_si128(p + 2), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m128i l3 = luma4_sse2(_mm_loadu_si128(p + 3), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+
+        __m128i w01 = _mm_packs_epi32(l0, l1);
+        __m128i w23 = _mm_packs_epi32(l2, l3);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(w01, w23));
+    }
+    if (x < n) luma_row_scalar(src + x, dst + x, n - x, lay);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i luma8_avx2(__m256i v, __m128i sh_lo, __m128i sh_g,
+                                 __m128i sh_a, int fold, __m256i w_pair,
+                                 __m256i w_g)
+{
+    const __m256i m_pair = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i m_byte = _mm256_set1_epi32(0xFF);
+
+    __m256i pair = _mm256_and_si256(_mm256_srl_epi32(v, sh_lo), m_pair);
+    __m256i g    = _mm256_and_si256(_mm256_srl_epi32(v, sh_g), m_byte);
+    __m256i acc  = _mm256_add_epi32(_mm256_madd_epi16(pair, w_pair),
+                                    _mm256_madd_epi16(g, w_g));
+    __m256i l    = _mm256_srli_epi32(acc, 15);
+
+    if (fold) {
+        __m256i a7 = _mm256_and_si256(_mm256_srl_epi32(v, sh_a),
+                                      _mm256_set1_epi32(1));
+        __m256i tr = _mm256_cmpeq_epi32(a7, _mm256_setzero_si256());
+        l = _mm256_or_si256(l, _mm256_and_si256(tr, m_byte));
+    }
+    return l;
+}
+
+__attribute__((target("avx2")))
+static void luma_row_avx2(const Uint32 *src, Uint8 *dst, int n,
+                          const LumaLayout *lay)
+{
+    int w = 0;
+    int lo = luma_pair(lay, &w);
+    if (lo < 0) {
+        luma_row_scalar(src, dst, n, lay);
+        return;
+    }
+
+    int fold = (lay->as >= 0);
+    __m128i sh_lo  = _mm_cvtsi32_si128(lo);
+    __m128i sh_g   = _mm_cvtsi32_si128(lay->gs);
+    __m128i sh_a   = _mm_cvtsi32_si128(fold ? lay->as + 7 : 0);
+    __m256i w_pair = _mm256_set1_epi32(w);
+    __m256i w_g    = _mm256_set1_epi32(LUMA_WG);
+    // packs/packus work per 128-bit lane: put the dwords back in order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int x = 0;
+    for (; x + 32 <= n; x += 32) {
+        const __m256i *p = (const __m256i*)(src + x);
+        __m256i l0 = luma8_avx2(_mm256_loadu_si256(p + 0), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m256i l1 = luma8_avx2(_mm256_loadu_si256(p + 1), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m256i l2 = luma8_avx2(_mm256_loadu_si256(p + 2), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+        __m256i l3 = luma8_avx2(_mm256_loadu_si256(p + 3), sh_lo, sh_g, sh_a, fold, w_pair, w_g);
+
+        __m256i w01 = _mm256_packs_epi32(l0, l1);
+        __m256i w23 = _mm256_packs_epi32(l2, l3);
+        __m256i b   = _mm256_packus_epi16(w01, w23);
+        _mm256_storeu_si256((__m256i*)(dst + x),
+                            _mm256_permutevar8x32_epi32(b, order));
+    }
+    if (x < n) luma_row_sse2(src + x, dst + x, n - x, lay);
+}
+
+#endif /* GRAY_LUMA_X86 */
+
+/* ---------------------------------------------------------------------------
+ * Runtime dispatch
+ * -------------------------------------------------------------------------- */
+
+static luma_row_fn luma_impl = NULL;
+static const char *luma_impl_name = "scalar";
+
+/* Conversions run inside parallel_for() bands, so the default kernel is
+ * resolved exactly once, under pthread_once, before any band reads it. */
+static pthread_once_t luma_once = PTHREAD_ONCE_INIT;
+
+static int luma_supported(GrayLumaKernel k)
+{
+    switch (k) {
+    case GRAY_LUMA_SCALAR:
+        return 1;
+#ifdef GRAY_LUMA_X86
+    case GRAY_LUMA_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case GRAY_LUMA_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+int gray_luma_select(GrayLumaKernel k)
+{
+    if (k == GRAY_LUMA_AUTO) {
+        if (luma_supported(GRAY_LUMA_AVX2)) k = GRAY_LUMA_AVX2;
+        else if (luma_supported(GRAY_LUMA_SSE2)) k = GRAY_LUMA_SSE2;
+        else k = GRAY_LUMA_SCALAR;
+    }
+    if (!luma_supported(k)) return -1;
+
+    switch (k) {
+#ifdef GRAY_LUMA_X86
+    case GRAY_LUMA_SSE2:
+        luma_impl = luma_row_sse2;
+        luma_impl_name = "sse2";
+        break;
+    case GRAY_LUMA_AVX2:
+        luma_impl = luma_row_avx2;
+        luma_impl_name = "avx2";
+        break;
+#endif
+    default:
+        luma_impl = luma_row_scalar;
+        luma_impl_name = "scalar";
+        break;
+    }
+    return 0;
+}
+
+static void luma_init(void)
+{
+    if (!luma_impl) gray_luma_select(GRAY_LUMA_AUTO);
+}
+
+const char *gray_luma_name(void)
+{
+    pthread_once(&luma_once, luma_init);
+    return luma_impl_name;
+}
+
+void gray_luma_row(const Uint32 *src, Uint8 *dst, int n,
+                   const SDL_PixelFormat *fmt, int fold_alpha)
+{
+    pthread_once(&luma_once, luma_init);
+
+    LumaLayout lay = {
+        fmt->Rshift, fmt->Gshift, fmt->Bshift,
+        (fold_alpha && fmt->Amask) ? fmt->Ashift : -1
+    };
+    luma_impl(src, dst, n, &lay);
+}
+
+void gray_luma_rgb24(const Uint8 *src, Uint8 *dst, int n)
+{
+    for (int x = 0; x < n; ++x) {
+        const Uint8 *p = src + 3 * (size_t)x;
+        dst[x] = (Uint8)((LUMA_WR * p[0] + LUMA_WG * p[1] + LUMA_WB * p[2]) >> 15);
+    }
+}
@@ -1,79 +1,125 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <err.h>
+#include "image_cleaner.h"
+#include "../thread_pool/thread_pool.h"
 
-#define GRAY_LEVELS 256
+//plus petite bande de lignes confiee a un thread
+#define CLEANER_MIN_ROWS 16
 
-void convert_to_grayscale(SDL_Surface* surface) {
-    if (!surface) return;
+static inline Uint32* surface_row(SDL_Surface* surface, int y) {
+    return (Uint32*)((Uint8*)surface->pixels + (size_t)y * surface->pitch);
+}
 
-    int width = surface->w;
-    int height = surface->h;
+//additionne les histogrammes par bande dans l'ordre des bandes
+static void merge_histograms(int (*partial)[GRAY_LEVELS], int nbands,
+                             int histogram[GRAY_LEVELS]) {
+    memset(histogram, 0, sizeof(int) * GRAY_LEVELS);
+    for (int b = 0; b < nbands; b++) {
+        for (int i = 0; i < GRAY_LEVELS; i++) {
+            histogram[i] += partial[b][i];
+        }
+    }
+}
 
-    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+static void grayscale_band(void* arg, int y0, int y1, int band) {
+    SDL_Surface* surface = arg;
+    (void)band;
 
-    for (int y = 0; y < height; y++) {
+    // Luminance d'une ligne via le noyau SIMD choisi au démarrage
+    Uint8* line = malloc((size_t)surface->w);
+    if (!line) errx(1, "Line allocation failed in convert to grayscale");
 
-        for (int x = 0; x < width; x++) {
-            Uint32* pixels = (Uint32*)surface->pixels;
-            Uint32 pixel = pixels[y * surface->pitch / 4 + x];
+    const SDL_PixelFormat* fmt = surface->format;
+    int rs = fmt->Rshift, gs = fmt->Gshift, bs = fmt->Bshift;
+    Uint32 amask = fmt->Amask;
 
-            Uint8 r, g, b;
-            SDL_GetRGB(pixel, surface->format, &r, &g, &b);
+    for (int y = y0; y < y1; y++) {
+        Uint32* pixels = surface_row(surface, y);
 
-            Uint8 gray = (Uint8)(0.299*r + 0.587*g + 0.114*b);
+        gray_luma_row(pixels, line, surface->w, fmt, 0);
 
-            Uint32 gray_pixel = SDL_MapRGB(surface->format, gray, gray, gray);
-            pixels[y * surface->pitch / 4 + x] = gray_pixel;
+        for (int x = 0; x < surface->w; x++) {
+            Uint32 gray = line[x];
+            pixels[x] = (gray << rs) | (gray << gs) | (gray << bs) | amask;
         }
+    }
 
+    free(line);
+}
 
+void convert_to_grayscale(SDL_Surface* surface) {
+    if (!surface) return;
+    if (surface->format->BytesPerPixel != 4) {
+        fprintf(stderr, "convert_to_grayscale: 32 bpp surface expected\n");
+        return;
     }
 
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    parallel_for(surface->h, CLEANER_MIN_ROWS, grayscale_band, surface);
     if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
 }
 
 
 
-void compute_histogram(SDL_Surface* surface, int histogram[GRAY_LEVELS]) {
-    if (!surface) errx(1, "Surface is NULL");
-    memset(histogram, 0, sizeof(int) * GRAY_LEVELS);
-
-    int width = surface->w;
-    int height = surface->h;
-
-    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
-    Uint32* pixels = (Uint32*)surface->pixels;
+typedef struct {
+    SDL_Surface* surface;
+    int (*partial)[GRAY_LEVELS];   // un histogramme par bande
+} HistogramJob;
 
-    for (int y = 0; y < height; y++) {
+static void histogram_band(void* arg, int y0, int y1, int band) {
+    HistogramJob* job = arg;
+    SDL_Surface* surface = job->surface;
+    int* histogram = job->partial[band];
 
-        for (int x = 0; x < width; x++) {
-            Uint32 pixel = pixels[y * surface->pitch / 4 + x];
+    memset(histogram, 0, sizeof(int) * GRAY_LEVELS);
+    for (int y = y0; y < y1; y++) {
+        const Uint32* pixels = surface_row(surface, y);
+        for (int x = 0; x < surface->w; x++) {
             Uint8 r;
             Uint8 g;
             Uint8 b;
-            SDL_GetRGB(pixel, surface->format, &r, &g, &b);
+            SDL_GetRGB(pixels[x], surface->format, &r, &g, &b);
             histogram[r]++;
         }
-
     }
+}
+
+void compute_histogram(SDL_Surface* surface, int histogram[GRAY_LEVELS]) {
+    if (!surface) errx(1, "Surface is NULL");
+
+    int partial[THREAD_POOL_MAX][GRAY_LEVELS];
+    HistogramJob job = {surface, partial};
+    int nbands = parallel_bands(surface->h, CLEANER_MIN_ROWS);
 
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    parallel_for(surface->h, CLEANER_MIN_ROWS, histogram_band, &job);
     if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+
+    merge_histograms(partial, nbands, histogram);
+}
+
+int compute_otsu_threshold(const int histogram[GRAY_LEVELS], int total_pixels) {
+    long long wide[GRAY_LEVELS];
+    for (int i = 0; i < GRAY_LEVELS; i++) wide[i] = histogram[i];
+    return compute_otsu_threshold_wide(wide, total_pixels);
 }
 
-int compute_otsu_threshold(int histogram[GRAY_LEVELS], int total_pixels) {
+int compute_otsu_threshold_wide(const long long histogram[GRAY_LEVELS],
+                                long long total_pixels) {
 
     double sum_total = 0.0f;
 
     for (int i = 0; i < GRAY_LEVELS; i++) {
-        sum_total += i * histogram[i];
+        sum_total += (double)i * (double)histogram[i];
     }
 
     double sum_background = 0.0f;
-    int weight_background = 0;
+    long long weight_background = 0;
     double max_variance = 0.0f;
     int threshold = 0;
 
@@ -87,11 +133,11 @@ int compute_otsu_threshold(int histogram[GRAY_LEVELS], int total_pixels) {
         if (weight_background == 0) continue;
 
         //calcule le poid du foreground actuel et si le poid est 0 on sort
-        int weight_foreground = total_pixels - weight_background;
+        long long weight_foreground = total_pixels - weight_background;
         if (weight_foreground == 0) break;
 
         // ajoute a la somme la masse de cette valeur de gris pour tout les pixels ayant cette valeure precise
-        sum_background += y * histogram[y];
+        sum_background += (double)y * (double)histogram[y];
 
         //Calcule la moyenne des intensites pour le fond et le premier plan
         double mean_background = sum_background / (double)weight_background;
@@ -114,96 +160,885 @@ int compute_otsu_threshold(int histogram[GRAY_LEVELS], int total_pixels) {
 }
 
 
-void apply_threshold(SDL_Surface* surface, int threshold) {
-    int width = surface->w;
-    int height = surface->h;
+typedef struct {
+    SDL_Surface* surface;
+    int threshold;
+} ThresholdJob;
 
-    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
-    Uint32* pixels = (Uint32*)surface->pixels;
+static void threshold_band(void* arg, int y0, int y1, int band) {
+    ThresholdJob* job = arg;
+    SDL_Surface* surface = job->surface;
+    (void)band;
 
-    for (int y = 0; y < height; y++) {
+    for (int y = y0; y < y1; y++) {
+        Uint32* pixels = surface_row(surface, y);
 
-        for (int x = 0; x < width; x++) {
-            Uint32 pixel = pixels[y * surface->pitch / 4 + x];
+        for (int x = 0; x < surface->w; x++) {
             Uint8 r;
             Uint8 g;
             Uint8 b;
-            SDL_GetRGB(pixel, surface->format, &r, &g, &b);
+            SDL_GetRGB(pixels[x], surface->format, &r, &g, &b);
 
             Uint8 value =0;
-            if(r >= threshold){
+            if(r >= job->threshold){
                 value = 255;
             }else{
                 value = 0;
             }
 
-            pixels[y*surface->pitch / 4+x] = SDL_MapRGB(surface->format, value, value, value);
+            pixels[x] = SDL_MapRGB(surface->format, value, value, value);
         }
-
     }
+}
 
+void apply_threshold(SDL_Surface* surface, int threshold) {
+    ThresholdJob job = {surface, threshold};
+
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    parallel_for(surface->h, CLEANER_MIN_ROWS, threshold_band, &job);
     if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
 }
 
+typedef struct {
+    SDL_Surface*     surface;
+    const GrayImage* gray;
+    Uint32           lut[GRAY_LEVELS];
+} SurfaceLutJob;
+
+static void surface_lut_band(void* arg, int y0, int y1, int band) {
+    SurfaceLutJob* job = arg;
+    (void)band;
+
+    for (int y = y0; y < y1; y++) {
+        const Uint8* src = gray_row(job->gray, y);
+        Uint32* dst = surface_row(job->surface, y);
+        for (int x = 0; x < job->gray->w; x++) {
+            dst[x] = job->lut[src[x]];
+        }
+    }
+}
+
 void apply_otsu_thresholding(SDL_Surface* surface) {
     if (!surface) errx(1, "Surface is NULL");
 
+    // Passe 1 : luminance + histogramme
     int histogram[GRAY_LEVELS];
-    compute_histogram(surface, histogram);
+    GrayImage* gray = gray_from_surface_hist(surface, histogram);
+    if (!gray) errx(1, "Luminance allocation failed in otsu thresholding");
 
-    int total_pixels = surface->w * surface->h;
-    int threshold = compute_otsu_threshold(histogram, total_pixels);
+    int threshold = compute_otsu_threshold(histogram, gray->w * gray->h);
 
-    apply_threshold(surface, threshold);
+    // Passe 2 : seuillage par table, reecrit directement en pixels 32 bits
+    if (surface->format->BytesPerPixel == 4) {
+        SurfaceLutJob job;
+        job.surface = surface;
+        job.gray = gray;
+        Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+        Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+        for (int i = 0; i < GRAY_LEVELS; i++) {
+            job.lut[i] = (i >= threshold) ? white : black;
+        }
+
+        if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+        parallel_for(gray->h, CLEANER_MIN_ROWS, surface_lut_band, &job);
+        if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+    } else {
+        apply_threshold(surface, threshold);
+    }
+
+    gray_free(gray);
 }
 
 
 
 
+typedef struct {
+    SDL_Surface*    surface;
+    BitImage*       bits;
+    const BitImage* before;
+    Uint32          black, white;
+} SurfaceBitsJob;
+
+//bit a 1 pour les pixels exactement noirs de la surface
+static void surface_pack_band(void* arg, int begin, int end, int band) {
+    SurfaceBitsJob* job = arg;
+    int width = job->surface->w;
+    Uint32 black = job->black;
+    (void)band;
+
+    for (int y = begin; y < end; y++) {
+        const Uint32* row = surface_row(job->surface, y);
+        Uint64* dst = bit_row(job->bits, y);
+        for (int x0 = 0; x0 < width; x0 += 64) {
+            int n = width - x0 < 64 ? width - x0 : 64;
+            Uint64 m = 0;
+            for (int i = 0; i < n; i++) {
+                m |= (Uint64)(row[x0 + i] == black) << i;
+            }
+            dst[x0 >> 6] = m;
+        }
+    }
+}
+
+//les pixels noirs dont le bit a ete efface deviennent blancs
+static void surface_unpack_band(void* arg, int begin, int end, int band) {
+    SurfaceBitsJob* job = arg;
+    int words = job->bits->words;
+    (void)band;
+
+    for (int y = begin; y < end; y++) {
+        Uint32* row = surface_row(job->surface, y);
+        const Uint64* now = bit_row(job->bits, y);
+        const Uint64* was = bit_row(job->before, y);
+        for (int i = 0; i < words; i++) {
+            Uint64 cleared = was[i] & ~now[i];
+            while (cleared) {
+                int b = __builtin_ctzll(cleared);
+                row[(i << 6) + b] = job->white;
+                cleared &= cleared - 1;
+            }
+        }
+    }
+}
+
+/* Le debruitage se fait sur les pixels noirs empaquetes (bit_noise_removal)
+ * au lieu d'une copie 32 bits de toute la surface : meme resultat, et seuls
+ * les pixels effaces sont reecrits. */
 void apply_noise_removal(SDL_Surface* surface, int threshold) {
     if (!surface) return;
 
-    int width  = surface->w;
-    int height = surface->h;
-    int stride = surface->pitch / 4;
-
     if (SDL_MUSTLOCK(surface)) {
         SDL_LockSurface(surface);
     }
 
-    size_t nPixels = (size_t)stride * height;
-    Uint32 *copy = malloc(nPixels * sizeof(Uint32));
+    BitImage* bits = bit_create(surface->w, surface->h);
+    BitImage* before = bit_create(surface->w, surface->h);
+    if (!bits || !before) errx(1, "Bitmap allocation failed in apply noise removal");
 
-    if (!copy) errx(1, "Copy allocation failed in apply noise removal");
+    //converti les couleurs en format utilisable sur la surface
+    SurfaceBitsJob job;
+    job.surface = surface;
+    job.bits = bits;
+    job.before = before;
+    job.black = SDL_MapRGB(surface->format, 0,0,0);
+    job.white = SDL_MapRGB(surface->format, 255,255,255);
 
-    memcpy(copy, surface->pixels, nPixels * sizeof(Uint32));
+    parallel_for(surface->h, CLEANER_MIN_ROWS, surface_pack_band, &job);
+    memcpy(before->bits, bits->bits, (size_t)bits->words * bits->h * sizeof(Uint64));
+    bit_noise_removal(bits, threshold);
+    parallel_for(surface->h, CLEANER_MIN_ROWS, surface_unpack_band, &job);
 
-    //converti les couleurs en format utilisable sur la surface
-    Uint32 black = SDL_MapRGB(surface->format, 0,0,0);
-    Uint32 white = SDL_MapRGB(surface->format, 255,255,255);
-
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            size_t idx = (size_t)y * stride + x;
-            if (copy[idx] != black) continue; 
-
-            int black_neighbors = 0;
-
-            //check les voisins du pixel
-            for (int dy = -1; dy <= 1; dy++) {
-                for (int dx = -1; dx <= 1; dx++) {
-                    size_t nidx = (size_t)(y + dy) * stride + (x + dx);
-                    if (copy[nidx] == black) black_neighbors++;
-                }
+    bit_free(before);
+    bit_free(bits);
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Versions travaillant directement sur le plan de luminance (GrayImage)
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const GrayImage* img;
+    int (*partial)[GRAY_LEVELS];
+} GrayHistogramJob;
+
+static void gray_histogram_band(void* arg, int y0, int y1, int band) {
+    GrayHistogramJob* job = arg;
+    int* histogram = job->partial[band];
+
+    memset(histogram, 0, sizeof(int) * GRAY_LEVELS);
+    for (int y = y0; y < y1; y++) {
+        const Uint8* row = gray_row(job->img, y);
+        for (int x = 0; x < job->img->w; x++) {
+            histogram[row[x]]++;
+        }
+    }
+}
+
+void apply_otsu_thresholding_gray(GrayImage* img) {
+    if (!img) errx(1, "Gray image is NULL");
+
+    int partial[THREAD_POOL_MAX][GRAY_LEVELS];
+    GrayHistogramJob job = {img, partial};
+    int nbands = parallel_bands(img->h, CLEANER_MIN_ROWS);
+    parallel_for(img->h, CLEANER_MIN_ROWS, gray_histogram_band, &job);
+
+    int histogram[GRAY_LEVELS];
+    merge_histograms(partial, nbands, histogram);
+
+    apply_otsu_thresholding_hist(img, histogram, NULL);
+}
+
+typedef struct {
+    GrayImage* img;
+    BitImage*  bits;
+    Uint8      lut[GRAY_LEVELS];
+} GrayLutJob;
+
+static void gray_lut_band(void* arg, int y0, int y1, int band) {
+    GrayLutJob* job = arg;
+    (void)band;
+
+    for (int y = y0; y < y1; y++) {
+        Uint8* row = gray_row(job->img, y);
+        for (int x = 0; x < job->img->w; x++) {
+            row[x] = job->lut[row[x]];
+        }
+
+        //empaquette la ligne binaire : 1 bit par pixel, 1 = noir
+        if (job->bits) bit_pack_row(row, job->img->w, bit_row(job->bits, y));
+    }
+}
+
+int apply_otsu_thresholding_hist(GrayImage* img, const int histogram[GRAY_LEVELS],
+                                 BitImage** mask) {
+    if (!img) errx(1, "Gray image is NULL");
+
+    int threshold = compute_otsu_threshold(histogram, img->w * img->h);
+
+    GrayLutJob job;
+    job.img = img;
+    for (int i = 0; i < GRAY_LEVELS; i++) {
+        job.lut[i] = (i >= threshold) ? 255 : 0;
+    }
+
+    job.bits = NULL;
+    if (mask) {
+        job.bits = bit_create(img->w, img->h);
+        if (!job.bits) fprintf(stderr, "apply_otsu_thresholding_hist: mask allocation failed\n");
+        *mask = job.bits;
+    }
+
+    parallel_for(img->h, CLEANER_MIN_ROWS, gray_lut_band, &job);
+
+    return threshold;
+}
+
+/* ---------------------------------------------------------------------------
+ * Debruitage sur lignes empaquetees (64 pixels par mot)
+ *
+ * Meme regle que apply_noise_removal : un pixel noir interieur dont le 3x3
+ * (lui compris) contient <= threshold pixels noirs devient blanc. Les 9
+ * voisins sont comptes en parallele sur 64 pixels avec des additionneurs
+ * bit a bit (compteur 4 bits, max 9), puis compares au seuil.
+ * -------------------------------------------------------------------------- */
+
+//voisins ouest / est d'un mot, avec la retenue du mot adjacent
+static inline Uint64 bits_west(const Uint64* r, int i) {
+    return (r[i] << 1) | (i > 0 ? r[i - 1] >> 63 : 0);
+}
+
+static inline Uint64 bits_east(const Uint64* r, int i, int words) {
+    return (r[i] >> 1) | (i + 1 < words ? r[i + 1] << 63 : 0);
+}
+
+//a + b + c sur 64 colonnes : bit de poids 1 et retenue de poids 2
+static inline void add3_bits(Uint64 a, Uint64 b, Uint64 c, Uint64* s, Uint64* carry) {
+    *s = a ^ b ^ c;
+    *carry = (a & b) | (c & (a ^ b));
+}
+
+/* Calcule dans out les pixels a effacer de la ligne mid (up et dn sont les
+ * lignes voisines d'origine). Les colonnes 0 et w - 1 ne sont jamais
+ * effacees, comme dans la version par pixel. */
+static void denoise_row_bits(const Uint64* up, const Uint64* mid, const Uint64* dn,
+                             Uint64* out, int words, int w, int threshold) {
+    //le pixel se compte lui-meme : seuil < 1 n'efface rien
+    if (threshold < 1) {
+        memset(out, 0, (size_t)words * sizeof(Uint64));
+        return;
+    }
+    if (threshold > 15) threshold = 15;
+
+    for (int i = 0; i < words; i++) {
+        Uint64 c = mid[i];
+        if (!c) {
+            out[i] = 0;
+            continue;
+        }
+
+        //somme horizontale de chaque ligne (0..3)
+        Uint64 a0, a1, b0, b1, d0, d1;
+        add3_bits(bits_west(up, i), up[i], bits_east(up, i, words), &a0, &a1);
+        add3_bits(bits_west(mid, i), c, bits_east(mid, i, words), &b0, &b1);
+        add3_bits(bits_west(dn, i), dn[i], bits_east(dn, i, words), &d0, &d1);
+
+        //somme des trois lignes : n = n0 + 2 n1 + 4 n2 + 8 n3
+        Uint64 n[4], k1, t0, t1;
+        add3_bits(a0, b0, d0, &n[0], &k1);
+        add3_bits(a1, b1, d1, &t0, &t1);
+        n[1] = t0 ^ k1;
+        Uint64 k2 = t0 & k1;
+        n[2] = t1 ^ k2;
+        n[3] = t1 & k2;
+
+        //n > threshold, compare du poids fort au poids faible
+        Uint64 gt = 0, eq = ~(Uint64)0;
+        for (int b = 3; b >= 0; b--) {
+            if ((threshold >> b) & 1) {
+                eq &= n[b];
+            } else {
+                gt |= eq & n[b];
+                eq &= ~n[b];
             }
+        }
+
+        out[i] = c & ~gt;
+    }
+
+    //les colonnes de bord ne bougent pas
+    out[0] &= ~(Uint64)1;
+    out[(w - 1) >> 6] &= ~((Uint64)1 << ((w - 1) & 63));
+}
 
-            //si pas assez de voisons noirs le pixel noir devient un pixel blanc
-            if (black_neighbors <= threshold) {
-                ((Uint32*)surface->pixels)[idx] = white;
+/* Debruitage en parallele : chaque bande de lignes [y0, y1) lit les lignes
+ * d'origine y0 - 1 et y1, que les bandes voisines modifient. Elles sont
+ * empaquetees avant le lancement (lignes de halo, 2 par bande). */
+typedef struct {
+    GrayImage* img;
+    BitImage*  bits;      // l'un ou l'autre
+    int        threshold;
+    int        words;
+    Uint64*    halo;      // bande b : halo[2b] = ligne y0 - 1, halo[2b + 1] = ligne y1
+} DenoiseJob;
+
+static Uint64* halo_row(const DenoiseJob* job, int band, int which) {
+    return job->halo + ((size_t)band * 2 + which) * job->words;
+}
+
+//pixels interieurs [1, h - 1) : n = h - 2 lignes, bande [1 + begin, 1 + end)
+static int denoise_prepare(DenoiseJob* job, int h) {
+    int n = h - 2;
+    int nbands = parallel_bands(n, CLEANER_MIN_ROWS);
+
+    job->halo = malloc((size_t)nbands * 2 * job->words * sizeof(Uint64));
+    if (!job->halo) return -1;
+
+    for (int b = 0; b < nbands; b++) {
+        int y0 = 1 + parallel_band_begin(n, nbands, b);
+        int y1 = 1 + parallel_band_begin(n, nbands, b + 1);
+        if (job->img) {
+            bit_pack_row(gray_row(job->img, y0 - 1), job->img->w, halo_row(job, b, 0));
+            bit_pack_row(gray_row(job->img, y1), job->img->w, halo_row(job, b, 1));
+        } else {
+            size_t sz = (size_t)job->words * sizeof(Uint64);
+            memcpy(halo_row(job, b, 0), bit_row(job->bits, y0 - 1), sz);
+            memcpy(halo_row(job, b, 1), bit_row(job->bits, y1), sz);
+        }
+    }
+    return 0;
+}
+
+static void denoise_gray_band(void* arg, int begin, int end, int band) {
+    DenoiseJob* job = arg;
+    GrayImage* img = job->img;
+    int width = img->w;
+    int words = job->words;
+    size_t sz = (size_t)words * sizeof(Uint64);
+    int y0 = 1 + begin, y1 = 1 + end;
+
+    //anneau de 3 lignes d'origine empaquetees (y - 1, y, y + 1) + masque
+    Uint64* ring = malloc(sz * 4);
+    if (!ring) errx(1, "Row buffer allocation failed in apply noise removal");
+    Uint64* rows[3] = {ring, ring + words, ring + 2 * words};
+    Uint64* clear = ring + 3 * words;
+
+    memcpy(rows[0], halo_row(job, band, 0), sz);
+    bit_pack_row(gray_row(img, y0), width, rows[1]);
+
+    for (int y = y0; y < y1; y++) {
+        //la ligne y + 1 n'est pas encore modifiee, sauf si c'est le halo
+        if (y + 1 == y1) memcpy(rows[2], halo_row(job, band, 1), sz);
+        else bit_pack_row(gray_row(img, y + 1), width, rows[2]);
+
+        denoise_row_bits(rows[0], rows[1], rows[2], clear, words, width, job->threshold);
+
+        Uint8* dst = gray_row(img, y);
+        for (int i = 0; i < words; i++) {
+            for (Uint64 m = clear[i]; m; m &= m - 1) {
+                dst[i * 64 + __builtin_ctzll(m)] = 255;
             }
         }
+
+        Uint64* t = rows[0];
+        rows[0] = rows[1];
+        rows[1] = rows[2];
+        rows[2] = t;
     }
 
-    free(copy);
-    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
-}
\ No newline at end of file
+    free(ring);
+}
+
+void apply_noise_removal_gray(GrayImage* img, int threshold) {
+    if (!img) return;
+    if (img->w < 3 || img->h < 3) return;
+
+    DenoiseJob job = {img, NULL, threshold, (img->w + 63) >> 6, NULL};
+    if (denoise_prepare(&job, img->h) != 0)
+        errx(1, "Halo allocation failed in apply noise removal");
+
+    parallel_for(img->h - 2, CLEANER_MIN_ROWS, denoise_gray_band, &job);
+    free(job.halo);
+}
+
+static void denoise_bits_band(void* arg, int begin, int end, int band) {
+    DenoiseJob* job = arg;
+    BitImage* img = job->bits;
+    int words = job->words;
+    size_t sz = (size_t)words * sizeof(Uint64);
+    int y0 = 1 + begin, y1 = 1 + end;
+
+    //seule la ligne y - 1 (deja modifiee) et la ligne y doivent etre gardees
+    Uint64* ring = malloc(sz * 3);
+    if (!ring) errx(1, "Row buffer allocation failed in bit noise removal");
+    Uint64* prev = ring;
+    Uint64* cur = ring + words;
+    Uint64* clear = ring + 2 * words;
+
+    memcpy(prev, halo_row(job, band, 0), sz);
+
+    for (int y = y0; y < y1; y++) {
+        Uint64* row = bit_row(img, y);
+        memcpy(cur, row, sz);
+
+        const Uint64* next = (y + 1 == y1) ? halo_row(job, band, 1) : bit_row(img, y + 1);
+        denoise_row_bits(prev, cur, next, clear, words, img->w, job->threshold);
+        for (int i = 0; i < words; i++) row[i] &= ~clear[i];
+
+        Uint64* t = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    free(ring);
+}
+
+void bit_noise_removal(BitImage* img, int threshold) {
+    if (!img) return;
+    if (img->w < 3 || img->h < 3) return;
+
+    DenoiseJob job = {NULL, img, threshold, img->words, NULL};
+    if (denoise_prepare(&job, img->h) != 0)
+        errx(1, "Halo allocation failed in bit noise removal");
+
+    parallel_for(img->h - 2, CLEANER_MIN_ROWS, denoise_bits_band, &job);
+    free(job.halo);
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Seuillage adaptatif (Sauvola / Bradley) par images integrales
+ *
+ * Les images integrales (somme et somme des carres) sont en Uint32 : elles
+ * debordent sur une grande page, mais la difference des 4 coins reste exacte
+ * en arithmetique modulo 2^32 tant que la somme d'une fenetre tient sur 32
+ * bits, d'ou la fenetre limitee a ADAPTIVE_MAX_WINDOW : 255 x 255 pixels
+ * de carre au plus 255^2 donnent 255^4 ~ 4,23e9 < 2^32 ~ 4,29e9.
+ * -------------------------------------------------------------------------- */
+
+#define ADAPTIVE_MAX_WINDOW 255
+#define ADAPTIVE_MIN_BAND 32
+
+static ThresholdMethod current_method = THRESHOLD_OTSU;
+
+void set_threshold_method(ThresholdMethod method) {
+    current_method = method;
+}
+
+ThresholdMethod get_threshold_method(void) {
+    return current_method;
+}
+
+const char* threshold_method_name(ThresholdMethod method) {
+    switch (method) {
+    case THRESHOLD_SAUVOLA: return "Sauvola";
+    case THRESHOLD_BRADLEY: return "Bradley";
+    default:                return "Otsu";
+    }
+}
+
+typedef struct {
+    GrayImage* img;
+    Uint32*    sum;      // (w + 1) x (h + 1), ligne et colonne 0 a zero
+    Uint32*    sq;       // idem pour les carres (NULL pour Bradley)
+    int        istride;  // w + 1
+    int        half;     // demi-fenetre
+    ThresholdMethod method;
+    double     k;        // Sauvola
+    int        t;        // Bradley (pourcentage)
+} AdaptiveCtx;
+
+//passe 1 : sommes prefixes horizontales de chaque ligne
+static void integral_rows(void* arg, int y0, int y1, int band) {
+    AdaptiveCtx* c = arg;
+    (void)band;
+    for (int y = y0; y < y1; y++) {
+        const Uint8* row = gray_row(c->img, y);
+        Uint32* s = c->sum + (size_t)(y + 1) * c->istride;
+        Uint32* q = c->sq ? c->sq + (size_t)(y + 1) * c->istride : NULL;
+        Uint32 acc = 0, acc2 = 0;
+        s[0] = 0;
+        if (q) q[0] = 0;
+        for (int x = 0; x < c->img->w; x++) {
+            Uint32 v = row[x];
+            acc += v;
+            s[x + 1] = acc;
+            if (q) {
+                acc2 += v * v;
+                q[x + 1] = acc2;
+            }
+        }
+    }
+}
+
+//passe 2 : cumul vertical, par bandes de colonnes
+static void integral_cols(void* arg, int x0, int x1, int band) {
+    AdaptiveCtx* c = arg;
+    (void)band;
+    for (int y = 2; y <= c->img->h; y++) {
+        Uint32* s = c->sum + (size_t)y * c->istride;
+        const Uint32* sp = s - c->istride;
+        for (int x = x0 + 1; x <= x1; x++) s[x] += sp[x];
+        if (c->sq) {
+            Uint32* q = c->sq + (size_t)y * c->istride;
+            const Uint32* qp = q - c->istride;
+            for (int x = x0 + 1; x <= x1; x++) q[x] += qp[x];
+        }
+    }
+}
+
+//passe 3 : seuil local de chaque pixel, par bandes de lignes
+static void adaptive_rows(void* arg, int y0, int y1, int band) {
+    AdaptiveCtx* c = arg;
+    (void)band;
+    int w = c->img->w, h = c->img->h, half = c->half;
+    const Uint32* I = c->sum;
+    const Uint32* Q = c->sq;
+    int is = c->istride;
+
+    for (int y = y0; y < y1; y++) {
+        int ya = y - half < 0 ? 0 : y - half;
+        int yb = y + half + 1 > h ? h : y + half + 1;
+        const Uint32* ia = I + (size_t)ya * is;
+        const Uint32* ib = I + (size_t)yb * is;
+        const Uint32* qa = Q ? Q + (size_t)ya * is : NULL;
+        const Uint32* qb = Q ? Q + (size_t)yb * is : NULL;
+        Uint8* row = gray_row(c->img, y);
+
+        for (int x = 0; x < w; x++) {
+            int xa = x - half < 0 ? 0 : x - half;
+            int xb = x + half + 1 > w ? w : x + half + 1;
+            Uint32 n = (Uint32)((yb - ya) * (xb - xa));
+            Uint32 s = ib[xb] - ib[xa] - ia[xb] + ia[xa];   // exact modulo 2^32
+            Uint32 v = row[x];
+
+            int black;
+            if (c->method == THRESHOLD_SAUVOLA) {
+                Uint32 s2 = qb[xb] - qb[xa] - qa[xb] + qa[xa];
+                double mean = (double)s / n;
+                double var = (double)s2 / n - mean * mean;
+                double sd = var > 0.0 ? sqrt(var) : 0.0;
+                double T = mean * (1.0 + c->k * (sd / 128.0 - 1.0));
+                black = (double)v <= T;
+            } else {
+                // Bradley : noir si v <= moyenne * (100 - t) %
+                black = (Uint64)v * n * 100 <= (Uint64)s * (Uint64)(100 - c->t);
+            }
+            row[x] = black ? 0 : 255;
+        }
+    }
+}
+
+static void apply_adaptive_thresholding_gray(GrayImage* img, ThresholdMethod method,
+                                             int window, double k, int t) {
+    if (!img) errx(1, "Gray image is NULL");
+
+    //fenetre impaire, auto : ~1/16 du plus petit cote
+    if (window <= 0) {
+        int m = img->w < img->h ? img->w : img->h;
+        window = m / 16;
+        if (window < 15) window = 15;
+    }
+    if (window > ADAPTIVE_MAX_WINDOW) window = ADAPTIVE_MAX_WINDOW;
+    window |= 1;
+
+    AdaptiveCtx ctx;
+    ctx.img = img;
+    ctx.istride = img->w + 1;
+    ctx.half = window / 2;
+    ctx.method = method;
+    ctx.k = k;
+    ctx.t = t;
+
+    size_t isize = (size_t)ctx.istride * (size_t)(img->h + 1);
+    ctx.sum = calloc(isize, sizeof(Uint32));
+    ctx.sq = (method == THRESHOLD_SAUVOLA) ? calloc(isize, sizeof(Uint32)) : NULL;
+    if (!ctx.sum || (method == THRESHOLD_SAUVOLA && !ctx.sq))
+        errx(1, "Integral image allocation failed in adaptive thresholding");
+
+    parallel_for(img->h, ADAPTIVE_MIN_BAND, integral_rows, &ctx);
+    parallel_for(img->w, ADAPTIVE_MIN_BAND, integral_cols, &ctx);
+    parallel_for(img->h, ADAPTIVE_MIN_BAND, adaptive_rows, &ctx);
+
+    free(ctx.sum);
+    free(ctx.sq);
+}
+
+void apply_sauvola_thresholding_gray(GrayImage* img, int window, double k) {
+    apply_adaptive_thresholding_gray(img, THRESHOLD_SAUVOLA, window, k, 0);
+}
+
+void apply_bradley_thresholding_gray(GrayImage* img, int window, int t) {
+    if (t < 0) t = 0;
+    if (t > 100) t = 100;
+    apply_adaptive_thresholding_gray(img, THRESHOLD_BRADLEY, window, 0.0, t);
+}
+
+void apply_thresholding_gray(GrayImage* img, const int histogram[GRAY_LEVELS]) {
+    switch (current_method) {
+    case THRESHOLD_SAUVOLA:
+        apply_sauvola_thresholding_gray(img, 0, SAUVOLA_DEFAULT_K);
+        break;
+    case THRESHOLD_BRADLEY:
+        apply_bradley_thresholding_gray(img, 0, BRADLEY_DEFAULT_T);
+        break;
+    default:
+        if (histogram) apply_otsu_thresholding_hist(img, histogram, NULL);
+        else apply_otsu_thresholding_gray(img);
+        break;
+    }
+}
+
+void apply_thresholding(SDL_Surface* surface) {
+    if (!surface) errx(1, "Surface is NULL");
+
+    if (current_method == THRESHOLD_OTSU || surface->format->BytesPerPixel != 4) {
+        apply_otsu_thresholding(surface);
+        return;
+    }
+
+    GrayImage* gray = gray_from_surface(surface);
+    if (!gray) errx(1, "Luminance allocation failed in thresholding");
+    apply_thresholding_gray(gray, NULL);
+    gray_to_surface(gray, surface);
+    gray_free(gray);
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Morphologie (van Herk / Gil-Werman)
+ *
+ * Noyau rectangulaire kw x kh separe en une passe horizontale puis une
+ * passe verticale. Chaque passe calcule un min ou un max glissant de
+ * largeur k en ~3 comparaisons par pixel quelle que soit k : le signal est
+ * coupe en blocs de k, g = cumul depuis le debut du bloc, h = cumul depuis
+ * la fin, et la fenetre [i, i + k - 1] vaut op(h[i], g[i + k - 1]).
+ *
+ * L'encre est noire (0) : eroder l'encre = max, dilater l'encre = min. Les
+ * pixels hors image sont neutres (0 pour max, 255 pour min).
+ * -------------------------------------------------------------------------- */
+
+//colonnes traitees ensemble par la passe verticale
+#define MORPH_STRIP 64
+
+static inline Uint8 morph_op(Uint8 a, Uint8 b, int is_max) {
+    if (is_max) return a > b ? a : b;
+    return a < b ? a : b;
+}
+
+//longueur du signal complete (k - 1 voisins) arrondie a un multiple de k
+static inline int morph_padded(int n, int k) {
+    int len = n + k - 1;
+    return (len + k - 1) / k * k;
+}
+
+/* Passe 1D sur une ligne : dst[x] = op(src[x - a .. x - a + k - 1]),
+ * a = k / 2. g et h : morph_padded(w, k) octets de travail. */
+static inline void morph_row(const Uint8* src, Uint8* dst, int w, int k,
+                             int is_max, Uint8* g, Uint8* h) {
+    int a = k / 2;
+    int len = morph_padded(w, k);
+    Uint8 neutral = is_max ? 0 : 255;
+
+    //g : on ecrit d'abord le signal complete dans g, puis on cumule
+    memset(g, neutral, (size_t)a);
+    memcpy(g + a, src, (size_t)w);
+    memset(g + a + w, neutral, (size_t)(len - a - w));
+
+    for (int b = 0; b < len; b += k) {
+        h[b + k - 1] = g[b + k - 1];
+        for (int i = b + k - 2; i >= b; i--) h[i] = morph_op(h[i + 1], g[i], is_max);
+        for (int i = b + 1; i < b + k; i++) g[i] = morph_op(g[i - 1], g[i], is_max);
+    }
+
+    for (int x = 0; x < w; x++) dst[x] = morph_op(h[x], g[x + k - 1], is_max);
+}
+
+typedef struct {
+    GrayImage* img;
+    int        k;
+    int        is_max;
+} MorphJob;
+
+static void morph_rows_band(void* arg, int y0, int y1, int band) {
+    MorphJob* job = arg;
+    int w = job->img->w;
+    int len = morph_padded(w, job->k);
+    (void)band;
+
+    Uint8* buf = malloc((size_t)len * 2 + (size_t)w);
+    if (!buf) errx(1, "Buffer allocation failed in morphology");
+    Uint8* g = buf;
+    Uint8* h = buf + len;
+    Uint8* line = buf + 2 * (size_t)len;
+
+    for (int y = y0; y < y1; y++) {
+        Uint8* row = gray_row(job->img, y);
+        memcpy(line, row, (size_t)w);
+        if (job->is_max) morph_row(line, row, w, job->k, 1, g, h);
+        else morph_row(line, row, w, job->k, 0, g, h);
+    }
+
+    free(buf);
+}
+
+/* Meme algorithme en vertical sur des bandes de MORPH_STRIP colonnes :
+ * chaque "element" est un segment de ligne, les boucles internes portent
+ * sur les colonnes (contigues). */
+static inline void morph_cols_strip(GrayImage* img, int x0, int sw, int k,
+                                    int is_max, Uint8* g, Uint8* h) {
+    int H = img->h;
+    int a = k / 2;
+    int len = morph_padded(H, k);
+    Uint8 neutral = is_max ? 0 : 255;
+
+    for (int i = 0; i < len; i++) {
+        int y = i - a;
+        Uint8* gi = g + (size_t)i * sw;
+        if (y >= 0 && y < H) memcpy(gi, gray_row(img, y) + x0, (size_t)sw);
+        else memset(gi, neutral, (size_t)sw);
+    }
+
+    for (int b = 0; b < len; b += k) {
+        memcpy(h + (size_t)(b + k - 1) * sw, g + (size_t)(b + k - 1) * sw, (size_t)sw);
+        for (int i = b + k - 2; i >= b; i--) {
+            Uint8* hi = h + (size_t)i * sw;
+            const Uint8* hn = hi + sw;
+            const Uint8* gi = g + (size_t)i * sw;
+            for (int j = 0; j < sw; j++) hi[j] = morph_op(hn[j], gi[j], is_max);
+        }
+        for (int i = b + 1; i < b + k; i++) {
+            Uint8* gi = g + (size_t)i * sw;
+            const Uint8* gp = gi - sw;
+            for (int j = 0; j < sw; j++) gi[j] = morph_op(gp[j], gi[j], is_max);
+        }
+    }
+
+    for (int y = 0; y < H; y++) {
+        Uint8* dst = gray_row(img, y) + x0;
+        const Uint8* hy = h + (size_t)y * sw;
+        const Uint8* gy = g + (size_t)(y + k - 1) * sw;
+        for (int j = 0; j < sw; j++) dst[j] = morph_op(hy[j], gy[j], is_max);
+    }
+}
+
+static void morph_cols_band(void* arg, int x0, int x1, int band) {
+    MorphJob* job = arg;
+    int len = morph_padded(job->img->h, job->k);
+    (void)band;
+
+    Uint8* buf = malloc((size_t)len * MORPH_STRIP * 2);
+    if (!buf) errx(1, "Buffer allocation failed in morphology");
+    Uint8* g = buf;
+    Uint8* h = buf + (size_t)len * MORPH_STRIP;
+
+    for (int x = x0; x < x1; x += MORPH_STRIP) {
+        int sw = x1 - x < MORPH_STRIP ? x1 - x : MORPH_STRIP;
+        if (job->is_max) morph_cols_strip(job->img, x, sw, job->k, 1, g, h);
+        else morph_cols_strip(job->img, x, sw, job->k, 0, g, h);
+    }
+
+    free(buf);
+}
+
+static void morph_gray(GrayImage* img, int kw, int kh, int is_max) {
+    if (!img) errx(1, "Gray image is NULL");
+
+    MorphJob job = {img, kw, is_max};
+    if (kw > 1) parallel_for(img->h, CLEANER_MIN_ROWS, morph_rows_band, &job);
+
+    job.k = kh;
+    if (kh > 1) parallel_for(img->w, MORPH_STRIP, morph_cols_band, &job);
+}
+
+void morph_erode_gray(GrayImage* img, int kw, int kh) {
+    morph_gray(img, kw, kh, 1);
+}
+
+void morph_dilate_gray(GrayImage* img, int kw, int kh) {
+    morph_gray(img, kw, kh, 0);
+}
+
+void morph_open_gray(GrayImage* img, int kw, int kh) {
+    morph_gray(img, kw, kh, 1);
+    morph_gray(img, kw, kh, 0);
+}
+
+void morph_close_gray(GrayImage* img, int kw, int kh) {
+    morph_gray(img, kw, kh, 0);
+    morph_gray(img, kw, kh, 1);
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Etape de debruitage de l'Auto Process
+ * -------------------------------------------------------------------------- */
+
+static DenoiseMethod denoise_method = DENOISE_NEIGHBOURS;
+static int morph_kw = 3, morph_kh = 3;
+
+void set_denoise_method(DenoiseMethod method) {
+    denoise_method = method;
+}
+
+DenoiseMethod get_denoise_method(void) {
+    return denoise_method;
+}
+
+const char* denoise_method_name(DenoiseMethod method) {
+    switch (method) {
+    case DENOISE_OPEN:       return "open";
+    case DENOISE_CLOSE:      return "close";
+    case DENOISE_OPEN_CLOSE: return "open+close";
+    default:                 return "3x3 neighbours";
+    }
+}
+
+void set_morph_kernel(int kw, int kh) {
+    morph_kw = kw < 1 ? 1 : kw;
+    morph_kh = kh < 1 ? 1 : kh;
+}
+
+void get_morph_kernel(int* kw, int* kh) {
+    *kw = morph_kw;
+    *kh = morph_kh;
+}
+
+void apply_denoise_gray(GrayImage* img, int threshold) {
+    switch (denoise_method) {
+    case DENOISE_OPEN:
+        morph_open_gray(img, morph_kw, morph_kh);
+        break;
+    case DENOISE_CLOSE:
+        morph_close_gray(img, morph_kw, morph_kh);
+        break;
+    case DENOISE_OPEN_CLOSE:
+        morph_open_gray(img, morph_kw, morph_kh);
+        morph_close_gray(img, morph_kw, morph_kh);
+        break;
+    default:
+        apply_noise_removal_gray(img, threshold);
+        break;
+    }
+}
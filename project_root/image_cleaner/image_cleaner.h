@@ -2,13 +2,105 @@
 #define IMAGE_CLEANER_H
 
 #include <SDL2/SDL.h>
+#include "../gray_image/gray_image.h"
 
+#define GRAY_LEVELS 256
+
+/* Binarization used by the "Otsu" button and Auto Process. */
+typedef enum {
+    THRESHOLD_OTSU = 0,    // global
+    THRESHOLD_SAUVOLA,     // local mean and deviation
+    THRESHOLD_BRADLEY      // local mean
+} ThresholdMethod;
+
+/* Denoise step of Auto Process. */
+typedef enum {
+    DENOISE_NEIGHBOURS = 0,   // apply_noise_removal rule
+    DENOISE_OPEN,             // removes specks smaller than the kernel
+    DENOISE_CLOSE,            // bridges gaps smaller than the kernel
+    DENOISE_OPEN_CLOSE
+} DenoiseMethod;
+
+#define SAUVOLA_DEFAULT_K 0.34
+#define BRADLEY_DEFAULT_T 15
 
 
 void convert_to_grayscale(SDL_Surface* surface);
 
+/* Otsu threshold of a histogram (black if value < threshold). */
+int compute_otsu_threshold(const int histogram[GRAY_LEVELS], int total_pixels);
+
+/* Same with 64-bit counts, for pages of more than 2^31 pixels. */
+int compute_otsu_threshold_wide(const long long histogram[GRAY_LEVELS],
+                                long long total_pixels);
+
 void apply_otsu_thresholding(SDL_Surface* surface);
 
 void apply_noise_removal(SDL_Surface* surface, int threshold);
 
+/* Same operations on a shared luminance plane (0 = black, 255 = white). */
+void apply_otsu_thresholding_gray(GrayImage* img);
+
+void apply_noise_removal_gray(GrayImage* img, int threshold);
+
+/* apply_noise_removal on a packed bitmap, in place, with only three rows of
+ * scratch. Gives the same pixels as the surface and gray versions. */
+void bit_noise_removal(BitImage* img, int threshold);
+
+/* Otsu binarization of img from a histogram already computed during the
+ * luminance pass (see gray_from_surface_hist): a single lookup-table pass.
+ * If mask is not NULL, *mask receives a packed copy (bit set = black), or
+ * NULL if it could not be allocated. Returns the threshold. */
+int apply_otsu_thresholding_hist(GrayImage* img, const int histogram[GRAY_LEVELS],
+                                 BitImage** mask);
+
+/* ---- Adaptive thresholding (integral images, row bands on all cores) ---- */
+
+void set_threshold_method(ThresholdMethod method);
+
+ThresholdMethod get_threshold_method(void);
+
+const char* threshold_method_name(ThresholdMethod method);
+
+/* Sauvola: black if v <= m * (1 + k * (s / 128 - 1)) over a window x window
+ * neighbourhood (window <= 0 picks one from the page size). */
+void apply_sauvola_thresholding_gray(GrayImage* img, int window, double k);
+
+/* Bradley: black if v <= m * (100 - t) / 100 over the neighbourhood. */
+void apply_bradley_thresholding_gray(GrayImage* img, int window, int t);
+
+/* Binarize with the selected method. histogram (may be NULL) is the one
+ * returned by gray_from_surface_hist, reused when the method is Otsu. */
+void apply_thresholding_gray(GrayImage* img, const int histogram[GRAY_LEVELS]);
+
+void apply_thresholding(SDL_Surface* surface);
+
+/* ---- Morphology (van Herk / Gil-Werman, cost independent of kernel size) ---- */
+
+/* Rectangular kw x kh kernel, ink is black: erode shrinks the ink (max
+ * filter), dilate grows it (min filter). Also valid on gray planes. */
+void morph_erode_gray(GrayImage* img, int kw, int kh);
+
+void morph_dilate_gray(GrayImage* img, int kw, int kh);
+
+/* erode then dilate */
+void morph_open_gray(GrayImage* img, int kw, int kh);
+
+/* dilate then erode */
+void morph_close_gray(GrayImage* img, int kw, int kh);
+
+void set_denoise_method(DenoiseMethod method);
+
+DenoiseMethod get_denoise_method(void);
+
+const char* denoise_method_name(DenoiseMethod method);
+
+/* Kernel used by the open / close denoise methods (3 x 3 by default). */
+void set_morph_kernel(int kw, int kh);
+
+void get_morph_kernel(int* kw, int* kh);
+
+/* Denoise with the selected method (threshold is for DENOISE_NEIGHBOURS). */
+void apply_denoise_gray(GrayImage* img, int threshold);
+
 #endif
@@ -1,20 +1,26 @@
 #include "letter_extractor.h"
 #include "../neural_network/digitalisation.h"
+#include "../projection/projection.h"
+#include "../thread_pool/thread_pool.h"
 #include <SDL2/SDL.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // ============================= OTSU THRESHOLD ============================= //
 
-// Compute Otsu threshold on a gray buffer [0..255].
-static int otsu_threshold_gray(const Uint8 *g, int n) {
+// Compute Otsu threshold on a w x h gray window [0..255] (rows `stride` apart).
+static int otsu_threshold_gray(const Uint8 *g, int w, int h, int stride) {
   int hist[256] = {0};
-  for (int i = 0; i < n; ++i)
-    hist[g[i]]++;
+  for (int y = 0; y < h; ++y) {
+    const Uint8 *row = g + (size_t)y * stride;
+    for (int x = 0; x < w; ++x)
+      hist[row[x]]++;
+  }
 
-  int total = n;
+  int total = w * h;
   double sum = 0.0;
   for (int t = 0; t < 256; ++t)
     sum += (double)t * hist[t];
@@ -47,103 +53,91 @@ static int otsu_threshold_gray(const Uint8 *g, int n) {
 // ============================= ZHANG-SUEN THINNING
 // ============================= //
 
+// The 3x3 neighbourhood of a pixel is packed into 9 bits, three per row
+// (bit 0 = left column): idx = top | mid << 3 | bottom << 6. In the usual
+// naming, p9 p2 p3 are bits 0-2, p8 (p1) p4 bits 3-5, p7 p6 p5 bits 6-8.
+#define ZS_P(i, b) (((i) >> (b)) & 1)
+#define ZS_B(i)                                                                \
+  (ZS_P(i, 1) + ZS_P(i, 2) + ZS_P(i, 5) + ZS_P(i, 8) + ZS_P(i, 7) +            \
+   ZS_P(i, 6) + ZS_P(i, 3) + ZS_P(i, 0))
+#define ZS_UP(i, a, b) (!ZS_P(i, a) && ZS_P(i, b)) // 0 -> 1 transition
+#define ZS_A(i)                                                                \
+  (ZS_UP(i, 1, 2) + ZS_UP(i, 2, 5) + ZS_UP(i, 5, 8) + ZS_UP(i, 8, 7) +         \
+   ZS_UP(i, 7, 6) + ZS_UP(i, 6, 3) + ZS_UP(i, 3, 0) + ZS_UP(i, 0, 1))
+#define ZS_AB(i) (ZS_B(i) >= 2 && ZS_B(i) <= 6 && ZS_A(i) == 1)
+#define ZS_L1(i) ZS_AB(i), ZS_AB((i) + 1)
+#define ZS_L2(i) ZS_L1(i), ZS_L1((i) + 2)
+#define ZS_L3(i) ZS_L2(i), ZS_L2((i) + 4)
+#define ZS_L4(i) ZS_L3(i), ZS_L3((i) + 8)
+#define ZS_L5(i) ZS_L4(i), ZS_L4((i) + 16)
+#define ZS_L6(i) ZS_L5(i), ZS_L5((i) + 32)
+#define ZS_L7(i) ZS_L6(i), ZS_L6((i) + 64)
+#define ZS_L8(i) ZS_L7(i), ZS_L7((i) + 128)
+
+// 2 <= B(p) <= 6 and A(p) == 1 for each neighbourhood, built at compile time
+static const unsigned char zs_ab[512] = {ZS_L8(0), ZS_L8(256)};
+
+// Pixels (bits 1..26) of row y a Zhang–Suen sub-iteration removes. The
+// step conditions are evaluated for the whole row with bitwise ops, the
+// A(p)/B(p) ones through zs_ab for the pixels left.
+static uint32_t zs_deletable(const uint32_t *row, int y, int step) {
+  const uint32_t INNER = 0x07FFFFFEu; // x = 1..26
+  uint32_t p2 = row[y - 1], p6 = row[y + 1];
+  uint32_t p4 = row[y] >> 1, p8 = row[y] << 1; // bit x = pixel x + 1, x - 1
+
+  uint32_t cand = row[y] & INNER;
+  if (step == 0)
+    cand &= ~(p2 & p4 & p6) & ~(p4 & p6 & p8);
+  else
+    cand &= ~(p2 & p4 & p8) & ~(p2 & p6 & p8);
+
+  uint32_t del = 0;
+  while (cand) {
+    int x = __builtin_ctz(cand);
+    cand &= cand - 1;
+    unsigned idx = ((row[y - 1] >> (x - 1)) & 7u) |
+                   (((row[y] >> (x - 1)) & 7u) << 3) |
+                   (((row[y + 1] >> (x - 1)) & 7u) << 6);
+    if (zs_ab[idx])
+      del |= 1u << x;
+  }
+  return del;
+}
+
 // Apply Zhang–Suen thinning on a 28x28 binary mask.
 // mask[i] = 0 (background) or 1 (black pixel).
+// Works on 28 rows of 28 bits (bit x = pixel x), nothing is allocated.
 static void thin_zhang_suen_28(unsigned char *mask) {
   const int W = 28, H = 28;
-  int changed;
+  uint32_t row[28], del[28];
 
+  for (int y = 0; y < H; ++y) {
+    uint32_t r = 0;
+    for (int x = 0; x < W; ++x)
+      if (mask[y * W + x])
+        r |= 1u << x;
+    row[y] = r;
+  }
+
+  int changed;
   do {
     changed = 0;
 
-    // ---- Step 1 ----
-    unsigned char *to_remove = (unsigned char *)calloc(W * H, 1);
-    if (!to_remove)
-      return;
-
-    for (int y = 1; y < H - 1; ++y) {
-      for (int x = 1; x < W - 1; ++x) {
-        int idx = y * W + x;
-        if (!mask[idx])
-          continue;
-
-        int p2 = mask[(y - 1) * W + x];
-        int p3 = mask[(y - 1) * W + (x + 1)];
-        int p4 = mask[y * W + (x + 1)];
-        int p5 = mask[(y + 1) * W + (x + 1)];
-        int p6 = mask[(y + 1) * W + x];
-        int p7 = mask[(y + 1) * W + (x - 1)];
-        int p8 = mask[y * W + (x - 1)];
-        int p9 = mask[(y - 1) * W + (x - 1)];
-
-        int N = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
-
-        // Count transitions 0->1 around the 8 neighbors.
-        int S = 0;
-        int seq[9] = {p2, p3, p4, p5, p6, p7, p8, p9, p2};
-        for (int k = 0; k < 8; ++k)
-          if (seq[k] == 0 && seq[k + 1] == 1)
-            S++;
-
-        if (N >= 2 && N <= 6 && S == 1 && (p2 * p4 * p6 == 0) &&
-            (p4 * p6 * p8 == 0)) {
-          to_remove[idx] = 1;
-        }
+    // Step 1 then step 2, each one decided on the mask it starts from
+    for (int step = 0; step < 2; ++step) {
+      for (int y = 1; y < H - 1; ++y)
+        del[y] = zs_deletable(row, y, step);
+      for (int y = 1; y < H - 1; ++y) {
+        if (del[y])
+          changed = 1;
+        row[y] &= ~del[y];
       }
     }
-
-    for (int i = 0; i < W * H; ++i)
-      if (to_remove[i] && mask[i]) {
-        mask[i] = 0;
-        changed = 1;
-      }
-
-    free(to_remove);
-
-    // ---- Step 2 ----
-    to_remove = (unsigned char *)calloc(W * H, 1);
-    if (!to_remove)
-      return;
-
-    for (int y = 1; y < H - 1; ++y) {
-      for (int x = 1; x < W - 1; ++x) {
-        int idx = y * W + x;
-        if (!mask[idx])
-          continue;
-
-        int p2 = mask[(y - 1) * W + x];
-        int p3 = mask[(y - 1) * W + (x + 1)];
-        int p4 = mask[y * W + (x + 1)];
-        int p5 = mask[(y + 1) * W + (x + 1)];
-        int p6 = mask[(y + 1) * W + x];
-        int p7 = mask[(y + 1) * W + (x - 1)];
-        int p8 = mask[y * W + (x - 1)];
-        int p9 = mask[(y - 1) * W + (x - 1)];
-
-        int N = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
-
-        int S = 0;
-        int seq[9] = {p2, p3, p4, p5, p6, p7, p8, p9, p2};
-        for (int k = 0; k < 8; ++k)
-          if (seq[k] == 0 && seq[k + 1] == 1)
-            S++;
-
-        if (N >= 2 && N <= 6 && S == 1 && (p2 * p4 * p8 == 0) &&
-            (p2 * p6 * p8 == 0)) {
-          to_remove[idx] = 1;
-        }
-      }
-    }
-
-    for (int i = 0; i < W * H; ++i)
-      if (to_remove[i] && mask[i]) {
-        mask[i] = 0;
-        changed = 1;
-      }
-
-    free(to_remove);
-
   } while (changed);
+
+  for (int y = 0; y < H; ++y)
+    for (int x = 0; x < W; ++x)
+      mask[y * W + x] = (unsigned char)((row[y] >> x) & 1u);
 }
 
 // ===================== LETTER THINNING + SIZE NORMALIZATION
@@ -461,9 +455,11 @@ static void maybe_thin_letter(Uint8 *buf784) {
     buf784[i] = zoom_mask[i] ? 0 : 255;
 
   // ---- DEBUG: save a few tiles after thinning (max 5) ----
+  // (slots are claimed atomically: puzzles are extracted on several threads)
   {
     static int debug_count = 0;
-    if (debug_count < 5) {
+    int slot = __atomic_fetch_add(&debug_count, 1, __ATOMIC_RELAXED);
+    if (slot < 5) {
       SDL_Surface *dbg =
           SDL_CreateRGBSurfaceWithFormat(0, W, H, 32, SDL_PIXELFORMAT_ARGB8888);
       if (dbg) {
@@ -482,134 +478,316 @@ static void maybe_thin_letter(Uint8 *buf784) {
 
           SDL_UnlockSurface(dbg);
           char filename[64];
-          snprintf(filename, sizeof(filename), "debug_thin_%d.bmp",
-                   debug_count);
+          snprintf(filename, sizeof(filename), "debug_thin_%d.bmp", slot);
           SDL_SaveBMP(dbg, filename);
         }
         SDL_FreeSurface(dbg);
       }
-      debug_count++;
     }
   }
 }
 
+// ========================= GRID PERIOD (AUTOCORRELATION) ==================
+// //
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+  double re, im;
+} Cplx;
+
+// In-place radix-2 FFT of a[0..n), n a power of two (inverse: conjugate
+// twiddles, no 1/n scaling).
+static void fft_radix2(Cplx *a, int n, int inverse) {
+  for (int i = 1, j = 0; i < n; ++i) { // bit-reversal permutation
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      Cplx t = a[i];
+      a[i] = a[j];
+      a[j] = t;
+    }
+  }
+
+  for (int len = 2; len <= n; len <<= 1) {
+    double ang = (inverse ? 2.0 : -2.0) * M_PI / (double)len;
+    for (int k = 0; k < len / 2; ++k) {
+      Cplx w = {cos(ang * k), sin(ang * k)};
+      for (int i = k; i < n; i += len) {
+        Cplx u = a[i], v = a[i + len / 2];
+        Cplx t = {v.re * w.re - v.im * w.im, v.re * w.im + v.im * w.re};
+        a[i] = (Cplx){u.re + t.re, u.im + t.im};
+        a[i + len / 2] = (Cplx){u.re - t.re, u.im - t.im};
+      }
+    }
+  }
+}
+
+// Exact autocorrelation of s[0..n) at lag L.
+static long long autocorr_at(const int *s, int n, int L) {
+  long long acc = 0;
+  for (int i = 0; i < n - L; ++i)
+    acc += (long long)s[i] * (long long)s[i + L];
+  return acc;
+}
+
+// Lag in [minLag, maxLag] with the largest autocorrelation (the first one
+// on ties). All lags are evaluated at once with an FFT, O(n log n), then
+// the few lags within rounding error of the best are rescored exactly, so
+// the choice is the one of a direct O(n^2) scan.
+static int best_period(const int *s, int n, int minLag, int maxLag) {
+  int P = 1; // zero padding: no circular wrap up to maxLag
+  while (P < n + maxLag + 1)
+    P <<= 1;
+
+  Cplx *a = (Cplx *)calloc((size_t)P, sizeof(Cplx));
+  if (!a) { // no room for the FFT: direct scan
+    int per = -1;
+    long long best = -1;
+    for (int L = minLag; L <= maxLag; ++L) {
+      long long acc = autocorr_at(s, n, L);
+      if (acc > best) {
+        best = acc;
+        per = L;
+      }
+    }
+    return per;
+  }
+
+  double energy = 0.0; // lag 0, bounds every lag
+  for (int i = 0; i < n; ++i) {
+    a[i].re = (double)s[i];
+    energy += (double)s[i] * (double)s[i];
+  }
+
+  // Autocorrelation = inverse FFT of the power spectrum
+  fft_radix2(a, P, 0);
+  for (int k = 0; k < P; ++k) {
+    a[k].re = a[k].re * a[k].re + a[k].im * a[k].im;
+    a[k].im = 0.0;
+  }
+  fft_radix2(a, P, 1);
+
+  double top = -1.0;
+  for (int L = minLag; L <= maxLag; ++L)
+    if (a[L].re / P > top)
+      top = a[L].re / P;
+
+  // Far above the FFT rounding error (~1e-15 * energy * log2(P))
+  double tol = 1e-9 * energy + 1.0;
+  int per = -1;
+  long long best = -1;
+  for (int L = minLag; L <= maxLag; ++L) {
+    if (a[L].re / P < top - tol)
+      continue;
+    long long acc = autocorr_at(s, n, L);
+    if (acc > best) {
+      best = acc;
+      per = L;
+    }
+  }
+
+  free(a);
+  return per;
+}
+
 // ========================== LETTER GRID EXTRACTION ==========================
 // //
 
 #define CLAMP(v, a, b) ((v) < (a) ? (a) : ((v) > (b) ? (b) : (v)))
 
+// Smallest number of grid cells handled by one band of the cell loop
+#define LETTER_MIN_CELLS 16
+
 // Extract letters in a grid ROI [x1..x2] x [y1..y2] (inclusive).
-// out_matrix is an N x M matrix of Uint8[784] (or NULL if the cell is empty).
+// out is an N x M grid batch of 28x28 tiles (unused if the cell is empty).
 int extract_letters(SDL_Surface *src, int x1, int y1, int x2, int y2,
-                    Uint8 ****out_matrix, int *out_N, int *out_M) {
-  if (!src || !out_matrix || !out_N || !out_M)
+                    TileBatch *out) {
+  if (!src || !out)
     return -1;
+  memset(out, 0, sizeof(*out)); // empty on error
   if (x2 < x1 || y2 < y1)
     return -2;
 
-  // Convert to ARGB8888 for easier pixel access
-  SDL_Surface *s32 = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
-  if (!s32)
+  // Reduce the surface to its luminance plane once
+  GrayImage *img = gray_from_surface(src);
+  if (!img)
     return -3;
-  SDL_SetSurfaceBlendMode(s32, SDL_BLENDMODE_NONE);
-
-  // Clamp ROI inside the surface
-  if (x1 < 0)
-    x1 = 0;
-  if (y1 < 0)
-    y1 = 0;
-  if (x2 >= s32->w)
-    x2 = s32->w - 1;
-  if (y2 >= s32->h)
-    y2 = s32->h - 1;
-
-  int rw = x2 - x1 + 1;
-  int rh = y2 - y1 + 1;
-
-  // Create an ROI surface
-  SDL_Surface *roi =
-      SDL_CreateRGBSurfaceWithFormat(0, rw, rh, 32, SDL_PIXELFORMAT_ARGB8888);
-  if (!roi) {
-    SDL_FreeSurface(s32);
-    return -4;
-  }
-  SDL_SetSurfaceBlendMode(roi, SDL_BLENDMODE_NONE);
-
-  SDL_Rect rs = {x1, y1, rw, rh};
-  SDL_Rect rd = {0, 0, rw, rh};
-  if (SDL_BlitSurface(s32, &rs, roi, &rd) != 0) {
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
-    return -5;
-  }
-
-  if (SDL_LockSurface(roi) != 0) {
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
-    return -6;
-  }
-
-  const Uint32 *PR = (const Uint32 *)roi->pixels;
-  const SDL_PixelFormat *fmt = roi->format;
-  int rpitch = roi->pitch / 4;
-
-  // Build a grayscale buffer G[y * rw + x]
-  if (rw <= 0 || rh <= 0) {
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
-    return -7;
-  }
 
-  Uint8 *G = malloc((size_t)rw * (size_t)rh);
+  int rc = extract_letters_gray(img, x1, y1, x2, y2, out);
+  gray_free(img);
+  return rc;
+}
 
-  if (!G) {
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
-    return -7;
+// Read-only state of the cell loop; each cell only writes its own slot.
+typedef struct {
+  const Uint8 *G; // ROI plane, rows gs bytes apart
+  int gs, rw, rh;
+  const GrayView *view; // tiles sampled through it if set, ROI at (rx, ry)
+  int rx, ry;
+  int BLACK_THR;
+  const InkProfile *ink;
+  double stepX, stepY; // grid pitch
+  TileBatch *Mat;      // N x M batch being filled
+} CellJob;
+
+// Segment grid cell k = i * M + j into tile k of the batch (left blank and
+// unused if the cell is empty).
+static void extract_cell(const CellJob *job, int k) {
+  const Uint8 *G = job->G;
+  int gs = job->gs, rw = job->rw, rh = job->rh;
+  int BLACK_THR = job->BLACK_THR;
+  const InkProfile *ink = job->ink;
+  double stepX = job->stepX, stepY = job->stepY;
+  TileBatch *Mat = job->Mat;
+  int i = k / Mat->cols, j = k % Mat->cols;
+
+  int y_top = (int)floor(i * stepY);
+  int y_bot = (int)floor((i + 1) * stepY) - 1;
+  if (y_bot >= rh)
+    y_bot = rh - 1;
+
+  int x_left = (int)floor(j * stepX);
+  int x_right = (int)floor((j + 1) * stepX) - 1;
+  if (x_right >= rw)
+    x_right = rw - 1;
+
+  int cw = x_right - x_left + 1;
+  int ch = y_bot - y_top + 1;
+  if (cw < 2 || ch < 2)
+    return;
+
+  int xx1 = x_left, xx2 = x_right;
+  int yy1 = y_top, yy2 = y_bot;
+
+  // Check if there is any black pixel in the cell
+  if (ink_rect(ink, xx1, yy1, xx2, yy2) == 0)
+    return;
+
+  // Ignore a small border to avoid catching the grid lines
+  int EDGE_IGNORE = CLAMP(cw / 25, 3, 6); // 3..6 px typically
+  int bx1 = CLAMP(xx1 + EDGE_IGNORE, xx1, xx2);
+  int bx2 = CLAMP(xx2 - EDGE_IGNORE, xx1, xx2);
+  int by1 = CLAMP(yy1 + EDGE_IGNORE, yy1, yy2);
+  int by2 = CLAMP(yy2 - EDGE_IGNORE, yy1, yy2);
+
+  // Compute bounding box of black pixels inside the "de-bordered" region
+  int bminx = 1000000000, bmaxx = -1;
+  int bminy = 1000000000, bmaxy = -1;
+
+  for (int y = by1; y <= by2; ++y) {
+    const Uint8 *rowG = G + y * gs;
+    for (int x = bx1; x <= bx2; ++x) {
+      if (rowG[x] < BLACK_THR) {
+        if (x < bminx)
+          bminx = x;
+        if (x > bmaxx)
+          bmaxx = x;
+        if (y < bminy)
+          bminy = y;
+        if (y > bmaxy)
+          bmaxy = y;
+      }
+    }
   }
 
-  for (int y = 0; y < rh; ++y) {
-    const Uint32 *row = PR + y * rpitch;
-    for (int x = 0; x < rw; ++x) {
-      Uint8 r, g, b, a;
-      SDL_GetRGBA(row[x], fmt, &r, &g, &b, &a);
-      G[y * rw + x] = (Uint8)(((int)r + (int)g + (int)b) / 3);
+  if (bmaxx < bminx || bmaxy < bminy)
+    return;
+
+  int bw = bmaxx - bminx + 1;
+  int bh = bmaxy - bminy + 1;
+
+  // Center of mass using weights (255 - gray) in the bounding box
+  double sxw = 0.0, syw = 0.0, sw = 0.0;
+  for (int y = bminy; y <= bmaxy; ++y) {
+    const Uint8 *rowG = G + y * gs;
+    for (int x = bminx; x <= bmaxx; ++x) {
+      Uint8 v = rowG[x];
+      int w = (v < BLACK_THR) ? (255 - v) : 0;
+      if (w) {
+        sxw += (double)x * w;
+        syw += (double)y * w;
+        sw += (double)w;
+      }
     }
   }
 
+  double xbar = sw ? (sxw / sw) : 0.5 * (bminx + bmaxx);
+  double ybar = sw ? (syw / sw) : 0.5 * (bminy + bmaxy);
+
+  // Square window centred on the letter by COM, area-averaged to 28x28
+  // straight from the gray plane (no intermediate canvas)
+  int MARGIN = 4;
+  int s = (bw > bh ? bw : bh) + 2 * MARGIN;
+  if (s < 8)
+    s = 8;
+
+  // Compute offsets so that the letter is centered
+  double cx_bbox = 0.5 * (bminx + bmaxx);
+  double cy_bbox = 0.5 * (bminy + bmaxy);
+
+  int offx = (s - bw) / 2 + (int)lround(cx_bbox - xbar);
+  int offy = (s - bh) / 2 + (int)lround(cy_bbox - ybar);
+
+  offx = CLAMP(offx, 0, s - bw);
+  offy = CLAMP(offy, 0, s - bh);
+
+  // Part of the letter inside the 2 px white border of the window
+  int vx0 = offx > 2 ? offx : 2, vx1 = CLAMP(offx + bw, vx0, s - 2);
+  int vy0 = offy > 2 ? offy : 2, vy1 = CLAMP(offy + bh, vy0, s - 2);
+  int px = bminx + vx0 - offx, py = bminy + vy0 - offy;
+
+  // Slot of this cell in the batch, written in place for the NN
+  Uint8 *buf784 = tile_pixels(Mat, k);
+
+  // Resample the window to 28x28 (in digitalisation.c); on a rotated page
+  // the tile is read from the unrotated source, not from the rendered ROI
+  int rc = job->view
+               ? gray_view_to_28(job->view, job->rx + px, job->ry + py,
+                                 vx1 - vx0, vy1 - vy0, vx0, vy0, s, buf784)
+               : gray_to_28(G + py * gs + px, gs, vx1 - vx0, vy1 - vy0, vx0,
+                            vy0, s, buf784);
+  if (rc != 0) {
+    memset(buf784, 255, TILE_PIXELS); // back to a blank tile
+    return;
+  }
+
+  // Final step: optionally thin / zoom / recenter fat letters
+  maybe_thin_letter(buf784);
+
+  tile_set_used_atomic(Mat, k); // neighbour cells share bitmap words
+  Mat->info[k].src = (SDL_Rect){bminx, bminy, bw, bh};
+  Mat->info[k].ink = ink_rect(ink, bminx, bminy, bmaxx, bmaxy);
+}
+
+// parallel_for body: cells [begin, end) in row-major order.
+static void extract_cells_band(void *ctx, int begin, int end, int band) {
+  (void)band;
+  for (int k = begin; k < end; ++k)
+    extract_cell((const CellJob *)ctx, k);
+}
+
+// Grid segmentation of a rw x rh grayscale ROI G (rows gs bytes apart).
+// If view is set, G is its rendition at (rx, ry) and the tiles are sampled
+// through the view instead of from G.
+static int extract_letters_roi(const Uint8 *G, int gs, int rw, int rh,
+                               const GrayView *view, int rx, int ry,
+                               TileBatch *out) {
   // Global Otsu threshold on ROI
-  int T = otsu_threshold_gray(G, rw * rh);
+  int T = otsu_threshold_gray(G, rw, rh, gs);
   int BLACK_THR = T + 20;
   if (BLACK_THR > 250)
     BLACK_THR = 250;
 
-  // Projection profiles along x and y
-  int *px = (int *)calloc((size_t)rw, sizeof(int));
-  int *py = (int *)calloc((size_t)rh, sizeof(int));
-  if (!px || !py) {
-    free(px);
-    free(py);
-    free(G);
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
+  // Ink counts of the ROI (column / row projections and rectangle sums),
+  // one row-major pass
+  InkProfile *ink = ink_profile_create(G, rw, rh, gs, BLACK_THR);
+  if (!ink)
     return -8;
-  }
-
-  for (int x = 0; x < rw; ++x) {
-    int s = 0;
-    for (int y = 0; y < rh; ++y)
-      s += (G[y * rw + x] < BLACK_THR);
-    px[x] = s;
-  }
-  for (int y = 0; y < rh; ++y) {
-    int s = 0;
-    for (int x = 0; x < rw; ++x)
-      s += (G[y * rw + x] < BLACK_THR);
-    py[y] = s;
-  }
 
   // Smoothing window sizes
   int wx = rw / 60;
@@ -624,50 +802,36 @@ int extract_letters(SDL_Surface *src, int x1, int y1, int x2, int y2,
     wy++;
   int hx = wx / 2, hy = wy / 2;
 
-  // Smoothed projections
+  // Smoothed projections: box means, each window summed in O(1)
   int *sx = (int *)calloc((size_t)rw, sizeof(int));
   int *sy = (int *)calloc((size_t)rh, sizeof(int));
   if (!sx || !sy) {
-    free(px);
-    free(py);
+    ink_profile_free(ink);
     free(sx);
     free(sy);
-    free(G);
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
     return -9;
   }
 
   for (int i = 0; i < rw; ++i) {
-    long long s = 0;
     int a = i - hx;
     if (a < 0)
       a = 0;
     int b = i + hx;
     if (b >= rw)
       b = rw - 1;
-    for (int t = a; t <= b; ++t)
-      s += px[t];
-    sx[i] = (int)(s / (b - a + 1));
+    sx[i] = ink_rect(ink, a, 0, b, rh - 1) / (b - a + 1);
   }
 
   for (int i = 0; i < rh; ++i) {
-    long long s = 0;
     int a = i - hy;
     if (a < 0)
       a = 0;
     int b = i + hy;
     if (b >= rh)
       b = rh - 1;
-    for (int t = a; t <= b; ++t)
-      s += py[t];
-    sy[i] = (int)(s / (b - a + 1));
+    sy[i] = ink_rect(ink, 0, a, rw - 1, b) / (b - a + 1);
   }
 
-  free(px);
-  free(py);
-
   // Auto-detect horizontal and vertical periods (grid step) by autocorrelation
   int minLagX = rw / 40;
   if (minLagX < 6)
@@ -683,39 +847,14 @@ int extract_letters(SDL_Surface *src, int x1, int y1, int x2, int y2,
   if (maxLagY <= minLagY)
     maxLagY = minLagY + 1;
 
-  int perX = -1, perY = -1;
-  long long bx = -1, by = -1;
-
-  for (int L = minLagX; L <= maxLagX; ++L) {
-    long long acc = 0;
-    int lim = rw - L;
-    for (int i = 0; i < lim; ++i)
-      acc += (long long)sx[i] * (long long)sx[i + L];
-    if (acc > bx) {
-      bx = acc;
-      perX = L;
-    }
-  }
-
-  for (int L = minLagY; L <= maxLagY; ++L) {
-    long long acc = 0;
-    int lim = rh - L;
-    for (int i = 0; i < lim; ++i)
-      acc += (long long)sy[i] * (long long)sy[i + L];
-    if (acc > by) {
-      by = acc;
-      perY = L;
-    }
-  }
+  int perX = best_period(sx, rw, minLagX, maxLagX);
+  int perY = best_period(sy, rh, minLagY, maxLagY);
 
   free(sx);
   free(sy);
 
   if (perX <= 0 || perY <= 0) {
-    free(G);
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
+    ink_profile_free(ink);
     return -10;
   }
 
@@ -730,218 +869,74 @@ int extract_letters(SDL_Surface *src, int x1, int y1, int x2, int y2,
   double stepX = (double)rw / (double)M;
   double stepY = (double)rh / (double)N;
 
-  // Allocate N x M matrix of Uint8* (each is either NULL or a 28x28 tile)
-  Uint8 ***Mat = (Uint8 ***)malloc((size_t)N * sizeof(Uint8 **));
-  if (!Mat) {
-    free(G);
-    SDL_UnlockSurface(roi);
-    SDL_FreeSurface(roi);
-    SDL_FreeSurface(s32);
+  // One contiguous N x M batch of 28x28 tiles, all blank and unused
+  TileBatch Mat;
+  if (tile_batch_init(&Mat, N, M) != 0) {
+    ink_profile_free(ink);
     return -11;
   }
 
-  for (int i = 0; i < N; ++i) {
-    Mat[i] = (Uint8 **)calloc((size_t)M, sizeof(Uint8 *));
-    if (!Mat[i]) {
-      for (int t = 0; t < i; ++t)
-        free(Mat[t]);
-      free(Mat);
-      free(G);
-      SDL_UnlockSurface(roi);
-      SDL_FreeSurface(roi);
-      SDL_FreeSurface(s32);
-      return -12;
-    }
-  }
-
   // -------------- Iterate over each grid cell -------------- //
-  for (int i = 0; i < N; ++i) {
-    int y_top = (int)floor(i * stepY);
-    int y_bot = (int)floor((i + 1) * stepY) - 1;
-    if (y_bot >= rh)
-      y_bot = rh - 1;
-
-    for (int j = 0; j < M; ++j) {
-      int x_left = (int)floor(j * stepX);
-      int x_right = (int)floor((j + 1) * stepX) - 1;
-      if (x_right >= rw)
-        x_right = rw - 1;
-
-      int cw = x_right - x_left + 1;
-      int ch = y_bot - y_top + 1;
-      if (cw < 2 || ch < 2) {
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      int xx1 = x_left, xx2 = x_right;
-      int yy1 = y_top, yy2 = y_bot;
-
-      // Check if there is any black pixel in the cell
-      int black = 0;
-      for (int y = yy1; y <= yy2 && !black; ++y) {
-        const Uint8 *rowG = G + y * rw;
-        for (int x = xx1; x <= xx2; ++x)
-          if (rowG[x] < BLACK_THR) {
-            black = 1;
-            break;
-          }
-      }
-      if (!black) {
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      // Ignore a small border to avoid catching the grid lines
-      int EDGE_IGNORE = CLAMP(cw / 25, 3, 6); // 3..6 px typically
-      int bx1 = CLAMP(xx1 + EDGE_IGNORE, xx1, xx2);
-      int bx2 = CLAMP(xx2 - EDGE_IGNORE, xx1, xx2);
-      int by1 = CLAMP(yy1 + EDGE_IGNORE, yy1, yy2);
-      int by2 = CLAMP(yy2 - EDGE_IGNORE, yy1, yy2);
-
-      // Compute bounding box of black pixels inside the "de-bordered" region
-      int bminx = 1000000000, bmaxx = -1;
-      int bminy = 1000000000, bmaxy = -1;
-
-      for (int y = by1; y <= by2; ++y) {
-        const Uint8 *rowG = G + y * rw;
-        for (int x = bx1; x <= bx2; ++x) {
-          if (rowG[x] < BLACK_THR) {
-            if (x < bminx)
-              bminx = x;
-            if (x > bmaxx)
-              bmaxx = x;
-            if (y < bminy)
-              bminy = y;
-            if (y > bmaxy)
-              bmaxy = y;
-          }
-        }
-      }
-
-      if (bmaxx < bminx || bmaxy < bminy) {
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      int bw = bmaxx - bminx + 1;
-      int bh = bmaxy - bminy + 1;
-
-      // Center of mass using weights (255 - gray) in the bounding box
-      double sxw = 0.0, syw = 0.0, sw = 0.0;
-      for (int y = bminy; y <= bmaxy; ++y) {
-        const Uint8 *rowG = G + y * rw;
-        for (int x = bminx; x <= bmaxx; ++x) {
-          Uint8 v = rowG[x];
-          int w = (v < BLACK_THR) ? (255 - v) : 0;
-          if (w) {
-            sxw += (double)x * w;
-            syw += (double)y * w;
-            sw += (double)w;
-          }
-        }
-      }
-
-      double xbar = sw ? (sxw / sw) : 0.5 * (bminx + bmaxx);
-      double ybar = sw ? (syw / sw) : 0.5 * (bminy + bmaxy);
-
-      // Create a square canvas, center letter by COM, and convert to 28x28
-      int MARGIN = 4;
-      int s = (bw > bh ? bw : bh) + 2 * MARGIN;
-      if (s < 8)
-        s = 8;
-
-      SDL_Surface *sq =
-          SDL_CreateRGBSurfaceWithFormat(0, s, s, 32, SDL_PIXELFORMAT_ARGB8888);
-      if (!sq) {
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      if (SDL_LockSurface(sq) != 0) {
-        SDL_FreeSurface(sq);
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      Uint32 *PS = (Uint32 *)sq->pixels;
-      int spitch = sq->pitch / 4;
-      Uint32 WHITE = 0xFFFFFFFFu;
-
-      // Fill the square canvas with white
-      for (int yy = 0; yy < s; ++yy)
-        for (int xx = 0; xx < s; ++xx)
-          PS[yy * spitch + xx] = WHITE;
-
-      // Compute offsets so that the letter is centered
-      double cx_bbox = 0.5 * (bminx + bmaxx);
-      double cy_bbox = 0.5 * (bminy + bmaxy);
-
-      int offx = (s - bw) / 2 + (int)lround(cx_bbox - xbar);
-      int offy = (s - bh) / 2 + (int)lround(cy_bbox - ybar);
-
-      offx = CLAMP(offx, 0, s - bw);
-      offy = CLAMP(offy, 0, s - bh);
-
-      // Copy the bounding box into the square canvas
-      for (int y = 0; y < bh; ++y) {
-        const Uint8 *rowG = G + (bminy + y) * rw + bminx;
-        Uint32 *rowS = PS + (offy + y) * spitch + offx;
-        for (int x = 0; x < bw; ++x) {
-          Uint8 v = rowG[x];
-          rowS[x] =
-              (255u << 24) | ((Uint32)v << 16) | ((Uint32)v << 8) | (Uint32)v;
-        }
-      }
-
-      // Optional thin white border around the canvas
-      for (int x = 0; x < s; ++x) {
-        PS[0 * spitch + x] = WHITE;
-        PS[1 * spitch + x] = WHITE;
-        PS[(s - 1) * spitch + x] = WHITE;
-        PS[(s - 2) * spitch + x] = WHITE;
-      }
-      for (int y = 0; y < s; ++y) {
-        PS[y * spitch + 0] = WHITE;
-        PS[y * spitch + 1] = WHITE;
-        PS[y * spitch + (s - 1)] = WHITE;
-        PS[y * spitch + (s - 2)] = WHITE;
-      }
-
-      SDL_UnlockSurface(sq);
-
-      // Allocate a 28x28 buffer for the NN
-      Uint8 *buf784 = (Uint8 *)malloc(784);
-      if (!buf784) {
-        SDL_FreeSurface(sq);
-        Mat[i][j] = NULL;
-        continue;
-      }
-
-      // Resize the square surface to 28x28 (in digitalisation.c)
-      if (surface_to_28(sq, buf784) != 0) {
-        SDL_FreeSurface(sq);
-        free(buf784);
-        Mat[i][j] = NULL;
-        continue;
-      }
+  // Cells are independent and write preallocated slots: split them over the
+  // thread pool, the batch is the same whatever the thread count.
+  CellJob job = {G,         gs,  rw,    rh,    view, rx, ry,
+                 BLACK_THR, ink, stepX, stepY, &Mat};
+  parallel_for(N * M, LETTER_MIN_CELLS, extract_cells_band, &job);
+
+  ink_profile_free(ink);
+  *out = Mat;
+  return 0;
+}
 
-      SDL_FreeSurface(sq);
+// Clamp [x1..x2] x [y1..y2] inside a w x h page. Returns 0, or -7 if empty.
+static int clamp_roi(int w, int h, int *x1, int *y1, int *x2, int *y2) {
+  if (*x1 < 0)
+    *x1 = 0;
+  if (*y1 < 0)
+    *y1 = 0;
+  if (*x2 >= w)
+    *x2 = w - 1;
+  if (*y2 >= h)
+    *y2 = h - 1;
+  return (*x2 < *x1 || *y2 < *y1) ? -7 : 0;
+}
 
-      // Final step: optionally thin / zoom / recenter fat letters
-      maybe_thin_letter(buf784);
+// Same as extract_letters(), reading the ROI straight from the gray plane.
+int extract_letters_gray(const GrayImage *img, int x1, int y1, int x2, int y2,
+                         TileBatch *out) {
+  if (!img || !out)
+    return -1;
+  memset(out, 0, sizeof(*out)); // empty on error
+  if (x2 < x1 || y2 < y1)
+    return -2;
+  if (clamp_roi(img->w, img->h, &x1, &y1, &x2, &y2) != 0)
+    return -7;
 
-      Mat[i][j] = buf784;
-    }
-  }
+  // Grayscale ROI view: G[y * gs + x], no copy
+  return extract_letters_roi(gray_row(img, y1) + x1, img->stride, x2 - x1 + 1,
+                             y2 - y1 + 1, NULL, 0, 0, out);
+}
 
-  SDL_UnlockSurface(roi);
-  free(G);
-  SDL_FreeSurface(roi);
-  SDL_FreeSurface(s32);
+// Same as extract_letters_gray() on a virtually rotated page: the ROI is
+// rendered from the unrotated source to locate the cells and letters, and
+// each tile is then sampled once from the source through the view.
+int extract_letters_view(const GrayView *view, int x1, int y1, int x2, int y2,
+                         TileBatch *out) {
+  if (!view || !view->src || !out)
+    return -1;
+  memset(out, 0, sizeof(*out)); // empty on error
+  if (rotate_view_is_identity(view))
+    return extract_letters_gray(view->src, x1, y1, x2, y2, out);
+  if (x2 < x1 || y2 < y1)
+    return -2;
+  if (clamp_roi(view->w, view->h, &x1, &y1, &x2, &y2) != 0)
+    return -7;
 
-  *out_matrix = Mat;
-  *out_N = N;
-  *out_M = M;
-  return 0;
+  GrayImage *roi = rotate_view_roi(view, x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+  if (!roi)
+    return -3;
+  int rc = extract_letters_roi(roi->data, roi->stride, roi->w, roi->h, view,
+                               x1, y1, out);
+  gray_free(roi);
+  return rc;
 }
@@ -3,14 +3,29 @@
 
 #include <SDL2/SDL.h>
 #include "../neural_network/digitalisation.h"
+#include "../gray_image/gray_image.h"
+#include "../rotation/rotation.h"
+#include "../tile_batch/tile_batch.h"
 
 // Extract letters from a grid region [x1..x2] x [y1..y2] on the image.
-// The result is an N x M matrix of 28x28 tiles (Uint8[784]) or NULL for empty cells.
-// Returns 0 on success, negative value on error.
+// The result is an N x M grid batch of 28x28 tiles (out->rows x out->cols);
+// empty cells are left unused. info[k].src is the ink bounding box of the
+// letter relative to the region. Free it with tile_batch_free.
+// Returns 0 on success, negative value on error (out is then empty).
 int extract_letters(SDL_Surface *src,
                     int x1, int y1, int x2, int y2,
-                    Uint8 ****out_matrix,
-                    int *out_N,
-                    int *out_M);
+                    TileBatch *out);
+
+// Same as extract_letters(), on an already computed luminance plane.
+int extract_letters_gray(const GrayImage *img,
+                         int x1, int y1, int x2, int y2,
+                         TileBatch *out);
+
+// Same on a virtually rotated page (ROI in rotated page coordinates): the
+// ROI alone is rendered to find the cells, no full rotated copy, and each
+// tile is sampled once from the unrotated source.
+int extract_letters_view(const GrayView *view,
+                         int x1, int y1, int x2, int y2,
+                         TileBatch *out);
 
 #endif
@@ -21,10 +21,13 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "gray_image/gray_image.h"
 #include "image_cleaner/image_cleaner.h"
 #include "pipeline_interface/pipeline_interface.h"
 #include "rotation/rotation.h"
 #include "setup_image/setup_image.h"
+#include "structure_detection/structure_detection.h"
+#include "thread_pool/thread_pool.h"
 
 #ifdef USE_FILE_PICKER
 #include "file_picker/file_picker.h"
@@ -132,6 +135,29 @@ void render_button(SDL_Renderer *renderer, Button *btn, TTF_Font *font,
   }
 }
 
+/**
+ * Copy a luminance plane into the displayed surface
+ *
+ * The plane is written in place when the surface has a compatible 32-bit
+ * layout; otherwise the surface is replaced by a new RGBA8888 one.
+ *
+ * @param gray    Luminance plane produced by the processing steps
+ * @param surface Pointer to the surface shown in the window
+ */
+void sync_surface_from_gray(const GrayImage *gray, SDL_Surface **surface) {
+  if (!gray || !surface)
+    return;
+
+  if (*surface && gray_to_surface(gray, *surface) == 0)
+    return;
+
+  SDL_Surface *fresh = gray_to_new_surface(gray);
+  if (fresh) {
+    SDL_FreeSurface(*surface);
+    *surface = fresh;
+  }
+}
+
 /**
  * Main application entry point
  *
@@ -363,12 +389,19 @@ int main(int argc, char **argv) {
   printf("  O / Open File         - Select a new file\n");
 #endif
   printf("  A / Auto Process      - Apply all steps "
-         "(Grayscale→Otsu→Rotate→Denoise→Solve Grid)\n");
+         "(Grayscale→Otsu→Denoise→Rotate→Solve Grid)\n");
   printf("  C / Reset button      - Reload original image\n");
-  printf("  H / Otsu button       - Apply Otsu thresholding\n");
+  printf("  H / Otsu button       - Apply thresholding (Otsu by default)\n");
+  printf("  T                     - Switch threshold: Otsu/Sauvola/Bradley\n");
   printf("  G / Grayscale button  - Convert to grayscale\n");
   printf("  R / Rotate button     - Auto-rotate/deskew\n");
+  printf("  D                     - Switch deskew: letter lattice/Hough\n");
+  printf("  B                     - Switch rotation: bilinear/three-shear/nearest\n");
+  printf("  E                     - Toggle expanded rotation canvas\n");
   printf("  J / Denoise button    - Remove noise\n");
+  printf("  M                     - Switch Auto Process denoise: "
+         "3x3 neighbours/open/close/open+close\n");
+  printf("  K                     - Switch open/close kernel: 3x3/5x5/7x7\n");
   printf("  Ctrl+S / Save button  - Save current image\n");
   printf("  V / Solve Grid        - Detect and solve crossword grid\n");
   printf("  ESC/Q                 - Quit\n");
@@ -440,9 +473,16 @@ int main(int argc, char **argv) {
           case ACTION_AUTO_PROCESS:
             printf("\n=== Starting Auto Processing ===\n");
 
-            // Step 1: Grayscale
+            // Step 1: Grayscale (luminance plane computed once, reused by
+            // every following step)
             printf("[1/5] Converting to grayscale...\n");
-            convert_to_grayscale(surface);
+            int histogram[GRAY_LEVELS];
+            GrayImage *gray = gray_from_surface_hist(surface, histogram);
+            if (!gray) {
+              printf("Error: grayscale conversion failed\n");
+              break;
+            }
+            sync_surface_from_gray(gray, &surface);
             save_surface(&data, surface, "auto_1_grayscale");
             SDL_DestroyTexture(texture);
             texture = SDL_CreateTextureFromSurface(renderer, surface);
@@ -456,8 +496,10 @@ int main(int argc, char **argv) {
             SDL_Delay(300);
 
             // Step 2: Otsu Thresholding
-            printf("[2/5] Applying Otsu thresholding...\n");
-            apply_otsu_thresholding(surface);
+            printf("[2/5] Applying %s thresholding...\n",
+                   threshold_method_name(get_threshold_method()));
+            apply_thresholding_gray(gray, histogram);
+            sync_surface_from_gray(gray, &surface);
             save_surface(&data, surface, "auto_2_otsu");
             SDL_DestroyTexture(texture);
             texture = SDL_CreateTextureFromSurface(renderer, surface);
@@ -469,30 +511,13 @@ int main(int argc, char **argv) {
             SDL_RenderPresent(renderer);
             SDL_Delay(300);
 
-            // Step 3: Rotate
-            printf("[3/5] Auto-rotating image...\n");
-            double angle = auto_deskew_correction(surface);
-            printf("        Detected angle: %.2f degrees\n", angle);
-            SDL_Surface *rot = rotate(surface, angle);
-            if (rot) {
-              SDL_FreeSurface(surface);
-              surface = rot;
-              save_surface(&data, surface, "auto_3_rotation");
-              SDL_DestroyTexture(texture);
-              texture = SDL_CreateTextureFromSurface(renderer, surface);
-              SDL_RenderClear(renderer);
-              SDL_RenderCopy(renderer, texture, NULL, &img_rect);
-              for (int i = 0; i < num_buttons; i++) {
-                render_button(renderer, &buttons[i], font, (i == hover_button));
-              }
-              SDL_RenderPresent(renderer);
-              SDL_Delay(300);
-            }
-
-            // Step 4: Denoise
-            printf("[4/5] Applying noise removal...\n");
-            apply_noise_removal(surface, 2);
-            save_surface(&data, surface, "auto_4_denoise_FINAL");
+            // Step 3: Denoise (on the unrotated plane, the letter tiles are
+            // later sampled from it)
+            printf("[3/5] Applying noise removal (%s)...\n",
+                   denoise_method_name(get_denoise_method()));
+            apply_denoise_gray(gray, 2);
+            sync_surface_from_gray(gray, &surface);
+            save_surface(&data, surface, "auto_3_denoise");
             SDL_DestroyTexture(texture);
             texture = SDL_CreateTextureFromSurface(renderer, surface);
             SDL_RenderClear(renderer);
@@ -503,6 +528,20 @@ int main(int argc, char **argv) {
             SDL_RenderPresent(renderer);
             SDL_Delay(300);
 
+            // Step 4: Rotate. The deskew is kept virtual: no full size
+            // rotated page is built, the pipeline locates the grid on a
+            // reduced rendition and samples the tiles through the view.
+            // The page is labeled once: the letter deskew reads the
+            // components, and detection reuses them on an upright page
+            printf("[4/5] Auto-rotating image...\n");
+            ComponentList cc;
+            int labeled = components_label(gray, &cc) == 0;
+            double angle = estimate_deskew_gray(gray, labeled ? &cc : NULL);
+            printf("        Detected angle: %.2f degrees\n", angle);
+            GrayView view;
+            rotate_view_init(&view, gray, angle, get_rotate_filter(),
+                             get_rotate_expand());
+
             // Step 5: Solve Grid
             printf("[5/5] Solving crossword grid...\n");
 
@@ -529,7 +568,11 @@ int main(int argc, char **argv) {
             SDL_RenderPresent(renderer);
             SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
-            SDL_Surface *result = pipeline(surface, renderer);
+            SDL_Surface *result = pipeline_view(&view, labeled ? &cc : NULL,
+                                                surface, renderer);
+            if (labeled)
+              components_free(&cc);
+            gray_free(gray);
             if (result) {
               printf("Pipeline completed successfully!\n");
               SDL_Surface *result_image = IMG_Load("result.png");
@@ -561,7 +604,7 @@ int main(int argc, char **argv) {
 
           case ACTION_ROTATE: {
             printf("Auto-rotating image...\n");
-            double angle = auto_deskew_correction(surface);
+            double angle = estimate_deskew(surface);
             printf("Detected angle: %.2f degrees\n", angle);
             SDL_Surface *rot = rotate(surface, angle);
             if (rot) {
@@ -583,8 +626,9 @@ int main(int argc, char **argv) {
             break;
 
           case ACTION_OTSU:
-            printf("Applying Otsu thresholding...\n");
-            apply_otsu_thresholding(surface);
+            printf("Applying %s thresholding...\n",
+                   threshold_method_name(get_threshold_method()));
+            apply_thresholding(surface);
             save_surface(&data, surface, "otsu_thresholding");
             SDL_DestroyTexture(texture);
             texture = SDL_CreateTextureFromSurface(renderer, surface);
@@ -714,35 +758,42 @@ int main(int argc, char **argv) {
           printf("\n=== Starting Auto Processing ===\n");
 
           printf("[1/5] Converting to grayscale...\n");
-          convert_to_grayscale(surface);
+          int histogram[GRAY_LEVELS];
+          GrayImage *gray = gray_from_surface_hist(surface, histogram);
+          if (!gray) {
+            printf("Error: grayscale conversion failed\n");
+            break;
+          }
+          sync_surface_from_gray(gray, &surface);
           save_surface(&data, surface, "auto_1_grayscale");
           SDL_DestroyTexture(texture);
           texture = SDL_CreateTextureFromSurface(renderer, surface);
 
-          printf("[2/5] Applying Otsu thresholding...\n");
-          apply_otsu_thresholding(surface);
+          printf("[2/5] Applying %s thresholding...\n",
+                 threshold_method_name(get_threshold_method()));
+          apply_thresholding_gray(gray, histogram);
+          sync_surface_from_gray(gray, &surface);
           save_surface(&data, surface, "auto_2_otsu");
           SDL_DestroyTexture(texture);
           texture = SDL_CreateTextureFromSurface(renderer, surface);
 
-          printf("[3/5] Auto-rotating image...\n");
-          double angle = auto_deskew_correction(surface);
-          printf("        Detected angle: %.2f degrees\n", angle);
-          SDL_Surface *rot = rotate(surface, angle);
-          if (rot) {
-            SDL_FreeSurface(surface);
-            surface = rot;
-            save_surface(&data, surface, "auto_3_rotation");
-            SDL_DestroyTexture(texture);
-            texture = SDL_CreateTextureFromSurface(renderer, surface);
-          }
-
-          printf("[4/5] Applying noise removal...\n");
-          apply_noise_removal(surface, 2);
-          save_surface(&data, surface, "auto_4_denoise_FINAL");
+          printf("[3/5] Applying noise removal (%s)...\n",
+                 denoise_method_name(get_denoise_method()));
+          apply_denoise_gray(gray, 2);
+          sync_surface_from_gray(gray, &surface);
+          save_surface(&data, surface, "auto_3_denoise");
           SDL_DestroyTexture(texture);
           texture = SDL_CreateTextureFromSurface(renderer, surface);
 
+          printf("[4/5] Auto-rotating image...\n");
+          ComponentList cc; // labeled once for the deskew and the detection
+          int labeled = components_label(gray, &cc) == 0;
+          double angle = estimate_deskew_gray(gray, labeled ? &cc : NULL);
+          printf("        Detected angle: %.2f degrees\n", angle);
+          GrayView view;
+          rotate_view_init(&view, gray, angle, get_rotate_filter(),
+                           get_rotate_expand());
+
           printf("[5/5] Solving crossword grid...\n");
 
           // Display "Résolution en cours..." message
@@ -768,7 +819,11 @@ int main(int argc, char **argv) {
           SDL_RenderPresent(renderer);
           SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
-          SDL_Surface *result = pipeline(surface, renderer);
+          SDL_Surface *result =
+              pipeline_view(&view, labeled ? &cc : NULL, surface, renderer);
+          if (labeled)
+            components_free(&cc);
+          gray_free(gray);
           if (result) {
             printf("Pipeline completed successfully!\n");
             SDL_Surface *result_image = IMG_Load("result.png");
@@ -801,7 +856,7 @@ int main(int argc, char **argv) {
 
         case SDLK_r: {
           printf("Auto-rotating image...\n");
-          double angle = auto_deskew_correction(surface);
+          double angle = estimate_deskew(surface);
           printf("Detected angle: %.2f degrees\n", angle);
           SDL_Surface *rot = rotate(surface, angle);
           if (rot) {
@@ -823,13 +878,63 @@ int main(int argc, char **argv) {
           break;
 
         case SDLK_h:
-          printf("Applying Otsu thresholding...\n");
-          apply_otsu_thresholding(surface);
+          printf("Applying %s thresholding...\n",
+                 threshold_method_name(get_threshold_method()));
+          apply_thresholding(surface);
           save_surface(&data, surface, "otsu_thresholding");
           SDL_DestroyTexture(texture);
           texture = SDL_CreateTextureFromSurface(renderer, surface);
           break;
 
+        case SDLK_t: {
+          // Cycle Otsu -> Sauvola -> Bradley for the threshold step
+          ThresholdMethod m = (get_threshold_method() + 1) % 3;
+          set_threshold_method(m);
+          printf("Threshold method: %s\n", threshold_method_name(m));
+          break;
+        }
+
+        case SDLK_m: {
+          // Cycle the Auto Process denoise stage
+          DenoiseMethod m = (get_denoise_method() + 1) % 4;
+          set_denoise_method(m);
+          printf("Denoise method: %s\n", denoise_method_name(m));
+          break;
+        }
+
+        case SDLK_k: {
+          // Cycle the open / close structuring element 3x3 -> 5x5 -> 7x7
+          int kw, kh;
+          get_morph_kernel(&kw, &kh);
+          int k = kw >= 7 ? 3 : kw + 2;
+          set_morph_kernel(k, k);
+          printf("Morphology kernel: %dx%d\n", k, k);
+          break;
+        }
+
+        case SDLK_d: {
+          // Letter centroid fit (Hough fallback) or Hough only
+          DeskewMethod m = (get_deskew_method() + 1) % 2;
+          set_deskew_method(m);
+          printf("Deskew method: %s\n", deskew_method_name(m));
+          break;
+        }
+
+        case SDLK_b: {
+          // Cycle nearest / bilinear / three-shear rotation
+          RotateFilter f = (get_rotate_filter() + 1) % 3;
+          set_rotate_filter(f);
+          printf("Rotation filter: %s\n", rotate_filter_name(f));
+          break;
+        }
+
+        case SDLK_e:
+          // Toggle the expanded canvas (rotated corners kept)
+          set_rotate_expand(!get_rotate_expand());
+          printf("Rotation canvas: %s\n",
+                 get_rotate_expand() ? "expanded" : "same size");
+          break;
+
         case SDLK_j:
           printf("Applying noise removal...\n");
           apply_noise_removal(surface, 2);
@@ -947,5 +1052,6 @@ int main(int argc, char **argv) {
   SDL_DestroyWindow(win);
   IMG_Quit();
   SDL_Quit();
+  thread_pool_shutdown();
   return 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <SDL2/SDL_image.h>
 #include "../neural_network/digitalisation.h"
 #include <stdint.h>
+#include <math.h>
 
 /*
  * surface_to_28:
@@ -70,3 +71,141 @@ int surface_to_28(SDL_Surface *src, uint8_t out784[784])
     SDL_UnlockSurface(src);
     return 0;
 }
+
+/*
+ * gray_to_28:
+ *  - Take a w x h gray patch (rows stride bytes apart) placed at (ox, oy)
+ *    in a side x side window; the rest of the window is white
+ *  - Area-average the window into a 28x28 grid: each output pixel is the
+ *    mean of the window area it covers, window pixels cut by its border
+ *    being weighted by their overlap (works for side < 28 as well)
+ *  - Write the result into out784 (28*28 bytes, row-major)
+ *  - Return 0 on success, <0 on error
+ */
+int gray_to_28(const uint8_t *src, int stride, int w, int h,
+               int ox, int oy, int side, uint8_t out784[784])
+{
+    if (!out784 || side <= 0)
+        return -1;
+
+    // Clip the patch to the window
+    int x0 = ox < 0 ? 0 : ox, x1 = ox + w > side ? side : ox + w;
+    int y0 = oy < 0 ? 0 : oy, y1 = oy + h > side ? side : oy + h;
+    if ((x1 > x0 && y1 > y0) && !src)
+        return -1;
+
+    // Ink (255 - v) accumulated per output pixel. Positions are counted in
+    // 1/28 of a window pixel: window pixel p spans [28p, 28p + 28) and
+    // output pixel q spans [side * q, side * (q + 1)), so every output
+    // pixel receives a total weight of side * side.
+    uint64_t acc[784] = {0};
+    uint32_t hrow[28];
+
+    for (int py = y0; py < y1; ++py) {
+        const uint8_t *row = src + (size_t)(py - oy) * (size_t)stride - ox;
+
+        // Horizontal pass over this window row
+        for (int q = 0; q < 28; ++q) hrow[q] = 0;
+        for (int px = x0; px < x1; ++px) {
+            uint32_t d = 255u - row[px];
+            if (!d) continue;
+            int lo = 28 * px, hi = lo + 28;
+            for (int q = lo / side; q < 28 && side * q < hi; ++q) {
+                int a = side * q > lo ? side * q : lo;
+                int b = side * (q + 1) < hi ? side * (q + 1) : hi;
+                hrow[q] += d * (uint32_t)(b - a);
+            }
+        }
+
+        // Vertical pass: spread the row over the output rows it touches
+        int lo = 28 * py, hi = lo + 28;
+        for (int q = lo / side; q < 28 && side * q < hi; ++q) {
+            int a = side * q > lo ? side * q : lo;
+            int b = side * (q + 1) < hi ? side * (q + 1) : hi;
+            uint64_t *dst = acc + q * 28;
+            for (int x = 0; x < 28; ++x) dst[x] += (uint64_t)(b - a) * hrow[x];
+        }
+    }
+
+    uint64_t area = (uint64_t)side * (uint64_t)side;
+    for (int i = 0; i < 784; ++i)
+        out784[i] = (uint8_t)(255u - (uint32_t)((acc[i] + area / 2) / area));
+    return 0;
+}
+
+/*
+ * gray_view_to_28:
+ *  - Same window as gray_to_28, the patch being read through a GrayView
+ *  - Each output pixel (side / 28 window pixels wide) is the mean of n x n
+ *    samples of its area, n = ceil(side / 28) clamped to 2..VIEW28_MAX_SUB,
+ *    taken straight from the unrotated source by rotate_view_sample;
+ *    samples outside the patch count as white and are not taken
+ *  - One band of n lattice rows at a time on the stack: no heap scratch,
+ *    so cells can run on the thread pool
+ *  - Return 0 on success, <0 on error
+ */
+#define VIEW28_MAX_SUB 4
+
+// First lattice sample in window pixel >= p (sample i is in window pixel
+// floor((i + 0.5) * step)), clamped to [0, L]
+static int first_sample_at(int p, double step, int L)
+{
+    int i = (int)ceil(p / step - 0.5);
+    if (i < 0)
+        i = 0;
+    while (i > 0 && (int)floor((i - 0.5) * step) >= p)
+        --i;
+    while (i < L && (int)floor((i + 0.5) * step) < p)
+        ++i;
+    return i > L ? L : i;
+}
+
+int gray_view_to_28(const GrayView *view, int px, int py, int w, int h,
+                    int ox, int oy, int side, uint8_t out784[784])
+{
+    if (!view || !view->src || !out784 || side <= 0)
+        return -1;
+    if (rotate_view_is_identity(view)) {
+        const GrayImage *src = view->src;
+        if (w > 0 && h > 0 && (px < 0 || py < 0 || px + w > src->w ||
+                               py + h > src->h))
+            return -1;
+        const uint8_t *patch = (w > 0 && h > 0) ? gray_row(src, py) + px : NULL;
+        return gray_to_28(patch, src->stride, w, h, ox, oy, side, out784);
+    }
+
+    int n = (side + 27) / 28;
+    if (n < 2)
+        n = 2;
+    if (n > VIEW28_MAX_SUB)
+        n = VIEW28_MAX_SUB;
+    int L = 28 * n;                  // samples per window side
+    double step = (double)side / L;  // in window (= page) pixels
+
+    // Samples [a0, a1) x [b0, b1) fall in the patch
+    int a0 = first_sample_at(oy, step, L), a1 = first_sample_at(oy + h, step, L);
+    int b0 = first_sample_at(ox, step, L), b1 = first_sample_at(ox + w, step, L);
+
+    // Window point (wx, wy) is page point (px - ox + wx, py - oy + wy)
+    double org = 0.5 * step - 0.5;
+    uint8_t band[VIEW28_MAX_SUB * 28 * VIEW28_MAX_SUB];
+    uint32_t area = (uint32_t)(n * n);
+    for (int qy = 0; qy < 28; ++qy) {
+        uint32_t ink[28] = {0};
+        int r0 = qy * n > a0 ? qy * n : a0;
+        int r1 = (qy + 1) * n < a1 ? (qy + 1) * n : a1;
+        if (r0 < r1 && b0 < b1) {
+            rotate_view_sample(view, px - ox + org + b0 * step,
+                               py - oy + org + r0 * step, step, b1 - b0,
+                               r1 - r0, band, L);
+            for (int r = 0; r < r1 - r0; ++r) {
+                const uint8_t *row = band + r * L;
+                for (int b = b0; b < b1; ++b)
+                    ink[b / n] += 255u - row[b - b0];
+            }
+        }
+        for (int qx = 0; qx < 28; ++qx)
+            out784[qy * 28 + qx] = (uint8_t)(255u - (ink[qx] + area / 2) / area);
+    }
+    return 0;
+}
@@ -1,6 +1,20 @@
 #ifndef DIGITALISATION_H
 #define DIGITALISATION_H
 
+#include "../rotation/rotation.h"
+
 int surface_to_28(SDL_Surface *src, uint8_t out784[784]);
 
+/* Area-averaged 28x28 tile of a w x h gray patch placed at (ox, oy) in a
+ * white side x side window. */
+int gray_to_28(const uint8_t *src, int stride, int w, int h,
+               int ox, int oy, int side, uint8_t out784[784]);
+
+/* Same tile for a patch of a virtually rotated page: the w x h patch at
+ * (px, py) in page coordinates, placed at (ox, oy) in the window. Every
+ * output pixel averages samples of its area taken straight from
+ * view->src (one resampling); identity views use gray_to_28 in place. */
+int gray_view_to_28(const GrayView *view, int px, int py, int w, int h,
+                    int ox, int oy, int side, uint8_t out784[784]);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+// normalize.c
+#include "normalize.h"
+
+#include <math.h>       // floor, ceil, lround
+#include <stdio.h>      // fprintf
+#include <stdlib.h>     // calloc, malloc, free, qsort
+
+/* ---------------------------------------------------------------------------
+ * Glyph height estimate
+ *
+ * Rows are visited every `step` lines; each unvisited black pixel on them
+ * seeds a flood fill (4-connexity) giving the bounding box of its
+ * component. Components that are too big (grid lines, frames), too small
+ * (noise) or too elongated are ignored, the median height of the others is
+ * the glyph height.
+ * -------------------------------------------------------------------------- */
+
+#define GLYPH_SAMPLE_ROWS 96     // rows scanned for seeds
+#define GLYPH_MAX_SAMPLES 256    // components kept
+#define GLYPH_MIN_HEIGHT  6
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static inline int is_ink(const GrayImage *img, int x, int y)
+{
+    return gray_row(img, y)[x] < 128;
+}
+
+static inline int seen_test(const Uint8 *seen, int w, int x, int y)
+{
+    size_t i = (size_t)y * (size_t)w + (size_t)x;
+    return (seen[i >> 3] >> (i & 7)) & 1;
+}
+
+static inline void seen_mark(Uint8 *seen, int w, int x, int y)
+{
+    size_t i = (size_t)y * (size_t)w + (size_t)x;
+    seen[i >> 3] |= (Uint8)(1u << (i & 7));
+}
+
+int estimate_glyph_height(const GrayImage *img)
+{
+    if (!img || img->w <= 0 || img->h <= 0) return 0;
+
+    int w = img->w, h = img->h;
+    size_t n = (size_t)w * (size_t)h;
+    Uint8 *seen = calloc((n + 7) / 8, 1);
+    size_t cap = 4096;
+    int *stack = malloc(cap * 2 * sizeof(int));
+    int *heights = malloc(GLYPH_MAX_SAMPLES * sizeof(int));
+    if (!seen || !stack || !heights) {
+        free(seen);
+        free(stack);
+        free(heights);
+        fprintf(stderr, "estimate_glyph_height: out of memory\n");
+        return 0;
+    }
+
+    int count = 0;
+    int step = h / GLYPH_SAMPLE_ROWS;
+    if (step < 1) step = 1;
+
+    for (int sy = step / 2; sy < h && count < GLYPH_MAX_SAMPLES; sy += step) {
+        for (int sx = 0; sx < w && count < GLYPH_MAX_SAMPLES; ++sx) {
+            if (!is_ink(img, sx, sy) || seen_test(seen, w, sx, sy)) continue;
+
+            size_t top = 0;
+            int ok = 1;
+            int x0 = sx, x1 = sx, y0 = sy, y1 = sy;
+            seen_mark(seen, w, sx, sy);
+            stack[top++] = sx;
+            stack[top++] = sy;
+
+            while (top > 0) {
+                int y = stack[--top];
+                int x = stack[--top];
+                if (x < x0) x0 = x;
+                if (x > x1) x1 = x;
+                if (y < y0) y0 = y;
+                if (y > y1) y1 = y;
+
+                static const int dx[4] = { 1, -1, 0, 0 };
+                static const int dy[4] = { 0, 0, 1, -1 };
+                for (int k = 0; k < 4; ++k) {
+                    int nx = x + dx[k], ny = y + dy[k];
+                    if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                    if (!is_ink(img, nx, ny) || seen_test(seen, w, nx, ny)) continue;
+                    if (top + 2 > cap * 2) {
+                        int *grown = realloc(stack, cap * 4 * sizeof(int));
+                        if (!grown) { ok = 0; continue; }
+                        stack = grown;
+                        cap *= 2;
+                    }
+                    seen_mark(seen, w, nx, ny);
+                    stack[top++] = nx;
+                    stack[top++] = ny;
+                }
+            }
+
+            // Big components (grid, frames) were fully marked all the same,
+            // so their pixels never seed letter-sized fragments
+            int bw = x1 - x0 + 1, bh = y1 - y0 + 1;
+            if (!ok) continue;
+            if (bh < GLYPH_MIN_HEIGHT || bh > h / 8) continue;
+            if (bw > 2 * bh) continue;
+            heights[count++] = bh;
+        }
+    }
+
+    int result = 0;
+    if (count > 0) {
+        qsort(heights, (size_t)count, sizeof(int), cmp_int);
+        result = heights[count / 2];
+    }
+
+    free(seen);
+    free(stack);
+    free(heights);
+    return result;
+}
+
+/* ---------------------------------------------------------------------------
+ * Normalization
+ * -------------------------------------------------------------------------- */
+
+GrayImage *normalize_resolution(const GrayImage *img, PageScale *scale)
+{
+    if (scale) scale->sx = scale->sy = 1.0;
+    if (!img) return NULL;
+
+    int glyph = estimate_glyph_height(img);
+    if (glyph <= NORMALIZE_MAX_HEIGHT) return NULL;
+
+    double s = (double)NORMALIZE_TARGET_HEIGHT / glyph;
+    int dw = (int)lround(img->w * s);
+    int dh = (int)lround(img->h * s);
+    if (dw < 1 || dh < 1) return NULL;
+
+    GrayImage *out = gray_resize_area(img, dw, dh);
+    if (!out) return NULL;
+
+    if (scale) {
+        scale->sx = (double)dw / img->w;
+        scale->sy = (double)dh / img->h;
+    }
+    return out;
+}
+
+SDL_Rect normalize_rect_to_original(SDL_Rect r, const PageScale *scale)
+{
+    if (!scale || (scale->sx == 1.0 && scale->sy == 1.0)) return r;
+
+    int x0 = (int)floor(r.x / scale->sx);
+    int y0 = (int)floor(r.y / scale->sy);
+    int x1 = (int)ceil((r.x + r.w) / scale->sx);
+    int y1 = (int)ceil((r.y + r.h) / scale->sy);
+    SDL_Rect o = { x0, y0, x1 - x0, y1 - y0 };
+    return o;
+}
+
+void normalize_point_to_original(double *x, double *y, const PageScale *scale)
+{
+    if (!scale) return;
+    if (x) *x /= scale->sx;
+    if (y) *y /= scale->sy;
+}
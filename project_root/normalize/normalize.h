@@ -0,0 +1,35 @@
+#ifndef NORMALIZE_H
+#define NORMALIZE_H
+
+#include <SDL2/SDL.h>
+#include "../gray_image/gray_image.h"
+
+/* Glyph height band (pixels) the detection stages are tuned for. Pages whose
+ * letters are taller are downscaled to NORMALIZE_TARGET_HEIGHT. */
+#define NORMALIZE_MIN_HEIGHT    32
+#define NORMALIZE_MAX_HEIGHT    48
+#define NORMALIZE_TARGET_HEIGHT 40
+
+/* Scale between a normalized plane and the original page:
+ * normalized = original * s{x,y} (1.0 when the page was left alone). */
+typedef struct {
+    double sx, sy;
+} PageScale;
+
+/* Median height of the letter-sized connected components found on a sample
+ * of the rows of a binarized plane (black < 128). Returns 0 when no
+ * plausible glyph was found. */
+int estimate_glyph_height(const GrayImage *img);
+
+/* Downscale img (area averaging) so its glyphs are about
+ * NORMALIZE_TARGET_HEIGHT pixels tall. Returns the new plane and fills
+ * scale, or returns NULL with scale = 1 when no resampling is needed (small
+ * glyphs, no glyph found, or allocation failure): the caller then keeps
+ * using img. */
+GrayImage *normalize_resolution(const GrayImage *img, PageScale *scale);
+
+/* Map a rectangle / point of the normalized plane back to the original. */
+SDL_Rect normalize_rect_to_original(SDL_Rect r, const PageScale *scale);
+void normalize_point_to_original(double *x, double *y, const PageScale *scale);
+
+#endif
@@ -4,8 +4,11 @@
 #include "../letter_extractor/letter_extractor.h" // extract_letters
 #include "../neural_network/digitalisation.h"     // (if needed by nn)
 #include "../neural_network/nn.h"                 // Network, smart_predict_k
+#include "../normalize/normalize.h" // normalize_resolution, PageScale
+#include "../projection/projection.h" // InkProfile (list projection)
 #include "../solver/solver.h" // CellCand, resolution, resolution_prob
 #include "../structure_detection/structure_detection.h" // grid/list detection
+#include "../thread_pool/thread_pool.h" // parallel_for (one puzzle per band)
 
 #include <SDL2/SDL_image.h>
 #include <ctype.h>
@@ -21,6 +24,10 @@
 #define ACCEPT_MARGIN 0.25f // default required margin p1 - p2
 #define HARD_MARGIN 0.35f   // stronger margin for confusing letter families
 
+// Glyph height (px) of the reduced page the grid and list of a rotated page
+// are located on (see pipeline_view)
+#define DETECT_GLYPH_HEIGHT 20
+
 // Letter prior: we downweight 'W' so it appears less often (index 22).
 static const float LETTER_PRIOR[26] = {
     /* A  B  C  D  E  F  G  H  I  J  K  L  M */
@@ -31,14 +38,15 @@ static const float LETTER_PRIOR[26] = {
 /* -------------------- Small local structs -------------------- */
 typedef struct {
   int x, y, w, h;
-} Box; // simple integer rectangle
+  int ink; // ink pixels (character boxes only)
+} Box;     // simple integer rectangle
 
 /* Logical representation of the LIST area */
 typedef struct {
   int n_lines;     // number of text lines detected
   int *n_words;    // [line]    number of words per line
   int **n_chars;   // [line][w] number of characters per word
-  Uint8 ****tiles; // tiles[line][word][char] -> 784-byte (28x28) buffers
+  TileBatch tiles; // one 28x28 tile per character, in reading order
 } WordMatrix;
 
 /* -------------------- Debug: dump 28x28 buffer to BMP -------------------- */
@@ -76,13 +84,6 @@ static int save_buf784_bmp(const Uint8 *buf784, const char *path) {
 
 /* -------------------- LIST utils: binarize + segment + resize 28
  * -------------------- */
-static inline Uint8 luminance(Uint32 px, SDL_PixelFormat *fmt) {
-  Uint8 r, g, b;
-  SDL_GetRGB(px, fmt, &r, &g, &b);          // extract RGB channels
-  int y = (30 * r + 59 * g + 11 * b) / 100; // standard luma approximation
-  return (Uint8)y;
-}
-
 static int otsu_from_hist(const int hist[256], int total) {
   if (total <= 0)
     return 128; // degenerate case
@@ -113,28 +114,16 @@ static int otsu_from_hist(const int hist[256], int total) {
   return bestT; // chosen threshold
 }
 
-static void binarize_roi(SDL_Surface *s, SDL_Rect roi, Uint8 *bin) {
-  SDL_LockSurface(s);       // lock for safe pixel access
+// Threshold roi of img into bin (0 = ink, 255 = paper), returns the threshold
+static int binarize_roi(const GrayImage *img, SDL_Rect roi, Uint8 *bin) {
   int W = roi.w, H = roi.h; // ROI width/height
 
-  Uint8 *G = (Uint8 *)malloc((size_t)W * (size_t)H); // grayscale buffer
-  if (!G) {
-    SDL_UnlockSurface(s);
-    return;
-  }
-
   int hist[256] = {0}; // grayscale histogram
   for (int y = 0; y < H; ++y) {
-    Uint8 *p = (Uint8 *)s->pixels + (roi.y + y) * s->pitch +
-               roi.x * 4; // pointer to row start
-    for (int x = 0; x < W; ++x) {
-      Uint32 px = *(Uint32 *)(p + 4 * x); // ARGB pixel
-      Uint8 Y = luminance(px, s->format); // grayscale 0..255
-      G[y * W + x] = Y;
-      hist[Y]++; // build histogram
-    }
+    const Uint8 *G = gray_row(img, roi.y + y) + roi.x; // luminance row
+    for (int x = 0; x < W; ++x)
+      hist[G[x]]++; // build histogram
   }
-  SDL_UnlockSurface(s);
 
   int total = W * H;                   // number of pixels in ROI
   int T = otsu_from_hist(hist, total); // global Otsu threshold
@@ -144,24 +133,13 @@ static void binarize_roi(SDL_Surface *s, SDL_Rect roi, Uint8 *bin) {
   if (BLACK_THR > 235)
     BLACK_THR = 235; // clamp very high values
 
-  for (int y = 0; y < H; ++y)
-    for (int x = 0; x < W; ++x) {
-      Uint8 Y = G[y * W + x];
+  for (int y = 0; y < H; ++y) {
+    const Uint8 *G = gray_row(img, roi.y + y) + roi.x;
+    for (int x = 0; x < W; ++x)
       bin[y * W + x] =
-          (Y < BLACK_THR) ? 0 : 255; // 0 = black (ink), 255 = white
-    }
-
-  free(G);
-}
-
-static void horiz_proj(const Uint8 *bin, int w, int h, int *hp) {
-  for (int y = 0; y < h; ++y) {
-    int s = 0;
-    const Uint8 *row = bin + y * w; // row pointer
-    for (int x = 0; x < w; ++x)
-      s += (row[x] == 0); // count black pixels
-    hp[y] = s;            // horizontal projection
+          (G[x] < BLACK_THR) ? 0 : 255; // 0 = black (ink), 255 = white
   }
+  return BLACK_THR;
 }
 
 static void find_runs_over(const int *arr, int n, int thr, int minw, Box *out,
@@ -182,17 +160,17 @@ static void find_runs_over(const int *arr, int n, int thr, int minw, Box *out,
   *nout = o; // number of detected runs
 }
 
-static Uint8 *crop_resize_28(const Uint8 *bin, int W, int H, Box bb) {
+// Crop bb from bin and resize it into the blank 28x28 tile out. If view is
+// set (rotated page, bin being its list ROI at org), the tile is sampled
+// from the source through the view instead and thresholded with thr, so
+// it is resampled once.
+static void crop_resize_28(const Uint8 *bin, int W, int H, const GrayView *view,
+                           SDL_Point org, int thr, Box bb, Uint8 *out) {
   const int OUT = 28, PAD = 2, INNER = OUT - 2 * PAD; // 28 with padding around
-  Uint8 *out = (Uint8 *)malloc(OUT * OUT); // 28x28 destination buffer
-  if (!out)
-    return NULL;
-  for (int i = 0; i < OUT * OUT; ++i)
-    out[i] = 255; // start with white background
 
   int cw = bb.w, ch = bb.h; // bounding box size
   if (cw < 1 || ch < 1)
-    return out; // degenerate: return blank tile
+    return; // degenerate: leave the tile blank
 
   float sx = (float)INNER / (float)cw; // scale in x
   float sy = (float)INNER / (float)ch; // scale in y
@@ -203,6 +181,16 @@ static Uint8 *crop_resize_28(const Uint8 *bin, int W, int H, Box bb) {
   int offx = PAD + (INNER - tw) / 2; // center inside INNER region
   int offy = PAD + (INNER - th) / 2;
 
+  if (view) {
+    Uint8 *dst = out + offy * OUT + offx; // tile window, rows OUT apart
+    rotate_view_sample(view, org.x + bb.x, org.y + bb.y, 1.0 / s, tw, th, dst,
+                       OUT);
+    for (int yy = 0; yy < th; ++yy)
+      for (int xx = 0; xx < tw; ++xx)
+        dst[yy * OUT + xx] = (dst[yy * OUT + xx] < thr) ? 0 : 255;
+    return;
+  }
+
   for (int yy = 0; yy < th; ++yy) {
     int syy = bb.y + (int)(yy / s + 0.5f); // source y (nearest neighbor)
     if (syy < 0)
@@ -218,45 +206,22 @@ static Uint8 *crop_resize_28(const Uint8 *bin, int W, int H, Box bb) {
       out[(offy + yy) * OUT + (offx + xx)] = bin[syy * W + sxx]; // copy pixel
     }
   }
-  return out;
 }
 
 /* -------------------- Memory helpers -------------------- */
-static void free_out_matrix(Uint8 ***Mat, int N, int M) {
-  if (!Mat)
-    return;
-  for (int i = 0; i < N; ++i) {
-    if (!Mat[i])
-      continue;
-    for (int j = 0; j < M; ++j)
-      free(Mat[i][j]); // free each 28x28 tile
-    free(Mat[i]);      // free row of pointers
-  }
-  free(Mat); // free row array
-}
-
 static void free_word_matrix(WordMatrix *WM) {
   if (!WM)
     return;
-  for (int L = 0; L < WM->n_lines; ++L) {
-    for (int Wd = 0; Wd < WM->n_words[L]; ++Wd) {
-      for (int C = 0; C < WM->n_chars[L][Wd]; ++C)
-        free(WM->tiles[L][Wd][C]); // free each character tile
-      free(WM->tiles[L][Wd]);      // free characters of word
-    }
-    free(WM->tiles[L]);   // free words in that line
-    free(WM->n_chars[L]); // free char counts for line
-  }
-  free(WM->tiles);            // free all tiles pointers
+  for (int L = 0; L < WM->n_lines; ++L)
+    free(WM->n_chars[L]);     // free char counts for line
   free(WM->n_chars);          // free char count per word
   free(WM->n_words);          // free word count per line
-  memset(WM, 0, sizeof(*WM)); // reset structure
+  tile_batch_free(&WM->tiles); // free all character tiles at once
+  memset(WM, 0, sizeof(*WM));  // reset structure
 }
 
 /* -------------------- LIST extraction: connected components
  * -------------------- */
-#define MAX_CHARS_PER_LINE 1024 // safety limit to avoid insane lines
-
 static int cmp_box_x(const void *a, const void *b) {
   const Box *A = (const Box *)a, *B = (const Box *)b;
   return (A->x > B->x) - (A->x < B->x); // sort by x (left to right)
@@ -267,7 +232,7 @@ static int cmp_int(const void *a, const void *b) {
   return (A > B) - (A < B); // ascending integer compare
 }
 
-static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
+static int extract_words(const GrayView *view, SDL_Rect list, WordMatrix *WM) {
   memset(WM, 0, sizeof(*WM)); // reset output structure
 
   int W = list.w, H = list.h; // LIST ROI size
@@ -278,22 +243,45 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
       (Uint8 *)malloc((size_t)W * (size_t)H); // binary image of the list
   if (!bin)
     return -1;
-  binarize_roi(surf, list, bin); // threshold list region
 
-  int *hp = (int *)malloc(sizeof(int) * H); // horizontal projection
-  if (!hp) {
+  int thr;
+  const GrayView *tview = NULL; // tiles sampled through it (rotated page)
+  if (rotate_view_is_identity(view)) {
+    thr = binarize_roi(view->src, list, bin); // threshold list region in place
+  } else {
+    // Rotated page: render the list region alone from the source to find
+    // the characters; their tiles are sampled again from the source
+    GrayImage *roi = rotate_view_roi(view, list.x, list.y, W, H);
+    if (!roi) {
+      free(bin);
+      return -1;
+    }
+    thr = binarize_roi(roi, (SDL_Rect){0, 0, W, H}, bin);
+    gray_free(roi);
+    tview = view;
+  }
+
+  // ink profile of the list: ink->row is the horizontal projection
+  InkProfile *ink = ink_profile_create(bin, W, H, W, 128);
+  if (!ink) {
     free(bin);
     return -2;
   }
-  horiz_proj(bin, W, H, hp); // count strokes per row
 
-  Box lineRuns[1024]; // potential text lines
+  // potential text lines: runs are separated by at least one row
+  Box *lineRuns = (Box *)malloc(sizeof(Box) * (size_t)(H / 2 + 1));
+  if (!lineRuns) {
+    ink_profile_free(ink);
+    free(bin);
+    return -2;
+  }
   int nL = 0;
-  find_runs_over(hp, H, (int)(0.02 * W), 4, lineRuns,
+  find_runs_over(ink->row, H, (int)(0.02 * W), 4, lineRuns,
                  &nL); // rows with enough black pixels
-  free(hp);
+  ink_profile_free(ink);
 
   if (nL <= 0) {
+    free(lineRuns);
     free(bin);
     return 0;
   } // no lines detected
@@ -302,17 +290,18 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
   WM->n_words = (int *)calloc((size_t)nL, sizeof(int)); // words per line
   WM->n_chars =
       (int **)calloc((size_t)nL, sizeof(int *)); // chars per word per line
-  WM->tiles = (Uint8 ****)calloc((size_t)nL,
-                                 sizeof(Uint8 ***)); // tiles per word per line
-  if (!WM->n_words || !WM->n_chars || !WM->tiles) {
+  if (!WM->n_words || !WM->n_chars) {
     free(WM->n_words);
     free(WM->n_chars);
-    free(WM->tiles);
     memset(WM, 0, sizeof(*WM));
+    free(lineRuns);
     free(bin);
     return -3;
   }
 
+  Box *charBoxes = NULL; // per-character bounding boxes, grown as needed
+  int capC = 0;
+
   for (int L = 0; L < nL; ++L) {
     int y0 = lineRuns[L].x; // starting row of line
     int hL = lineRuns[L].w; // height of line in rows
@@ -331,7 +320,6 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
       continue;
     }
 
-    Box charBoxes[MAX_CHARS_PER_LINE]; // per-character bounding boxes
     int nC = 0;
     const int dx4[4] = {1, -1, 0, 0}; // 4-neighbourhood (4-connectivity)
     const int dy4[4] = {0, 0, 1, -1};
@@ -341,8 +329,6 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
         int idx = yy * W + xx; // index inside line window
         if (bin[(y0 + yy) * W + xx] == 0 &&
             !vis[idx]) { // black pixel not yet visited
-          if (nC >= MAX_CHARS_PER_LINE)
-            break; // avoid overflow
           int front = 0, back = 0;
           vis[idx] = 1; // mark first pixel as visited
           qx[back] = xx;
@@ -382,6 +368,7 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
           int area = bb_w * bb_h;
           if (area < 15 || bb_h < hL * 0.3f)
             continue; // reject tiny/noise components
+          int ink = back; // every queued pixel is black
 
           int expand = 1; // small padding
           int left = minx - expand;
@@ -402,11 +389,18 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
           bb.y = y0 + topRel; // y in full list coords
           bb.w = right - left + 1;
           bb.h = botRel - topRel + 1;
+          bb.ink = ink;
+          if (nC == capC) { // amortized growth, no cap on dense lines
+            int cap = capC ? capC * 2 : 256;
+            Box *nb = (Box *)realloc(charBoxes, sizeof(Box) * (size_t)cap);
+            if (!nb)
+              continue; // out of memory: drop this character
+            charBoxes = nb;
+            capC = cap;
+          }
           charBoxes[nC++] = bb; // store character bounding box
         }
       }
-      if (nC >= MAX_CHARS_PER_LINE)
-        break; // safety break
     }
 
     free(vis);
@@ -451,17 +445,9 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
         nW++; // large gap → new word
     }
 
-    WM->n_words[L] = nW; // store number of words
     WM->n_chars[L] =
         (int *)calloc((size_t)nW, sizeof(int)); // char counts per word
-    WM->tiles[L] =
-        (Uint8 ***)calloc((size_t)nW, sizeof(Uint8 **)); // tiles per word
-    if (!WM->n_chars[L] || !WM->tiles[L]) {
-      free(WM->n_chars[L]);
-      free(WM->tiles[L]);
-      WM->n_chars[L] = NULL;
-      WM->tiles[L] = NULL;
-      WM->n_words[L] = 0;
+    if (!WM->n_chars[L]) {
       if (gaps)
         free(gaps);
       continue;
@@ -482,34 +468,31 @@ static int extract_words(SDL_Surface *surf, SDL_Rect list, WordMatrix *WM) {
     }
     WM->n_chars[L][wIdx] = count; // last word count
 
-    for (int w = 0; w < nW; ++w)
-      WM->tiles[L][w] = (Uint8 **)calloc(
-          (size_t)WM->n_chars[L][w], sizeof(Uint8 *)); // allocate char slots
-
-    wIdx = 0;
-    int cInWord = 0;
+    // Characters of the line, appended in reading order to the batch
+    int first = tile_batch_append(&WM->tiles, nC);
+    if (first < 0) {
+      free(WM->n_chars[L]); // out of memory: drop the line
+      WM->n_chars[L] = NULL;
+      if (gaps)
+        free(gaps);
+      continue;
+    }
     for (int i = 0; i < nC; ++i) {
       Box bb = charBoxes[i];
-      Uint8 *tile =
-          crop_resize_28(bin, W, H, bb);  // crop + resize character to 28x28
-      WM->tiles[L][wIdx][cInWord] = tile; // store tile
-      cInWord++;
-
-      if (i < nGaps) {
-        int leftEnd = charBoxes[i].x + charBoxes[i].w;
-        int gap = charBoxes[i + 1].x - leftEnd;
-        if (gap < 0)
-          gap = 0;
-        if (gap > thrGap) {
-          wIdx++;
-          cInWord = 0;
-        } // start next word
-      }
+      int k = first + i;
+      crop_resize_28(bin, W, H, tview, (SDL_Point){list.x, list.y}, thr, bb,
+                     tile_pixels(&WM->tiles, k)); // crop + resize to 28x28
+      tile_set_used(&WM->tiles, k);
+      WM->tiles.info[k].src = (SDL_Rect){bb.x, bb.y, bb.w, bb.h};
+      WM->tiles.info[k].ink = bb.ink;
     }
+    WM->n_words[L] = nW; // store number of words
     if (gaps)
       free(gaps);
   }
 
+  free(charBoxes);
+  free(lineRuns);
   free(bin);
   return 0;
 }
@@ -552,8 +535,8 @@ static int accept_or_candidates(const int *idx, const float *prob, int k,
 }
 
 /* -------------------- OCR: 28x28 tile → top-k -------------------- */
-static int ocr_tile_topk(Network *net, const Uint8 *buf784, int k, int *idx,
-                         float *logp, float *prob) {
+static int ocr_tile_topk(const Network *net, const Uint8 *buf784, int k,
+                         int *idx, float *logp, float *prob) {
   float x[784], mean = 0.f;
   for (int i = 0; i < 784; ++i) {
     x[i] = (float)buf784[i] / 255.f; // normalize 0..255 → 0..1
@@ -568,95 +551,74 @@ static int ocr_tile_topk(Network *net, const Uint8 *buf784, int k, int *idx,
   return smart_predict_k(net, x, k, idx, logp, prob); // CNN forward + top-k
 }
 
-/* -------------------- Export grid + words to text file -------------------- */
-static int save_export_file(const char *path, int rows, int cols, char **grid,
-                            char **words, int n_words) {
-  FILE *f = fopen(path, "w");
-  if (!f) {
-    perror("fopen export");
-    return -1;
-  }
-
-  fprintf(f, "%d %d\n", rows, cols); // first line: grid size
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
-      char c = grid[i][j];
-      if (c < 'A' || c > 'Z')
-        c = '?'; // sanitize invalid chars
-      fprintf(f, "%c", c);
-      if (j + 1 < cols)
-        fprintf(f, " "); // space-separated letters
-    }
-    fprintf(f, "\n");
-  }
-  for (int w = 0; w < n_words; ++w)
-    fprintf(f, "%s\n", words[w] ? words[w] : ""); // one word per line
-
-  fclose(f);
-  return 0;
-}
-
-/* -------------------- Main pipeline -------------------- */
-SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
-  if (!surface || !render)
-    return surface; // safety guard
-
-  SDL_Rect grid = {0, 0, 0, 0},
-           list = {0, 0, 0, 0}; // bounding boxes for grid & list
-  if (detect_grid_and_list(surface, &grid, &list) == 0) {
-    printf("GRID:  (%d,%d) -> %dx%d\n", grid.x, grid.y, grid.w, grid.h);
-    printf("LIST:  (%d,%d) -> %dx%d\n", list.x, list.y, list.w, list.h);
-  } else {
-    fprintf(stderr, "detect_grid_and_list: failed\n");
-    return surface;
-  }
+/* -------------------- One puzzle of the page -------------------- */
+typedef struct {
+  int found;   // 0: not found, 1: probabilistic match, 2: exact fallback
+  int out[4];  // start / end cell (col, row, col, row)
+  float score; // log-score of a probabilistic match
+} WordHit;
 
-  Uint8 ***out_matrix = NULL; // [rows][cols] → 28x28 tile
-  int out_N = 0, out_M = 0;   // grid size (rows, cols)
-  int rc = extract_letters(surface, grid.x, grid.y, grid.x + grid.w - 1,
-                           grid.y + grid.h - 1, &out_matrix, &out_N,
-                           &out_M); // segmentation of grid
-  if (rc != 0 || !out_matrix || out_N <= 0 || out_M <= 0) {
-    fprintf(stderr, "extract_letters failed rc=%d\n", rc);
-    return surface;
+// Everything read and solved for one region of the page. Filled by a
+// worker thread; printed and drawn by the caller once all regions are done
+typedef struct {
+  PuzzleRegion region; // grid / list in page coordinates
+  int ready;           // grid read and words solved
+  TileBatch tiles;     // [rows][cols] → 28x28 tile
+  int N, M;            // grid size (rows, cols)
+  CellCand *cells;     // solver cells
+  char **grid_mat;     // top1 letter of each cell
+  int n_lines;         // lines of the list, -1 if no list was read
+  char **words;        // words read from the list
+  int *word_line;      // line / rank of each word in the list (for the log)
+  int *word_rank;
+  int n_words;
+  WordHit *hits; // solver result of each word
+} Puzzle;
+
+static void free_puzzle(Puzzle *pz) {
+  tile_batch_free(&pz->tiles); // free grid tiles
+  free(pz->cells);              // free solver cells
+  if (pz->grid_mat) {
+    for (int i = 0; i < pz->N; ++i)
+      free(pz->grid_mat[i]); // free grid rows
+    free(pz->grid_mat);
   }
-  printf("Extracted %d rows and %d columns of letters.\n", out_N, out_M);
-
-  Network net;                              // CNN weights
-  init_network(&net);                       // initialize / zero / boosters
-  if (load_model("model.bin", &net) != 0) { // load trained model
-    fprintf(stderr, "load_model: failed\n");
-    free_out_matrix(out_matrix, out_N, out_M);
-    return surface;
+  if (pz->words) {
+    for (int i = 0; i < pz->n_words; ++i)
+      free(pz->words[i]);
+    free(pz->words);
   }
+  free(pz->word_line);
+  free(pz->word_rank);
+  free(pz->hits);
+  memset(pz, 0, sizeof(*pz));
+}
 
+// OCR of every grid tile: top1 letter for display, candidates for solving
+static int read_grid(const Network *net, Puzzle *pz) {
+  int out_N = pz->N, out_M = pz->M;
   CellCand *cells = (CellCand *)calloc((size_t)out_N * out_M,
                                        sizeof(CellCand)); // solver cells
   char **grid_mat =
-      (char **)malloc((size_t)out_N * sizeof(char *)); // char grid
+      (char **)calloc((size_t)out_N, sizeof(char *)); // char grid
+  pz->cells = cells;
+  pz->grid_mat = grid_mat;
   if (!cells || !grid_mat) {
     fprintf(stderr, "OOM cells/grid_mat\n");
-    free_out_matrix(out_matrix, out_N, out_M);
-    free(cells);
-    free(grid_mat);
-    return surface;
+    return -1;
   }
   for (int i = 0; i < out_N; ++i) {
     grid_mat[i] =
         (char *)malloc((size_t)out_M * sizeof(char)); // one row of chars
     if (!grid_mat[i]) {
-      for (int t = 0; t < i; ++t)
-        free(grid_mat[t]);
-      free(grid_mat);
-      free_out_matrix(out_matrix, out_N, out_M);
-      free(cells);
-      return surface;
+      fprintf(stderr, "OOM cells/grid_mat\n");
+      return -1;
     }
   }
 
   for (int i = 0; i < out_N; ++i) {
     for (int j = 0; j < out_M; ++j) {
-      Uint8 *buf = out_matrix[i][j]; // 28x28 image for this cell
+      const Uint8 *buf = tile_cell(&pz->tiles, i, j); // 28x28 image, NULL if empty
       if (!buf) {
         grid_mat[i][j] = '?';       // unknown cell
         cells[i * out_M + j].n = 0; // no candidates
@@ -665,7 +627,7 @@ SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
 
       int idx[KTOP];                // top-k class indices
       float logp[KTOP], prob[KTOP]; // log-probs and probs
-      int k = ocr_tile_topk(&net, buf, KTOP, idx, logp, prob);
+      int k = ocr_tile_topk(net, buf, KTOP, idx, logp, prob);
       if (k < 1) {
         grid_mat[i][j] = '?';
         cells[i * out_M + j].n = 0;
@@ -719,231 +681,417 @@ SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
       }
     }
   }
+  return 0;
+}
 
-  printf("\n===== GRID OCR (top1, after prior) =====\n");
-  for (int i = 0; i < out_N; ++i) {
-    for (int j = 0; j < out_M; ++j)
-      printf("%c ", grid_mat[i][j]);
-    printf("\n");
+// Words of the list area (top1 of each character); no list is not an error
+static int read_words(const Network *net, const GrayView *view, Puzzle *pz) {
+  SDL_Rect list = pz->region.list;
+  pz->n_lines = -1;
+  if (list.w <= 0 || list.h <= 0)
+    return 0; // only if list area exists
+
+  WordMatrix WM; // list of text words from the list area
+  if (extract_words(view, list, &WM) != 0)
+    return 0;
+  pz->n_lines = WM.n_lines;
+
+  int total = 0;
+  for (int L = 0; L < WM.n_lines; ++L)
+    for (int Wd = 0; Wd < WM.n_words[L]; ++Wd)
+      total += WM.n_chars[L][Wd] > 0;
+
+  pz->words = (char **)calloc((size_t)total + 1, sizeof(char *));
+  pz->word_line = (int *)malloc(sizeof(int) * ((size_t)total + 1));
+  pz->word_rank = (int *)malloc(sizeof(int) * ((size_t)total + 1));
+  if (!pz->words || !pz->word_line || !pz->word_rank) {
+    fprintf(stderr, "OOM words\n");
+    free_word_matrix(&WM);
+    return -1;
   }
-  printf("========================================\n");
 
-  WordMatrix WM = (WordMatrix){0}; // list of text words from right area
-  int words_cap = 64, words_cnt = 0;
-  char **words = (char **)calloc((size_t)words_cap,
-                                 sizeof(char *)); // dynamic array of words
-
-  if (list.w > 0 && list.h > 0 && words) { // only if list area exists
-    if (extract_words(surface, list, &WM) == 0) {
-      printf("LIST: %d lines\n", WM.n_lines);
-      for (int L = 0; L < WM.n_lines; ++L) {
-        for (int Wd = 0; Wd < WM.n_words[L]; ++Wd) {
-          int nC = WM.n_chars[L][Wd]; // number of chars in this word
-          if (nC <= 0)
-            continue;
-
-          if (words_cnt >= words_cap) { // grow buffer if needed
-            words_cap *= 2;
-            char **tmp = (char **)realloc(words, sizeof(char *) * words_cap);
-            if (!tmp) {
-              fprintf(stderr, "realloc words OOM\n");
-              break;
-            }
-            words = tmp;
-          }
+  int k = 0; // tile of the next character (tiles follow reading order)
+  for (int L = 0; L < WM.n_lines; ++L) {
+    for (int Wd = 0; Wd < WM.n_words[L]; ++Wd) {
+      int nC = WM.n_chars[L][Wd]; // number of chars in this word
+      if (nC <= 0)
+        continue;
 
-          words[words_cnt] =
-              (char *)malloc((size_t)nC + 1); // allocate word string
-          for (int C = 0; C < nC; ++C) {
-            Uint8 *buf = WM.tiles[L][Wd][C]; // 28x28 tile for this character
-            if (!buf) {
-              words[words_cnt][C] = '?';
-              continue;
-            }
-            int idx[KTOP];
-            float logp[KTOP], prob[KTOP];
-            int kk = ocr_tile_topk(&net, buf, KTOP, idx, logp, prob);
-            (void)kk; // we only use the top1
-            words[words_cnt][C] =
-                (char)('A' + idx[0]); // best guess for this letter
-          }
-          words[words_cnt][nC] = '\0'; // null-terminate word
-          printf("WORD[%d,%d]: %s\n", L, Wd, words[words_cnt]);
-          words_cnt++;
+      char *word = (char *)malloc((size_t)nC + 1); // allocate word string
+      if (!word) {
+        fprintf(stderr, "OOM words\n");
+        free_word_matrix(&WM);
+        return -1;
+      }
+      for (int C = 0; C < nC; ++C, ++k) {
+        if (!tile_used(&WM.tiles, k)) {
+          word[C] = '?';
+          continue;
         }
+        const Uint8 *buf = tile_pixels(&WM.tiles, k); // 28x28 tile for this character
+        int idx[KTOP];
+        float logp[KTOP], prob[KTOP];
+        int kk = ocr_tile_topk(net, buf, KTOP, idx, logp, prob);
+        (void)kk;                      // we only use the top1
+        word[C] = (char)('A' + idx[0]); // best guess for this letter
+      }
+      word[nC] = '\0'; // null-terminate word
+
+      pz->words[pz->n_words] = word;
+      pz->word_line[pz->n_words] = L;
+      pz->word_rank[pz->n_words] = Wd;
+      pz->n_words++;
+    }
+  }
+
+  free_word_matrix(&WM); // free list data
+  return 0;
+}
+
+// Probabilistic matching of each word, exact search as a fallback
+static int solve_words(Puzzle *pz) {
+  pz->hits = (WordHit *)calloc((size_t)pz->n_words + 1, sizeof(WordHit));
+  if (!pz->hits)
+    return -1;
+
+  for (int wi = 0; wi < pz->n_words; ++wi) {
+    const char *Wstr = pz->words[wi]; // current word string
+    WordHit *hit = &pz->hits[wi];
+    if (!Wstr || !*Wstr)
+      continue;
+
+    int has_non_letter = 0;
+    for (const char *c = Wstr; *c; ++c) {
+      if (*c < 'A' || *c > 'Z') {
+        has_non_letter = 1;
+        break;
+      } // skip weird words
+    }
+
+    if (!has_non_letter) {
+      resolution_prob(pz->cells, pz->grid_mat, pz->N, pz->M, Wstr, hit->out,
+                      &hit->score); // probabilistic matching
+      if (hit->out[0] != -1) {
+        hit->found = 1;
+        continue;
       }
     }
+
+    resolution(pz->grid_mat, pz->N, pz->M, Wstr,
+               hit->out); // exact matching without probabilities
+    hit->found = hit->out[0] != -1 ? 2 : 0;
+  }
+  return 0;
+}
+
+// Worker part of a puzzle: letters, OCR and solving (nothing printed or
+// drawn, so regions can run side by side)
+static void read_puzzle(const Network *net, const GrayView *view,
+                        Puzzle *pz) {
+  SDL_Rect grid = pz->region.grid;
+  int rc = extract_letters_view(view, grid.x, grid.y, grid.x + grid.w - 1,
+                                grid.y + grid.h - 1,
+                                &pz->tiles); // segmentation of grid
+  pz->N = pz->tiles.rows;
+  pz->M = pz->tiles.cols;
+  if (rc != 0 || pz->tiles.count <= 0) {
+    fprintf(stderr, "extract_letters failed rc=%d\n", rc);
+    return;
   }
 
+  if (read_grid(net, pz) == 0 && read_words(net, view, pz) == 0 &&
+      solve_words(pz) == 0)
+    pz->ready = 1;
+}
+
+typedef struct {
+  const Network *net;   // shared, read-only during inference
+  const GrayView *view; // tiles are sampled through it
+  Puzzle *puzzles;
+} PuzzleJob;
+
+static void read_puzzle_band(void *ctx, int begin, int end, int band) {
+  (void)band;
+  PuzzleJob *job = (PuzzleJob *)ctx;
+  for (int i = begin; i < end; ++i)
+    read_puzzle(job->net, job->view, &job->puzzles[i]);
+}
+
+/* -------------------- Export grid + words to text file -------------------- */
+// One block per puzzle, in reading order: "rows cols", the grid, the words
+static int save_export_file(const char *path, const Puzzle *puzzles,
+                            int count) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror("fopen export");
+    return -1;
+  }
+
+  int rc = 0;
+  for (int p = 0; p < count && rc == 0; ++p) {
+    const Puzzle *pz = &puzzles[p];
+    if (pz->ready) // format shared with read_grid_blocks (solver.c)
+      rc = write_grid_block(f, pz->grid_mat, pz->N, pz->M, pz->words,
+                            pz->n_words);
+  }
+
+  if (fclose(f) != 0)
+    rc = -1;
+  return rc;
+}
+
+/* -------------------- Main pipeline -------------------- */
+SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
+  if (!surface || !render)
+    return surface; // safety guard
+
+  GrayImage *gray = gray_from_surface(surface); // luminance computed once
+  if (!gray) {
+    fprintf(stderr, "gray_from_surface: failed\n");
+    return surface;
+  }
+  pipeline_gray(gray, surface, render);
+  gray_free(gray);
+  return surface;
+}
+
+static void print_puzzle(const Puzzle *pz) {
+  SDL_Rect grid = pz->region.grid, list = pz->region.list;
+  printf("GRID:  (%d,%d) -> %dx%d\n", grid.x, grid.y, grid.w, grid.h);
+  printf("LIST:  (%d,%d) -> %dx%d\n", list.x, list.y, list.w, list.h);
+  if (!pz->ready)
+    return;
+  printf("Extracted %d rows and %d columns of letters.\n", pz->N, pz->M);
+
+  printf("\n===== GRID OCR (top1, after prior) =====\n");
+  for (int i = 0; i < pz->N; ++i) {
+    for (int j = 0; j < pz->M; ++j)
+      printf("%c ", pz->grid_mat[i][j]);
+    printf("\n");
+  }
+  printf("========================================\n");
+
+  if (pz->n_lines >= 0)
+    printf("LIST: %d lines\n", pz->n_lines);
+  for (int wi = 0; wi < pz->n_words; ++wi)
+    printf("WORD[%d,%d]: %s\n", pz->word_line[wi], pz->word_rank[wi],
+           pz->words[wi]);
+}
+
+// Outline of a found word, in surface pixels
+typedef struct {
+  int x1, y1, x2, y2;
+  int width;
+} WordPos;
+
+// Detection page -> surface pixels: undo the rotation of a virtually
+// deskewed page (annotations are drawn on the unrotated surface), then the
+// resolution normalization
+typedef struct {
+  const GrayView *view; // page = this view of the normalized plane
+  PageScale scale;      // normalized plane = surface * scale
+} PageMap;
+
+static int page_is_upright(const PageMap *map) {
+  return !map->view || rotate_view_is_identity(map->view);
+}
+
+static void map_point(const PageMap *map, double x, double y, int *ox,
+                      int *oy) {
+  if (!page_is_upright(map))
+    rotate_view_to_source(map->view, x, y, &x, &y); // back to the source
+  normalize_point_to_original(&x, &y, &map->scale);
+  *ox = (int)lround(x);
+  *oy = (int)lround(y);
+}
+
+// Outline of a page rectangle on the surface (a tilted quadrilateral when
+// the page is rotated)
+static void draw_region(SDL_Renderer *render, const PageMap *map,
+                        SDL_Rect r) {
+  if (page_is_upright(map)) {
+    SDL_Rect o = normalize_rect_to_original(r, &map->scale);
+    rectangle(render, o.x, o.y, o.x + o.w, o.y + o.h, 4, 2);
+    return;
+  }
+  int xs[4], ys[4]; // corners, clockwise from top-left
+  map_point(map, r.x, r.y, &xs[0], &ys[0]);
+  map_point(map, r.x + r.w, r.y, &xs[1], &ys[1]);
+  map_point(map, r.x + r.w, r.y + r.h, &xs[2], &ys[2]);
+  map_point(map, r.x, r.y + r.h, &xs[3], &ys[3]);
+  quadrilateral(render, xs, ys, 2);
+}
+
+// Centre of cell (c, r) of a grid split in steps of stepX x stepY, in
+// surface pixels
+static void cell_center(const PageMap *map, SDL_Rect grid, double stepX,
+                        double stepY, int c, int r, int *x, int *y) {
+  double xL = floor((double)c * stepX);
+  double xR = floor((double)(c + 1) * stepX) - 1.0;
+  double yT = floor((double)r * stepY);
+  double yB = floor((double)(r + 1) * stepY) - 1.0;
+
+  map_point(map, grid.x + 0.5 * (xL + xR), grid.y + 0.5 * (yT + yB), x,
+            y); // translate to image coordinates
+}
+
+// Grid / list rectangles and found words of one puzzle; word outlines are
+// appended to pos (if any) for result.png. Returns the number added.
+static int draw_puzzle(SDL_Renderer *render, const Puzzle *pz,
+                       const PageMap *map, WordPos *pos) {
+  SDL_Rect grid = pz->region.grid; // page pixels, mapped when drawn
+
   SDL_SetRenderDrawColor(render, 0, 255, 0, 255); // green rectangle for grid
-  rectangle(render, grid.x, grid.y, grid.x + grid.w, grid.y + grid.h, 4, 2);
+  draw_region(render, map, grid);
   SDL_SetRenderDrawColor(render, 0, 128, 255, 255); // blue rectangle for list
-  rectangle(render, list.x, list.y, list.x + list.w, list.y + list.h, 4, 2);
-
-  if (save_export_file("grid", out_N, out_M, grid_mat, words, words_cnt) == 0)
-    printf("Export written to file 'grid'\n");
+  draw_region(render, map, pz->region.list);
+  if (!pz->ready)
+    return 0;
 
   double stepX =
-      (out_M > 0) ? ((double)grid.w / (double)out_M) : 0.0; // width per cell
+      (pz->M > 0) ? ((double)grid.w / (double)pz->M) : 0.0; // width per cell
   double stepY =
-      (out_N > 0) ? ((double)grid.h / (double)out_N) : 0.0; // height per cell
+      (pz->N > 0) ? ((double)grid.h / (double)pz->N) : 0.0; // height per cell
   double base =
       (stepX < stepY) ? stepX : stepY; // use smallest dimension as reference
 
+  double zoom = 2.0 / (map->scale.sx + map->scale.sy); // page -> surface
   int outline_width =
-      (int)(0.90 * base); // approximate visual width of word box
+      (int)(0.90 * base * zoom); // approximate visual width of word box
   if (outline_width < 1)
     outline_width = 1;
   int outline_stroke = 2; // thickness of outline
 
-  // ====== PREPARE TO SAVE WORD POSITIONS ======
-  typedef struct {
-    int x1, y1, x2, y2;
-  } WordPos;
-  WordPos *word_positions = NULL;
-  int saved_words_count = 0;
-
-  if (words_cnt > 0) {
-    word_positions = (WordPos *)malloc(sizeof(WordPos) * words_cnt);
-    if (word_positions) {
-      for (int wi = 0; wi < words_cnt; ++wi) {
-        word_positions[wi].x1 = -1; // Mark as not found initially
-      }
-    }
-  }
-
   SDL_SetRenderDrawColor(render, 255, 0, 0,
                          255); // red outlines for found words
 
-  for (int wi = 0; wi < words_cnt; ++wi) {
-    const char *Wstr = words[wi]; // current word string
+  int saved = 0;
+  for (int wi = 0; wi < pz->n_words; ++wi) {
+    const char *Wstr = pz->words[wi]; // current word string
+    const WordHit *hit = &pz->hits[wi];
     if (!Wstr || !*Wstr)
       continue;
-
-    int L = (int)strlen(Wstr);
-    if (L <= 0)
+    if (!hit->found) {
+      printf("Not found: %s\n", Wstr); // word not found anywhere
       continue;
-
-    int has_non_letter = 0;
-    for (int k = 0; k < L; ++k) {
-      char c = Wstr[k];
-      if (c < 'A' || c > 'Z') {
-        has_non_letter = 1;
-        break;
-      } // skip weird words
     }
 
-    int out[4];
-    float sc = 0.f;
-    if (!has_non_letter)
-      resolution_prob(cells, grid_mat, out_N, out_M, Wstr, out,
-                      &sc); // probabilistic matching
-    else
-      out[0] = -1;
-
-    int x1 = -1, y1 = -1, x2 = -1, y2 = -1; // Word pixel coordinates
-
-    if (out[0] == -1) { // fallback to exact search if prob fails
-      int out2[4];
-      resolution(grid_mat, out_N, out_M, Wstr,
-                 out2); // exact matching without probabilities
-      if (out2[0] == -1) {
-        printf("Not found: %s\n", Wstr); // word not found anywhere
-        continue;
-      }
-
-      int c0 = out2[0], r0 = out2[1]; // start cell (col,row)
-      int c1 = out2[2], r1 = out2[3]; // end cell (col,row)
-
-      double x0L = floor((double)c0 * stepX);
-      double x0R = floor((double)(c0 + 1) * stepX) - 1.0;
-      double y0T = floor((double)r0 * stepY);
-      double y0B = floor((double)(r0 + 1) * stepY) - 1.0;
-
-      double x1L = floor((double)c1 * stepX);
-      double x1R = floor((double)(c1 + 1) * stepX) - 1.0;
-      double y1T = floor((double)r1 * stepY);
-      double y1B = floor((double)(r1 + 1) * stepY) - 1.0;
-
-      double cx0 = 0.5 * (x0L + x0R); // center of first cell
-      double cy0 = 0.5 * (y0T + y0B);
-      double cx1 = 0.5 * (x1L + x1R); // center of last cell
-      double cy1 = 0.5 * (y1T + y1B);
-
-      x1 = grid.x + (int)lround(cx0); // translate to image coordinates
-      y1 = grid.y + (int)lround(cy0);
-      x2 = grid.x + (int)lround(cx1);
-      y2 = grid.y + (int)lround(cy1);
-
-      draw_outline(render, x1, y1, x2, y2, outline_width,
-                   outline_stroke); // draw path rectangle
-      printf("Found exact (fallback): %s  (%d,%d)->(%d,%d)\n", Wstr, out2[0],
-             out2[1], out2[2], out2[3]);
+    const int *out = hit->out; // start cell (col,row), end cell (col,row)
+    WordPos tmp, *p = pos ? &pos[saved++] : &tmp;
+    cell_center(map, grid, stepX, stepY, out[0], out[1], &p->x1, &p->y1);
+    cell_center(map, grid, stepX, stepY, out[2], out[3], &p->x2, &p->y2);
+    p->width = outline_width;
+
+    draw_outline(render, p->x1, p->y1, p->x2, p->y2, outline_width,
+                 outline_stroke); // highlight matched word
+    if (hit->found == 2) {
+      printf("Found exact (fallback): %s  (%d,%d)->(%d,%d)\n", Wstr, out[0],
+             out[1], out[2], out[3]);
     } else {
-      int c0 = out[0], r0 = out[1]; // best match start cell
-      int c1 = out[2], r1 = out[3]; // best match end cell
-
-      double x0L = floor((double)c0 * stepX);
-      double x0R = floor((double)(c0 + 1) * stepX) - 1.0;
-      double y0T = floor((double)r0 * stepY);
-      double y0B = floor((double)(r0 + 1) * stepY) - 1.0;
-
-      double x1L = floor((double)c1 * stepX);
-      double x1R = floor((double)(c1 + 1) * stepX) - 1.0;
-      double y1T = floor((double)r1 * stepY);
-      double y1B = floor((double)(r1 + 1) * stepY) - 1.0;
-
-      double cx0 = 0.5 * (x0L + x0R); // center of first cell
-      double cy0 = 0.5 * (y0T + y0B);
-      double cx1 = 0.5 * (x1L + x1R); // center of last cell
-      double cy1 = 0.5 * (y1T + y1B);
-
-      x1 = grid.x + (int)lround(cx0); // translate to global coordinates
-      y1 = grid.y + (int)lround(cy0);
-      x2 = grid.x + (int)lround(cx1);
-      y2 = grid.y + (int)lround(cy1);
-
-      draw_outline(render, x1, y1, x2, y2, outline_width,
-                   outline_stroke); // highlight matched word
-
-      float mean_log = sc / (float)L; // average log-score per letter
+      float mean_log =
+          hit->score / (float)strlen(Wstr); // average log-score per letter
       printf("Found prob (matches/prefix first): %s  (%d,%d)->(%d,%d)  "
              "score=%.3f  mean=%.3f\n",
-             Wstr, out[0], out[1], out[2], out[3], sc, mean_log);
+             Wstr, out[0], out[1], out[2], out[3], hit->score, mean_log);
     }
+  }
+  return saved;
+}
 
-    // Save word position for redrawing in result.png
-    if (word_positions && x1 != -1) {
-      word_positions[saved_words_count].x1 = x1;
-      word_positions[saved_words_count].y1 = y1;
-      word_positions[saved_words_count].x2 = x2;
-      word_positions[saved_words_count].y2 = y2;
-      saved_words_count++;
+// Rectangle of a plane reduced by scale, back on the full w x h page
+static SDL_Rect unscale_rect(SDL_Rect r, double scale, int w, int h) {
+  if (r.w <= 0 || r.h <= 0)
+    return r; // empty (no list)
+  int x1 = (int)floor(r.x / scale), y1 = (int)floor(r.y / scale);
+  int x2 = (int)ceil((r.x + r.w) / scale), y2 = (int)ceil((r.y + r.h) / scale);
+  if (x2 > w)
+    x2 = w;
+  if (y2 > h)
+    y2 = h;
+  return (SDL_Rect){x1, y1, x2 - x1, y2 - y1};
+}
+
+// Detection on `page` (the page seen through `view`, reduced by
+// page_scale <= 1; cc its components if already labeled, else NULL), OCR on
+// tiles sampled through `view` and rendering; map brings their coordinates
+// back to the surface. Each puzzle of the page is read and solved on its
+// own worker thread.
+static SDL_Surface *pipeline_run(const GrayImage *page, const ComponentList *cc,
+                                 double page_scale, const GrayView *view,
+                                 const PageMap *map, SDL_Surface *surface,
+                                 SDL_Renderer *render) {
+
+  PuzzleRegion *regions = NULL; // one grid / list pair per puzzle
+  int n_puzzles = 0;
+  if (detect_puzzles_gray(page, cc, &regions, &n_puzzles) != 0) {
+    fprintf(stderr, "detect_grid_and_list: failed\n");
+    return surface;
+  }
+  if (page_scale < 1.0) {
+    int w = view->w, h = view->h;
+    for (int p = 0; p < n_puzzles; ++p) { // back to view coordinates
+      regions[p].area = unscale_rect(regions[p].area, page_scale, w, h);
+      regions[p].grid = unscale_rect(regions[p].grid, page_scale, w, h);
+      regions[p].list = unscale_rect(regions[p].list, page_scale, w, h);
     }
   }
+  if (n_puzzles > 1)
+    printf("%d puzzles on the page\n", n_puzzles);
+
+  Network net;                              // CNN weights, shared by workers
+  init_network(&net);                       // initialize / zero / boosters
+  if (load_model("model.bin", &net) != 0) { // load trained model
+    fprintf(stderr, "load_model: failed\n");
+    free(regions);
+    return surface;
+  }
+
+  Puzzle *puzzles = (Puzzle *)calloc((size_t)n_puzzles, sizeof(Puzzle));
+  if (!puzzles) {
+    fprintf(stderr, "OOM puzzles\n");
+    free(regions);
+    return surface;
+  }
+  for (int p = 0; p < n_puzzles; ++p)
+    puzzles[p].region = regions[p];
+  free(regions);
+
+  PuzzleJob job = {&net, view, puzzles};
+  parallel_for(n_puzzles, 1, read_puzzle_band, &job); // one puzzle per band
+
+  int max_words = 0;
+  for (int p = 0; p < n_puzzles; ++p)
+    max_words += puzzles[p].n_words;
+  WordPos *word_positions = (WordPos *)malloc(
+      sizeof(WordPos) * ((size_t)max_words + 1)); // for redrawing in result.png
+  int saved_words_count = 0;
 
-  if (out_matrix && out_matrix[0] && out_matrix[0][0]) {
-    Uint8 *buf = out_matrix[0][0]; // take first tile as sample
+  for (int p = 0; p < n_puzzles; ++p) {
+    if (n_puzzles > 1)
+      printf("\n===== PUZZLE %d / %d =====\n", p + 1, n_puzzles);
+    print_puzzle(&puzzles[p]);
+    saved_words_count += draw_puzzle(
+        render, &puzzles[p], map,
+        word_positions ? word_positions + saved_words_count : NULL);
+  }
+
+  if (save_export_file("grid", puzzles, n_puzzles) == 0)
+    printf("Export written to file 'grid'\n");
+
+  for (int p = 0; p < n_puzzles; ++p) {
+    TileBatch *tiles = &puzzles[p].tiles;
+    if (!puzzles[p].ready || !tile_used(tiles, 0))
+      continue;
+    Uint8 *buf = tile_pixels(tiles, 0); // take first tile as sample
     for (int y = 0; y < 28; ++y)
       for (int x = 0; x < 28; ++x)
         if (!(x > 3 && x < 24 && y > 3 && y < 24)) // leave inner region intact
           buf[y * 28 + x] = 255; // make border white (debug framing)
     if (save_buf784_bmp(buf, "tile_debug.bmp") == 0)
       printf("Tile saved: tile_debug.bmp\n");
+    break;
   }
 
-  free_word_matrix(&WM); // free list (right side) data
-  if (words) {
-    for (int i = 0; i < words_cnt; ++i)
-      free(words[i]);
-    free(words);
-  }
-  free_out_matrix(out_matrix, out_N, out_M); // free grid tiles
-  free(cells);                               // free solver cells
-  for (int i = 0; i < out_N; ++i)
-    free(grid_mat[i]); // free grid rows
-  free(grid_mat);
-
   // ====== SAVE ANNOTATED IMAGE TO result.png ======
   // Create a temporary window and renderer with the same size as the surface
   SDL_Window *temp_window =
@@ -961,27 +1109,27 @@ SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
         SDL_RenderClear(temp_renderer);
         SDL_RenderCopy(temp_renderer, temp_texture, NULL, NULL);
 
-        // Redraw all the annotations
-        // Green rectangle for grid
-        SDL_SetRenderDrawColor(temp_renderer, 0, 255, 0, 255);
-        rectangle(temp_renderer, grid.x, grid.y, grid.x + grid.w,
-                  grid.y + grid.h, 4, 2);
-
-        // Blue rectangle for list (if exists)
-        if (list.w > 0 && list.h > 0) {
-          SDL_SetRenderDrawColor(temp_renderer, 0, 128, 255, 255);
-          rectangle(temp_renderer, list.x, list.y, list.x + list.w,
-                    list.y + list.h, 4, 2);
+        // Redraw all the annotations, puzzle by puzzle
+        for (int p = 0; p < n_puzzles; ++p) {
+          SDL_Rect list = puzzles[p].region.list;
+
+          // Green rectangle for grid
+          SDL_SetRenderDrawColor(temp_renderer, 0, 255, 0, 255);
+          draw_region(temp_renderer, map, puzzles[p].region.grid);
+
+          // Blue rectangle for list (if exists)
+          if (list.w > 0 && list.h > 0) {
+            SDL_SetRenderDrawColor(temp_renderer, 0, 128, 255, 255);
+            draw_region(temp_renderer, map, list);
+          }
         }
 
         // Red outlines for found words
         SDL_SetRenderDrawColor(temp_renderer, 255, 0, 0, 255);
         for (int i = 0; i < saved_words_count; i++) {
-          if (word_positions[i].x1 != -1) {
-            draw_outline(temp_renderer, word_positions[i].x1,
-                         word_positions[i].y1, word_positions[i].x2,
-                         word_positions[i].y2, outline_width, outline_stroke);
-          }
+          draw_outline(temp_renderer, word_positions[i].x1,
+                       word_positions[i].y1, word_positions[i].x2,
+                       word_positions[i].y2, word_positions[i].width, 2);
         }
 
         SDL_RenderPresent(temp_renderer);
@@ -1008,10 +1156,80 @@ SDL_Surface *pipeline(SDL_Surface *surface, SDL_Renderer *render) {
     SDL_DestroyWindow(temp_window);
   }
 
-  // Clean up word positions
-  if (word_positions) {
-    free(word_positions);
-  }
+  // Clean up word positions and puzzles
+  free(word_positions);
+  for (int p = 0; p < n_puzzles; ++p)
+    free_puzzle(&puzzles[p]);
+  free(puzzles);
 
   return surface; // surface is modified in-place
-}
\ No newline at end of file
+}
+
+SDL_Surface *pipeline_gray(const GrayImage *gray, SDL_Surface *surface,
+                           SDL_Renderer *render) {
+  if (!gray || !surface || !render)
+    return surface; // safety guard
+
+  PageMap map = {NULL, {1.0, 1.0}}; // upright page
+  GrayImage *norm = normalize_resolution(gray, &map.scale); // NULL: as is
+  if (norm)
+    printf("Normalized %dx%d -> %dx%d (glyphs ~%d px)\n", gray->w, gray->h,
+           norm->w, norm->h, NORMALIZE_TARGET_HEIGHT);
+
+  const GrayImage *page = norm ? norm : gray;
+  GrayView view;
+  rotate_view_init(&view, page, 0.0, ROTATE_NEAREST, 0); // tiles read in place
+  pipeline_run(page, NULL, 1.0, &view, &map, surface, render);
+  gray_free(norm);
+  return surface;
+}
+
+SDL_Surface *pipeline_view(const GrayView *view, const ComponentList *cc,
+                           SDL_Surface *surface, SDL_Renderer *render) {
+  if (!view || !view->src || !surface || !render)
+    return surface; // safety guard
+  if (surface->w != view->src->w || surface->h != view->src->h) {
+    fprintf(stderr, "pipeline_view: surface and source sizes differ\n");
+    return surface;
+  }
+
+  // Normalize the unrotated source once; the tiles are sampled from it
+  // through the rotation
+  PageMap map = {NULL, {1.0, 1.0}};
+  GrayImage *nsrc = normalize_resolution(view->src, &map.scale); // NULL: as is
+  const GrayImage *src = nsrc ? nsrc : view->src;
+  if (nsrc)
+    printf("Normalized %dx%d -> %dx%d (glyphs ~%d px)\n", view->src->w,
+           view->src->h, nsrc->w, nsrc->h, NORMALIZE_TARGET_HEIGHT);
+
+  GrayView nview;
+  rotate_view_init(&nview, src, view->angle, view->filter, view->expand);
+  map.view = &nview;
+
+  if (rotate_view_is_identity(&nview)) { // upright: detection reads src
+    // The caller's labeling of view->src is reused unless src was rescaled
+    pipeline_run(src, nsrc ? NULL : cc, 1.0, &nview, &map, surface, render);
+    gray_free(nsrc);
+    return surface;
+  }
+
+  // Grid and list are located on an analysis copy of the rotated page,
+  // reduced so its glyphs are about DETECT_GLYPH_HEIGHT px tall: the
+  // detection only needs the grid lines and text blocks, and the full size
+  // rotated page is never built. Their rectangles are scaled back to the
+  // rotated page before the tiles are read through nview.
+  int glyph = nsrc ? NORMALIZE_TARGET_HEIGHT : estimate_glyph_height(src);
+  double scale =
+      glyph > DETECT_GLYPH_HEIGHT ? (double)DETECT_GLYPH_HEIGHT / glyph : 1.0;
+  GrayImage *page = rotate_view_scaled(&nview, scale);
+  if (!page) {
+    fprintf(stderr, "pipeline_view: analysis page failed\n");
+    gray_free(nsrc);
+    return surface;
+  }
+
+  pipeline_run(page, NULL, scale, &nview, &map, surface, render);
+  gray_free(page);
+  gray_free(nsrc);
+  return surface;
+}
@@ -9,7 +9,25 @@
 #include "../neural_network/nn.h"
 #include "../neural_network/digitalisation.h"
 #include "../letter_extractor/letter_extractor.h"
+#include "../gray_image/gray_image.h"
+#include "../rotation/rotation.h"
 
 SDL_Surface* pipeline(SDL_Surface* surface, SDL_Renderer* render);
 
+/* Same pipeline on an already computed luminance plane of `surface`
+ * (surface is only used to render the annotated result). */
+SDL_Surface* pipeline_gray(const GrayImage* gray, SDL_Surface* surface,
+                           SDL_Renderer* render);
+
+/* Same pipeline on a deskewed page kept virtual: view->src is the
+ * unrotated luminance plane of `surface`. The source is normalized once,
+ * grid and list are located on a reduced rotated rendition (glyphs about
+ * DETECT_GLYPH_HEIGHT px, no full size rotated page), and the letter tiles
+ * are sampled once from the source through the rotation. The annotations
+ * are drawn on the unrotated surface. cc (or NULL) holds the components of
+ * view->src already labeled by the caller (e.g. for the deskew); detection
+ * reuses them when it reads view->src itself (upright page, not rescaled). */
+SDL_Surface* pipeline_view(const GrayView* view, const ComponentList* cc,
+                           SDL_Surface* surface, SDL_Renderer* render);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+// projection.c
+#include "projection.h"
+
+#include <stdio.h>      // fprintf
+#include <stdlib.h>     // malloc, calloc, free
+
+InkProfile *ink_profile_create(const Uint8 *data, int w, int h, int stride, int thr)
+{
+    if (!data || w <= 0 || h <= 0) return NULL;
+
+    InkProfile *p = calloc(1, sizeof(InkProfile));
+    if (!p) return NULL;
+    p->w = w;
+    p->h = h;
+    p->thr = thr;
+    p->sat_stride = w + 1;
+    p->row = malloc((size_t)h * sizeof(int));
+    p->col = malloc((size_t)w * sizeof(int));
+    p->sat = malloc((size_t)(w + 1) * (size_t)(h + 1) * sizeof(int));
+    if (!p->row || !p->col || !p->sat) {
+        fprintf(stderr, "ink_profile_create: out of memory\n");
+        ink_profile_free(p);
+        return NULL;
+    }
+
+    // Row 0 and column 0 of the table are empty areas
+    int sw = w + 1;
+    for (int x = 0; x <= w; ++x) p->sat[x] = 0;
+
+    for (int y = 0; y < h; ++y) {
+        const Uint8 *src = data + (size_t)y * (size_t)stride;
+        const int *above = p->sat + (size_t)y * sw;
+        int *cur = p->sat + (size_t)(y + 1) * sw;
+
+        int run = 0;   // ink of [0, x] on this row
+        cur[0] = 0;
+        for (int x = 0; x < w; ++x) {
+            run += src[x] < thr;
+            cur[x + 1] = above[x + 1] + run;
+        }
+        p->row[y] = run;
+    }
+
+    // Columns are differences of the last table row
+    const int *last = p->sat + (size_t)h * sw;
+    for (int x = 0; x < w; ++x) p->col[x] = last[x + 1] - last[x];
+    return p;
+}
+
+InkProfile *ink_profile_gray(const GrayImage *img, int thr)
+{
+    if (!img) return NULL;
+    return ink_profile_create(img->data, img->w, img->h, img->stride, thr);
+}
+
+InkProfile ink_profile_sub(const InkProfile *p, int x, int y, int w, int h)
+{
+    // [x, x + w) x [y, y + h) counts are differences of the parent's
+    // table: the corner (x, y) of the parent is the sub view's origin
+    InkProfile sub = *p;
+    sub.w = w;
+    sub.h = h;
+    sub.row = NULL;
+    sub.col = NULL;
+    sub.sat = p->sat + (size_t)y * (size_t)p->sat_stride + (size_t)x;
+    return sub;
+}
+
+void ink_profile_free(InkProfile *p)
+{
+    if (!p) return;
+    free(p->row);
+    free(p->col);
+    free(p->sat);
+    free(p);
+}
@@ -0,0 +1,51 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <SDL2/SDL.h>
+#include "../gray_image/gray_image.h"
+
+/* Ink counts of a plane, built in one row-major pass. A pixel is ink when
+ * its value is < thr.
+ *  - row[y] : ink pixels of row y            (h entries)
+ *  - col[x] : ink pixels of column x         (w entries)
+ *  - sat    : summed-area table, (w + 1) x (h + 1) entries, rows
+ *             sat_stride apart (w + 1 unless the profile is a sub view),
+ *             sat[y * sat_stride + x] = ink pixels of [0, x) x [0, y)
+ * Any rectangle is then counted in O(1) with ink_rect. */
+typedef struct {
+    int  w, h;
+    int  thr;
+    int *row;
+    int *col;
+    int *sat;
+    int  sat_stride;
+} InkProfile;
+
+/* Profile of a w x h plane whose rows are stride bytes apart.
+ * Each consumer builds the profile of its own plane and threshold (page
+ * at 128, grid ROI at its Otsu level, binarized list); parts of a plane
+ * share its profile through ink_profile_sub. Returns NULL on error. */
+InkProfile *ink_profile_create(const Uint8 *data, int w, int h, int stride, int thr);
+
+/* Profile of a whole GrayImage. Returns NULL on error. */
+InkProfile *ink_profile_gray(const GrayImage *img, int thr);
+
+void ink_profile_free(InkProfile *p);
+
+/* The w x h rectangle at (x, y) of p (inside p) as a profile of its own,
+ * sharing p's table: a sub-plane needs no second table. Only ink_rect may
+ * be used on it (row and col are NULL); it is valid while p is, and is
+ * not freed. */
+InkProfile ink_profile_sub(const InkProfile *p, int x, int y, int w, int h);
+
+/* Ink pixels of [x0, x1] x [y0, y1] (inclusive, inside the plane; 0 when
+ * the rectangle is empty). */
+static inline int ink_rect(const InkProfile *p, int x0, int y0, int x1, int y1)
+{
+    if (x1 < x0 || y1 < y0) return 0;
+    const int *top = p->sat + (size_t)y0 * (size_t)p->sat_stride;
+    const int *bot = p->sat + (size_t)(y1 + 1) * (size_t)p->sat_stride;
+    return bot[x1 + 1] - bot[x0] - top[x1 + 1] + top[x0];
+}
+
+#endif
@@ -1,9 +1,11 @@
 // rotation.c
 #include "rotation.h"
+#include "../thread_pool/thread_pool.h"
 
 #include <stdio.h>      // fprintf
-#include <math.h>       // cos, sin, hypot, lrint
-#include <stdlib.h>     // malloc, calloc, free
+#include <math.h>       // cos, sin, hypot, lrint, llrint
+#include <stdlib.h>     // malloc, realloc, free
+#include <string.h>     // memset
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -12,21 +14,268 @@
 #define DEG2RAD(a) ((a) * (M_PI / 180.0))
 
 /* ---------------------------------------------------------------------------
- * rotate
- *  Simple nearest-neighbor rotation around the image center.
- *  - surface: input image (not modified)
- *  - angle  : rotation angle in degrees (positive = counter-clockwise)
- *  Returns a new SDL_Surface with the same size as input.
+ * Settings used by rotate() / rotate_gray()
  * -------------------------------------------------------------------------- */
-SDL_Surface *rotate(SDL_Surface *surface, double angle) {
+
+static RotateFilter rotate_filter = ROTATE_BILINEAR;
+static int rotate_expand = 0;
+
+void set_rotate_filter(RotateFilter filter) {
+    rotate_filter = filter;
+}
+
+RotateFilter get_rotate_filter(void) {
+    return rotate_filter;
+}
+
+const char *rotate_filter_name(RotateFilter filter) {
+    switch (filter) {
+    case ROTATE_NEAREST:  return "nearest";
+    case ROTATE_BILINEAR: return "bilinear";
+    case ROTATE_SHEAR:    return "shear";
+    }
+    return "?";
+}
+
+void set_rotate_expand(int expand) {
+    rotate_expand = expand != 0;
+}
+
+int get_rotate_expand(void) {
+    return rotate_expand;
+}
+
+/* ---------------------------------------------------------------------------
+ * Fixed-point row mapping
+ *
+ *  Destination pixel (x, y) maps back to the source point
+ *      u = c * (x - dcx) + s * (y - dcy) + cx
+ *      v = -s * (x - dcx) + c * (y - dcy) + cy
+ *  Along a row both are affine in x, so they are kept in 16.16 fixed point
+ *  and advanced by a constant step. Since U(x) = U0 + x * dU exactly, the
+ *  span of x where (U, V) stays inside a box is solved per row with integer
+ *  arithmetic; the inner loops then run without any bounds check.
+ * -------------------------------------------------------------------------- */
+
+#define FIX_SHIFT 16
+#define FIX_ONE   (1 << FIX_SHIFT)
+
+// Rows handed to one thread at a time
+#define ROTATE_MIN_ROWS 16
+
+typedef struct {
+    int sw, sh;             // source size
+    int dw, dh;             // destination size
+    double c, s;            // cos / sin of the angle
+    double cx, cy;          // rotation center in the source
+    double dcx, dcy;        // rotation center in the destination
+    long long du, dv;       // 16.16 steps along a destination row
+} RotateMap;
+
+void rotate_output_size(int w, int h, double angle, int expand, int *dw, int *dh)
+{
+    if (!expand) {
+        *dw = w;
+        *dh = h;
+        return;
+    }
+
+    // Bounding box of the rotated page, so no corner is cut
+    double rad = DEG2RAD(angle);
+    double c = fabs(cos(rad)), s = fabs(sin(rad));
+    *dw = (int)ceil(w * c + h * s - 1e-9);
+    *dh = (int)ceil(w * s + h * c - 1e-9);
+    if (*dw < 1) *dw = 1;
+    if (*dh < 1) *dh = 1;
+}
+
+static void rotate_map_init(RotateMap *m, int w, int h, double angle, int expand)
+{
+    double rad = DEG2RAD(angle);
+    m->c = cos(rad);
+    m->s = sin(rad);
+    m->sw = w;
+    m->sh = h;
+    m->cx = w / 2;
+    m->cy = h / 2;
+
+    rotate_output_size(w, h, angle, expand, &m->dw, &m->dh);
+    m->dcx = m->dw / 2;
+    m->dcy = m->dh / 2;
+
+    m->du = llrint(m->c * FIX_ONE);
+    m->dv = llrint(-m->s * FIX_ONE);
+}
+
+/* 16.16 source point of destination pixel (0, y). */
+static void rotate_map_row(const RotateMap *m, int y, long long *u0, long long *v0)
+{
+    double xr = -m->dcx, yr = y - m->dcy;
+    *u0 = llrint(( m->c * xr + m->s * yr + m->cx) * FIX_ONE);
+    *v0 = llrint((-m->s * xr + m->c * yr + m->cy) * FIX_ONE);
+}
+
+static long long floor_div(long long a, long long b)
+{
+    long long q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) q--;
+    return q;
+}
+
+static long long ceil_div(long long a, long long b)
+{
+    return -floor_div(-a, b);
+}
+
+/* Narrow [*x0, *x1] to the x where lo <= p0 + x * dp <= hi. */
+static void clip_axis(long long p0, long long dp, long long lo, long long hi,
+                      int *x0, int *x1)
+{
+    long long a, b;
+    if (dp == 0) {
+        if (p0 < lo || p0 > hi) *x1 = *x0 - 1;
+        return;
+    }
+    if (dp > 0) {
+        a = ceil_div(lo - p0, dp);
+        b = floor_div(hi - p0, dp);
+    } else {
+        a = ceil_div(hi - p0, dp);
+        b = floor_div(lo - p0, dp);
+    }
+    if (a > *x0) *x0 = (int)(a < *x1 + 1LL ? a : *x1 + 1LL);
+    if (b < *x1) *x1 = (int)(b > *x0 - 1LL ? b : *x0 - 1LL);
+}
+
+/* Span of a row of width w whose source point lies in [ulo, uhi] x [vlo, vhi]. */
+static void row_span(const RotateMap *m, int w, long long u0, long long v0,
+                     long long ulo, long long uhi, long long vlo, long long vhi,
+                     int *x0, int *x1)
+{
+    *x0 = 0;
+    *x1 = w - 1;
+    clip_axis(u0, m->du, ulo, uhi, x0, x1);
+    clip_axis(v0, m->dv, vlo, vhi, x0, x1);
+}
+
+/* ---------------------------------------------------------------------------
+ * Samplers
+ * -------------------------------------------------------------------------- */
+
+/* Interpolate two 0x00XX00XX channel pairs, f in [0, 256]. */
+static inline Uint32 lerp_pairs(Uint32 a, Uint32 b, Uint32 f)
+{
+    return ((a * (256 - f) + b * f) >> 8) & 0x00FF00FF;
+}
+
+static inline Uint32 lerp_argb(Uint32 a, Uint32 b, Uint32 f)
+{
+    return lerp_pairs(a & 0x00FF00FF, b & 0x00FF00FF, f)
+         | (lerp_pairs((a >> 8) & 0x00FF00FF, (b >> 8) & 0x00FF00FF, f) << 8);
+}
+
+static inline Uint32 bilinear_argb(Uint32 p00, Uint32 p01, Uint32 p10,
+                                   Uint32 p11, Uint32 fx, Uint32 fy)
+{
+    return lerp_argb(lerp_argb(p00, p01, fx), lerp_argb(p10, p11, fx), fy);
+}
+
+static inline Uint8 bilinear_gray(Uint32 p00, Uint32 p01, Uint32 p10,
+                                  Uint32 p11, Uint32 fx, Uint32 fy)
+{
+    Uint32 top = p00 * (256 - fx) + p01 * fx;
+    Uint32 bot = p10 * (256 - fx) + p11 * fx;
+    return (Uint8)((top * (256 - fy) + bot * fy + 32768) >> 16);
+}
+
+/* ---------------------------------------------------------------------------
+ * Surface rotation (32 bpp)
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const RotateMap *map;
+    RotateFilter filter;
+    const Uint32 *src;
+    int src_pitch;          // in pixels
+    Uint32 *dst;
+    int dst_pitch;
+} SurfaceJob;
+
+static inline Uint32 surface_tap(const SurfaceJob *job, int x, int y)
+{
+    if ((unsigned)x >= (unsigned)job->map->sw || (unsigned)y >= (unsigned)job->map->sh)
+        return 0;   // fully transparent black
+    return job->src[(size_t)y * job->src_pitch + x];
+}
+
+static Uint32 surface_bilinear_clamped(const SurfaceJob *job, long long u, long long v)
+{
+    int x = (int)(u >> FIX_SHIFT), y = (int)(v >> FIX_SHIFT);
+    Uint32 fx = (Uint32)(u >> 8) & 0xFF, fy = (Uint32)(v >> 8) & 0xFF;
+    return bilinear_argb(surface_tap(job, x, y), surface_tap(job, x + 1, y),
+                         surface_tap(job, x, y + 1), surface_tap(job, x + 1, y + 1),
+                         fx, fy);
+}
+
+static void surface_band(void *arg, int y0, int y1, int band)
+{
+    SurfaceJob *job = arg;
+    const RotateMap *m = job->map;
+    long long du = m->du, dv = m->dv;
+    long long wl = (long long)m->sw << FIX_SHIFT, hl = (long long)m->sh << FIX_SHIFT;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        Uint32 *dst = job->dst + (size_t)y * job->dst_pitch;  // zeroed by SDL
+        long long u0, v0;
+        rotate_map_row(m, y, &u0, &v0);
+
+        if (job->filter == ROTATE_NEAREST) {
+            int x0, x1;
+            row_span(m, m->dw, u0, v0, 0, wl - 1, 0, hl - 1, &x0, &x1);
+            long long u = u0 + x0 * du, v = v0 + x0 * dv;
+            for (int x = x0; x <= x1; ++x, u += du, v += dv)
+                dst[x] = job->src[(size_t)(v >> FIX_SHIFT) * job->src_pitch
+                                  + (size_t)(u >> FIX_SHIFT)];
+            continue;
+        }
+
+        // Pixels with at least one tap inside, then the ones with all four
+        int e0, e1, i0, i1;
+        row_span(m, m->dw, u0, v0, 1 - FIX_ONE, wl - 1, 1 - FIX_ONE, hl - 1, &e0, &e1);
+        row_span(m, m->dw, u0, v0, 0, wl - FIX_ONE - 1, 0, hl - FIX_ONE - 1, &i0, &i1);
+        if (i0 > i1) i0 = i1 = e1 + 1;  // no interior: all clamped
+
+        long long u = u0 + e0 * du, v = v0 + e0 * dv;
+        int x = e0;
+        for (; x < i0 && x <= e1; ++x, u += du, v += dv)
+            dst[x] = surface_bilinear_clamped(job, u, v);
+        for (; x <= i1 && x <= e1; ++x, u += du, v += dv) {
+            const Uint32 *p = job->src + (size_t)(v >> FIX_SHIFT) * job->src_pitch
+                                       + (size_t)(u >> FIX_SHIFT);
+            dst[x] = bilinear_argb(p[0], p[1], p[job->src_pitch], p[job->src_pitch + 1],
+                                   (Uint32)(u >> 8) & 0xFF, (Uint32)(v >> 8) & 0xFF);
+        }
+        for (; x <= e1; ++x, u += du, v += dv)
+            dst[x] = surface_bilinear_clamped(job, u, v);
+    }
+}
+
+SDL_Surface *rotate_ex(SDL_Surface *surface, double angle, RotateFilter filter,
+                       int expand) {
     if (!surface) return NULL;
+    if (surface->format->BytesPerPixel != 4) {
+        fprintf(stderr, "rotate: need a 32 bpp surface\n");
+        return NULL;
+    }
+    if (filter == ROTATE_SHEAR) return rotate_shear(surface, angle, expand);
 
-    double rad = DEG2RAD(angle);           // convert angle to radians
-    int w = surface->w, h = surface->h;
+    RotateMap map;
+    rotate_map_init(&map, surface->w, surface->h, angle, expand);
 
-    // Create target surface with same format and size
+    // Create target surface with same format
     SDL_Surface *rotated = SDL_CreateRGBSurface(
-        0, w, h,
+        0, map.dw, map.dh,
         surface->format->BitsPerPixel,
         surface->format->Rmask,
         surface->format->Gmask,
@@ -38,216 +287,612 @@ SDL_Surface *rotate(SDL_Surface *surface, double angle) {
         return NULL;
     }
 
-    int cx = w / 2;                         // rotation center x
-    int cy = h / 2;                         // rotation center y
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    SurfaceJob job = {
+        &map, filter,
+        (const Uint32*)surface->pixels, surface->pitch / 4,
+        (Uint32*)rotated->pixels, rotated->pitch / 4
+    };
+    parallel_for(map.dh, ROTATE_MIN_ROWS, surface_band, &job);
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
 
-    Uint32 *src = (Uint32*)surface->pixels;
-    Uint32 *dst = (Uint32*)rotated->pixels;
-    int src_pitch = surface->pitch / 4;     // pixels per row in src
-    int dst_pitch = rotated->pitch / 4;     // pixels per row in dst
+    return rotated;
+}
 
-    double c = cos(rad), s = sin(rad);      // precompute trig
+SDL_Surface *rotate(SDL_Surface *surface, double angle) {
+    return rotate_ex(surface, angle, rotate_filter, rotate_expand);
+}
 
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            int xr = x - cx;                // coords relative to center
-            int yr = y - cy;
-
-            // Backward mapping: dest -> source
-            int xs = (int)( c * xr + s * yr + cx );
-            int ys = (int)(-s * xr + c * yr + cy );
-
-            // If source coords inside image, copy pixel, else put black
-            if (xs >= 0 && xs < w && ys >= 0 && ys < h)
-                dst[y * dst_pitch + x] = src[ys * src_pitch + xs];
-            else
-                dst[y * dst_pitch + x] = 0; // ARGB = fully transparent black
+/* ---------------------------------------------------------------------------
+ * Luminance plane rotation (uncovered pixels are white)
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const RotateMap *map;
+    RotateFilter filter;
+    const GrayImage *src;
+    GrayImage *dst;
+    int ox, oy;             // dst (0, 0) is pixel (ox, oy) of the rotated page
+} GrayJob;
+
+static inline Uint32 gray_tap(const GrayImage *img, int x, int y)
+{
+    if ((unsigned)x >= (unsigned)img->w || (unsigned)y >= (unsigned)img->h)
+        return 255;
+    return gray_row(img, y)[x];
+}
+
+static Uint8 gray_bilinear_clamped(const GrayImage *img, long long u, long long v)
+{
+    int x = (int)(u >> FIX_SHIFT), y = (int)(v >> FIX_SHIFT);
+    Uint32 fx = (Uint32)(u >> 8) & 0xFF, fy = (Uint32)(v >> 8) & 0xFF;
+    return bilinear_gray(gray_tap(img, x, y), gray_tap(img, x + 1, y),
+                         gray_tap(img, x, y + 1), gray_tap(img, x + 1, y + 1),
+                         fx, fy);
+}
+
+static void gray_band(void *arg, int y0, int y1, int band)
+{
+    GrayJob *job = arg;
+    const RotateMap *m = job->map;
+    const GrayImage *src = job->src;
+    const Uint8 *base = src->data;
+    size_t stride = (size_t)src->stride;
+    long long du = m->du, dv = m->dv;
+    long long wl = (long long)m->sw << FIX_SHIFT, hl = (long long)m->sh << FIX_SHIFT;
+    (void)band;
+
+    int w = job->dst->w;
+
+    for (int y = y0; y < y1; ++y) {
+        Uint8 *dst = gray_row(job->dst, y);   // already white
+        long long u0, v0;
+        rotate_map_row(m, y + job->oy, &u0, &v0);
+        u0 += job->ox * du;
+        v0 += job->ox * dv;
+
+        if (job->filter != ROTATE_BILINEAR) {
+            int x0, x1;
+            row_span(m, w, u0, v0, 0, wl - 1, 0, hl - 1, &x0, &x1);
+            long long u = u0 + x0 * du, v = v0 + x0 * dv;
+            for (int x = x0; x <= x1; ++x, u += du, v += dv)
+                dst[x] = base[(size_t)(v >> FIX_SHIFT) * stride + (size_t)(u >> FIX_SHIFT)];
+            continue;
+        }
+
+        int e0, e1, i0, i1;
+        row_span(m, w, u0, v0, 1 - FIX_ONE, wl - 1, 1 - FIX_ONE, hl - 1, &e0, &e1);
+        row_span(m, w, u0, v0, 0, wl - FIX_ONE - 1, 0, hl - FIX_ONE - 1, &i0, &i1);
+        if (i0 > i1) i0 = i1 = e1 + 1;
+
+        long long u = u0 + e0 * du, v = v0 + e0 * dv;
+        int x = e0;
+        for (; x < i0 && x <= e1; ++x, u += du, v += dv)
+            dst[x] = gray_bilinear_clamped(src, u, v);
+        for (; x <= i1 && x <= e1; ++x, u += du, v += dv) {
+            const Uint8 *p = base + (size_t)(v >> FIX_SHIFT) * stride
+                                  + (size_t)(u >> FIX_SHIFT);
+            dst[x] = bilinear_gray(p[0], p[1], p[stride], p[stride + 1],
+                                   (Uint32)(u >> 8) & 0xFF, (Uint32)(v >> 8) & 0xFF);
         }
+        for (; x <= e1; ++x, u += du, v += dv)
+            dst[x] = gray_bilinear_clamped(src, u, v);
+    }
+}
+
+GrayImage *rotate_gray_ex(const GrayImage *img, double angle, RotateFilter filter,
+                          int expand) {
+    if (!img) return NULL;
+    if (filter == ROTATE_SHEAR) return rotate_shear_gray(img, angle, expand);
+
+    RotateMap map;
+    rotate_map_init(&map, img->w, img->h, angle, expand);
+
+    GrayImage *rotated = gray_create(map.dw, map.dh);  // already filled with white
+    if (!rotated) {
+        fprintf(stderr, "rotate_gray: out of memory\n");
+        return NULL;
     }
 
+    GrayJob job = { &map, filter, img, rotated, 0, 0 };
+    parallel_for(map.dh, ROTATE_MIN_ROWS, gray_band, &job);
     return rotated;
 }
 
+GrayImage *rotate_gray(const GrayImage *img, double angle) {
+    return rotate_gray_ex(img, angle, rotate_filter, rotate_expand);
+}
+
 /* ---------------------------------------------------------------------------
- * auto_deskew_correction
- *  Estimate global skew angle of a document-like image using a Hough-based
- *  line energy measure (coarse + fine search).
+ * Virtual rotation
  *
- *  Steps:
- *    1) Convert to 32bpp ARGB and downscale if too wide (speed).
- *    2) Coarse Hough: x ∈ [-90°,90°], step 1° -> find best orientation.
- *    3) Fine Hough around best x in [x-1.5°, x+1.5°], step 0.1°.
- *    4) Fold angle around closest multiple of 90° to get small correction.
- *
- *  Returns the correction angle in degrees: rotate(surface, angle) ≈ deskew.
+ *  A GrayView only records the mapping of rotate_gray_ex(); rotate_view_roi()
+ *  runs the same row bands on a window of the rotated page, so readers that
+ *  only need a few regions never pay for a full rotated copy.
+ *  rotate_view_sample() reads any lattice of page points (e.g. the area of
+ *  a letter tile at its final resolution) in the same single pass from the
+ *  source, and rotate_view_scaled() builds reduced analysis pages with it.
  * -------------------------------------------------------------------------- */
-double auto_deskew_correction(SDL_Surface *surface) {
-    if (!surface) return 0.0;
 
-    /* 1) Force 32 bpp + optional downscale (for speed) */
-    SDL_Surface *s32 = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
-    if (!s32) return 0.0;
+void rotate_view_init(GrayView *view, const GrayImage *src, double angle,
+                      RotateFilter filter, int expand) {
+    view->src = src;
+    view->angle = angle;
+    view->filter = filter;
+    view->expand = expand;
+    rotate_output_size(src->w, src->h, angle, expand, &view->w, &view->h);
+}
 
-    int W = s32->w, H = s32->h;
-    int maxw = 1000;                        // max width for analysis
-    double scale = (W > maxw) ? (double)maxw / (double)W : 1.0;
-    int w = (int)lrint(W * scale);
-    int h = (int)lrint(H * scale);
+int rotate_view_is_identity(const GrayView *view) {
+    return view->angle == 0.0 && view->w == view->src->w && view->h == view->src->h;
+}
+
+GrayImage *rotate_view_roi(const GrayView *view, int x, int y, int w, int h) {
+    if (!view || !view->src || w <= 0 || h <= 0) return NULL;
 
-    SDL_Surface *small = SDL_CreateRGBSurfaceWithFormat(
-        0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
-    if (!small) {
-        SDL_FreeSurface(s32);
-        return 0.0;
+    GrayImage *roi = gray_create(w, h);  // white outside the page
+    if (!roi) {
+        fprintf(stderr, "rotate_view_roi: out of memory\n");
+        return NULL;
     }
-    if (SDL_BlitScaled(s32, NULL, small, NULL) != 0) {
-        SDL_FreeSurface(s32);
-        SDL_FreeSurface(small);
-        return 0.0;
+
+    if (rotate_view_is_identity(view)) {
+        const GrayImage *src = view->src;
+        int x0 = x < 0 ? 0 : x, x1 = x + w < src->w ? x + w : src->w;
+        for (int r = 0; r < h && x0 < x1; ++r) {
+            if ((unsigned)(y + r) >= (unsigned)src->h) continue;
+            memcpy(gray_row(roi, r) + (x0 - x), gray_row(src, y + r) + x0,
+                   (size_t)(x1 - x0));
+        }
+        return roi;
     }
-    SDL_FreeSurface(s32);
 
-    if (SDL_LockSurface(small) != 0) {
-        SDL_FreeSurface(small);
-        return 0.0;
+    // Only the part of the window inside the rotated canvas is sampled
+    int x0 = x < 0 ? 0 : x, x1 = x + w < view->w ? x + w : view->w;
+    int y0 = y < 0 ? 0 : y, y1 = y + h < view->h ? y + h : view->h;
+    if (x0 >= x1 || y0 >= y1) return roi;
+    GrayImage inner = gray_sub(roi, x0 - x, y0 - y, x1 - x0, y1 - y0);
+
+    RotateMap map;
+    rotate_map_init(&map, view->src->w, view->src->h, view->angle, view->expand);
+
+    // Three shears only exist for whole pages: sample a region as nearest
+    RotateFilter filter = view->filter == ROTATE_BILINEAR ? ROTATE_BILINEAR
+                                                          : ROTATE_NEAREST;
+    GrayJob job = { &map, filter, view->src, &inner, x0, y0 };
+    parallel_for(inner.h, ROTATE_MIN_ROWS, gray_band, &job);
+    return roi;
+}
+
+void rotate_view_to_source(const GrayView *view, double x, double y,
+                           double *sx, double *sy) {
+    RotateMap map;
+    rotate_map_init(&map, view->src->w, view->src->h, view->angle, view->expand);
+    double xr = x - map.dcx, yr = y - map.dcy;
+    *sx =  map.c * xr + map.s * yr + map.cx;
+    *sy = -map.s * xr + map.c * yr + map.cy;
+}
+
+/* Samples of the rotated page along one lattice row: n points from (x, y),
+ * dx apart. Pixel centres are on integer coordinates. */
+static void view_sample_row(const GrayView *view, const RotateMap *m,
+                            double x, double y, double dx, int n, Uint8 *out)
+{
+    const GrayImage *src = view->src;
+
+    if (rotate_view_is_identity(view)) {    // no resampling: nearest pixel
+        int yi = (int)floor(y + 0.5);
+        for (int i = 0; i < n; ++i)
+            out[i] = (Uint8)gray_tap(src, (int)floor(x + i * dx + 0.5), yi);
+        return;
     }
-    const Uint32 *pix   = (const Uint32*)small->pixels;
-    int pitch           = small->pitch / 4; // pixels per row
 
-    /* 2) Coarse Hough: theta ∈ [-90°, 90°], step 1° */
-    int th_start = -90, th_end = 90, th_step = 1;
-    int th_bins  = (th_end - th_start) / th_step + 1;
+    // Stepped like rotate_map_row() + x * du, so integer lattices land on
+    // exactly the 16.16 points gray_band walks
+    double xr = -m->dcx, yr = y - m->dcy;
+    long long u = llrint(( m->c * xr + m->s * yr + m->cx) * FIX_ONE) + llrint(x * m->du);
+    long long v = llrint((-m->s * xr + m->c * yr + m->cy) * FIX_ONE) + llrint(x * m->dv);
+    long long du = llrint(dx * m->du), dv = llrint(dx * m->dv);
+
+    if (view->filter == ROTATE_BILINEAR) {
+        for (int i = 0; i < n; ++i, u += du, v += dv)
+            out[i] = gray_bilinear_clamped(src, u, v);
+        return;
+    }
+    // Same pixel as gray_band (16.16 truncation), so a NEAREST or shear
+    // view samples exactly the pixels rotate_view_roi renders
+    for (int i = 0; i < n; ++i, u += du, v += dv)
+        out[i] = (Uint8)gray_tap(src, (int)(u >> FIX_SHIFT), (int)(v >> FIX_SHIFT));
+}
 
-    int rmax  = (int)ceil(hypot((double)w, (double)h));
-    int rbins = 2 * rmax + 1;               // rho bins in [-rmax, rmax]
+void rotate_view_sample(const GrayView *view, double x0, double y0, double step,
+                        int cols, int rows, Uint8 *out, int stride) {
+    if (!view || !view->src || !out || cols <= 0 || rows <= 0) return;
 
-    // Precompute cos/sin for all coarse angles
-    double *ctab = (double*)malloc(sizeof(double) * th_bins);
-    double *stab = (double*)malloc(sizeof(double) * th_bins);
-    if (!ctab || !stab) {
-        free(ctab); free(stab);
-        SDL_UnlockSurface(small);
-        SDL_FreeSurface(small);
-        return 0.0;
+    RotateMap map;
+    rotate_map_init(&map, view->src->w, view->src->h, view->angle, view->expand);
+    for (int j = 0; j < rows; ++j)
+        view_sample_row(view, &map, x0, y0 + j * step, step, cols,
+                        out + (size_t)j * (size_t)stride);
+}
+
+typedef struct {
+    const GrayView *view;
+    const RotateMap *map;
+    GrayImage *dst;
+    int k;                  // samples per destination pixel and axis
+    double step;            // lattice step, in page pixels
+    int failed;             // set by a band that ran out of memory
+} ScaledJob;
+
+static void scaled_band(void *arg, int y0, int y1, int band)
+{
+    ScaledJob *job = arg;
+    int w = job->dst->w, k = job->k;
+    Uint32 kk = (Uint32)(k * k);
+    double org = 0.5 * job->step - 0.5;     // first sample of pixel 0
+    (void)band;
+
+    Uint8 *row = malloc((size_t)w * (size_t)k);
+    Uint32 *acc = malloc(sizeof(Uint32) * (size_t)w);
+    if (!row || !acc) {
+        free(row);
+        free(acc);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
     }
-    for (int i = 0; i < th_bins; ++i) {
-        double th = DEG2RAD(th_start + i*th_step);
-        ctab[i] = cos(th);
-        stab[i] = sin(th);
+
+    for (int y = y0; y < y1; ++y) {
+        memset(acc, 0, sizeof(Uint32) * (size_t)w);
+        for (int a = 0; a < k; ++a) {
+            view_sample_row(job->view, job->map, org,
+                            org + (double)(y * k + a) * job->step, job->step,
+                            w * k, row);
+            const Uint8 *p = row;
+            for (int x = 0; x < w; ++x)
+                for (int b = 0; b < k; ++b)
+                    acc[x] += *p++;
+        }
+        Uint8 *dst = gray_row(job->dst, y);
+        for (int x = 0; x < w; ++x)
+            dst[x] = (Uint8)((acc[x] + kk / 2) / kk);
     }
 
-    // (theta, rho) accumulator
-    int *acc = (int*)calloc((size_t)th_bins * rbins, sizeof(int));
-    if (!acc) {
-        free(ctab); free(stab);
-        SDL_UnlockSurface(small);
-        SDL_FreeSurface(small);
-        return 0.0;
+    free(row);
+    free(acc);
+}
+
+GrayImage *rotate_view_scaled(const GrayView *view, double scale) {
+    if (!view || !view->src || !(scale > 0.0)) return NULL;
+    if (scale > 1.0) scale = 1.0;
+
+    int w = (int)lround(view->w * scale), h = (int)lround(view->h * scale);
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+
+    GrayImage *dst = gray_create(w, h);
+    if (!dst) {
+        fprintf(stderr, "rotate_view_scaled: out of memory\n");
+        return NULL;
+    }
+
+    RotateMap map;
+    rotate_map_init(&map, view->src->w, view->src->h, view->angle, view->expand);
+
+    // k x k samples per pixel, so every source pixel under it is read
+    int k = (int)ceil(1.0 / scale - 1e-9);
+    ScaledJob job = { view, &map, dst, k, 1.0 / (scale * k), 0 };
+    parallel_for(h, ROTATE_MIN_ROWS, scaled_band, &job);
+    if (job.failed) {
+        fprintf(stderr, "rotate_view_scaled: out of memory\n");
+        gray_free(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+/* ---------------------------------------------------------------------------
+ * auto_deskew_correction
+ *  Estimate global skew angle of a document-like image using a Hough-based
+ *  line energy measure (coarse + fine search).
+ *  The surface is reduced once to a luminance plane, see
+ *  auto_deskew_correction_gray() for the actual estimation.
+ *
+ *  Returns the correction angle in degrees: rotate(surface, angle) ≈ deskew.
+ * -------------------------------------------------------------------------- */
+double auto_deskew_correction(SDL_Surface *surface) {
+    if (!surface) return 0.0;
+
+    GrayImage *gray = gray_from_surface(surface);
+    if (!gray) return 0.0;
+
+    double angle = auto_deskew_correction_gray(gray);
+    gray_free(gray);
+    return angle;
+}
+
+/* ---------------------------------------------------------------------------
+ * Deskew edge list
+ *
+ *  The edge pixels of the analysis plane are extracted once into a
+ *  structure-of-arrays list; every Hough angle (coarse and fine) then only
+ *  walks that list and votes into the same rho accumulator.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int *x, *y;
+    int  n, cap;
+} EdgeList;
+
+static void edge_list_free(EdgeList *e) {
+    free(e->x);
+    free(e->y);
+    e->x = e->y = NULL;
+    e->n = e->cap = 0;
+}
+
+static int edge_list_push(EdgeList *e, int x, int y) {
+    if (e->n == e->cap) {
+        int cap = e->cap ? 2 * e->cap : 4096;
+        int *nx = (int*)realloc(e->x, sizeof(int) * (size_t)cap);
+        if (!nx) return -1;
+        e->x = nx;
+        int *ny = (int*)realloc(e->y, sizeof(int) * (size_t)cap);
+        if (!ny) return -1;
+        e->y = ny;
+        e->cap = cap;
     }
+    e->x[e->n] = x;
+    e->y[e->n] = y;
+    e->n++;
+    return 0;
+}
+
+/* Edge selection: black pixel with at least one white 4-neighbor.
+ * Returns 0 on success, -1 on error (e is then freed). */
+static int edge_list_extract(const GrayImage *img, EdgeList *e) {
+    int w = img->w, h = img->h;
+    int pitch = img->stride;
 
-    // Edge selection: black pixel with at least one white neighbor
     for (int y = 1; y < h - 1; ++y) {
-        const Uint32 *row = pix + y * pitch;
+        const Uint8 *row = gray_row(img, y);
         for (int x = 1; x < w - 1; ++x) {
-            Uint32 v = row[x];
-            Uint8  a = (Uint8)(v >> 24);    // alpha
-            Uint8  R = (Uint8)(v >> 16);    // red as luminance proxy
-
-            if (a < 128 || R >= 128)        // not solid black-ish
+            if (row[x] >= 128)              // not black-ish
                 continue;
 
-            Uint32 vL = row[x-1], vR = row[x+1];
-            Uint32 vU = pix[(y-1)*pitch + x];
-            Uint32 vD = pix[(y+1)*pitch + x];
-
             // If all neighbors also dark, it's a filled region, not an edge
-            if (((Uint8)(vL >> 16) < 128) && ((Uint8)(vR >> 16) < 128) &&
-                ((Uint8)(vU >> 16) < 128) && ((Uint8)(vD >> 16) < 128))
+            if (row[x-1] < 128 && row[x+1] < 128 &&
+                row[x-pitch] < 128 && row[x+pitch] < 128)
                 continue;
 
-            // Vote for all theta bins
-            for (int ti = 0; ti < th_bins; ++ti) {
-                double rho = x * ctab[ti] + y * stab[ti];
-                int rbin = (int)lrint(rho) + rmax;
-                if ((unsigned)rbin < (unsigned)rbins)
-                    acc[ti*rbins + rbin] += 1;
+            if (edge_list_push(e, x, y) != 0) {
+                edge_list_free(e);
+                return -1;
             }
         }
     }
+    return 0;
+}
 
-    // Energy per theta: sum of squares over all rho
-    double best_theta_coarse = 0.0, best_energy = -1.0;
-    for (int ti = 0; ti < th_bins; ++ti) {
-        long long e = 0;
-        int *row = acc + ti*rbins;
-        for (int r = 0; r < rbins; ++r) {
-            int v = row[r];
-            e += (long long)v * (long long)v;
-        }
-        double E = (double)e;
-        if (E > best_energy) {
-            best_energy = E;
-            best_theta_coarse = (double)(th_start + ti*th_step);
-        }
+/* Line energy of direction theta (cos c, sin s): votes of every edge point
+ * into acc[rbins] (cleared here), then sum of squares over all rho. */
+static long long hough_energy(const EdgeList *e, double c, double s,
+                              int rmax, int rbins, int *acc) {
+    memset(acc, 0, sizeof(int) * (size_t)rbins);
+
+    const int *xs = e->x, *ys = e->y;
+    for (int i = 0; i < e->n; ++i) {
+        int rbin = (int)lrint(xs[i] * c + ys[i] * s) + rmax;
+        if ((unsigned)rbin < (unsigned)rbins) acc[rbin] += 1;
     }
 
-    free(acc);
-    free(ctab);
-    free(stab);
+    long long energy = 0;
+    for (int r = 0; r < rbins; ++r) {
+        int v = acc[r];
+        energy += (long long)v * (long long)v;
+    }
+    return energy;
+}
 
-    /* 3) Fine search around best theta (1D Hough per angle) */
-    double fine_start = best_theta_coarse - 1.5;
-    double fine_end   = best_theta_coarse + 1.5;
-    double fine_step  = 0.1;
+/* ---------------------------------------------------------------------------
+ * Hough voting kernels
+ *
+ *  DESKEW_HOUGH_DOUBLE : hough_energy() above, one angle after the other.
+ *  DESKEW_HOUGH_FIXED  : cos / sin as int32 with HOUGH_FRAC fractional bits,
+ *      rho rounded by a shift. The angles are split into bands, one per
+ *      thread, each with its own rho row, so no vote is shared and no
+ *      atomic is needed; a band stores the energy of every angle it owns
+ *      as soon as its votes are in.
+ *  x * C + y * S plus the rmax bias stays below 2^31 as long as
+ *  rmax < HOUGH_MAX_RHO (x, y <= rmax).
+ * -------------------------------------------------------------------------- */
 
-    double best_theta_fine = best_theta_coarse;
-    best_energy = -1.0;
+#define HOUGH_FRAC       14
+#define HOUGH_MAX_RHO    (1 << (29 - HOUGH_FRAC))
 
-    int fine_bins = (int)floor((fine_end - fine_start) / fine_step + 0.5) + 1;
-    for (int k = 0; k < fine_bins; ++k) {
-        double thdeg = fine_start + k * fine_step;
-        double c = cos(DEG2RAD(thdeg));
-        double s = sin(DEG2RAD(thdeg));
-
-        int *accR = (int*)calloc((size_t)rbins, sizeof(int));
-        if (!accR) continue;
-
-        for (int y = 1; y < h - 1; ++y) {
-            const Uint32 *row = pix + y * pitch;
-            for (int x = 1; x < w - 1; ++x) {
-                Uint32 v = row[x];
-                Uint8  a = (Uint8)(v >> 24);
-                Uint8  R = (Uint8)(v >> 16);
-                if (a < 128 || R >= 128) continue;
-
-                Uint32 vL = row[x-1], vR = row[x+1];
-                Uint32 vU = pix[(y-1)*pitch + x];
-                Uint32 vD = pix[(y+1)*pitch + x];
-                if (((Uint8)(vL >> 16) < 128) && ((Uint8)(vR >> 16) < 128) &&
-                    ((Uint8)(vU >> 16) < 128) && ((Uint8)(vD >> 16) < 128))
-                    continue;
-
-                int rbin = (int)lrint(x * c + y * s) + rmax;
-                if ((unsigned)rbin < (unsigned)rbins) accR[rbin] += 1;
-            }
+// Angles handed to one thread at a time
+#define HOUGH_MIN_THETAS 4
+
+static DeskewHough deskew_hough = DESKEW_HOUGH_FIXED;
+
+void set_deskew_hough(DeskewHough mode) {
+    deskew_hough = mode;
+}
+
+DeskewHough get_deskew_hough(void) {
+    return deskew_hough;
+}
+
+const char *deskew_hough_name(DeskewHough mode) {
+    switch (mode) {
+    case DESKEW_HOUGH_FIXED:  return "fixed";
+    case DESKEW_HOUGH_DOUBLE: return "double";
+    }
+    return "?";
+}
+
+typedef struct {
+    const EdgeList *edges;
+    const Sint32   *ctab, *stab;     // HOUGH_FRAC fixed point
+    int             rmax, rbins;
+    int            *acc;             // one rho row per band
+    long long      *energy;          // per angle
+} HoughJob;
+
+static void hough_band(void *arg, int t0, int t1, int band) {
+    HoughJob *job = arg;
+    int *acc = job->acc + (size_t)band * job->rbins;
+    const int *xs = job->edges->x, *ys = job->edges->y;
+    int n = job->edges->n;
+    unsigned rbins = (unsigned)job->rbins;
+
+    // rmax and the rounding half folded into one constant
+    Sint32 bias = ((Sint32)job->rmax << HOUGH_FRAC) + (1 << (HOUGH_FRAC - 1));
+
+    for (int t = t0; t < t1; ++t) {
+        Sint32 c = job->ctab[t], s = job->stab[t];
+        memset(acc, 0, sizeof(int) * rbins);
+
+        for (int i = 0; i < n; ++i) {
+            unsigned rbin = (unsigned)((xs[i] * c + ys[i] * s + bias) >> HOUGH_FRAC);
+            if (rbin < rbins) acc[rbin] += 1;
         }
 
         long long e = 0;
-        for (int r = 0; r < rbins; ++r) {
-            int v = accR[r];
-            e += (long long)v * (long long)v;
+        for (unsigned r = 0; r < rbins; ++r)
+            e += (long long)acc[r] * (long long)acc[r];
+        job->energy[t] = e;
+    }
+}
+
+/* Energy of each of the n directions theta_deg[] into energy[].
+ * Returns 0 on success, -1 on error. */
+static int hough_energies(const EdgeList *e, const double *theta_deg, int n,
+                          int rmax, int rbins, long long *energy) {
+    // Past HOUGH_MAX_RHO the fixed-point votes could overflow
+    int fixed = deskew_hough == DESKEW_HOUGH_FIXED && rmax < HOUGH_MAX_RHO;
+
+    if (!fixed) {
+        int *acc = (int*)malloc(sizeof(int) * (size_t)rbins);
+        if (!acc) return -1;
+        for (int t = 0; t < n; ++t) {
+            double th = DEG2RAD(theta_deg[t]);
+            energy[t] = hough_energy(e, cos(th), sin(th), rmax, rbins, acc);
         }
-        double E = (double)e;
-        if (E > best_energy) {
-            best_energy = E;
-            best_theta_fine = thdeg;
+        free(acc);
+        return 0;
+    }
+
+    int bands = parallel_bands(n, HOUGH_MIN_THETAS);
+    Sint32 *ctab = (Sint32*)malloc(sizeof(Sint32) * (size_t)n);
+    Sint32 *stab = (Sint32*)malloc(sizeof(Sint32) * (size_t)n);
+    int *acc = (int*)malloc(sizeof(int) * (size_t)rbins * bands);
+    if (!ctab || !stab || !acc) {
+        free(ctab); free(stab); free(acc);
+        return -1;
+    }
+    for (int t = 0; t < n; ++t) {
+        double th = DEG2RAD(theta_deg[t]);
+        ctab[t] = (Sint32)lrint(cos(th) * (1 << HOUGH_FRAC));
+        stab[t] = (Sint32)lrint(sin(th) * (1 << HOUGH_FRAC));
+    }
+
+    HoughJob job = { e, ctab, stab, rmax, rbins, acc, energy };
+    parallel_for(n, HOUGH_MIN_THETAS, hough_band, &job);
+
+    free(ctab);
+    free(stab);
+    free(acc);
+    return 0;
+}
+
+/* Angle of theta_deg[] with the highest energy (first one on ties), or
+ * fallback if the votes could not be computed. */
+static double hough_best(const EdgeList *e, const double *theta_deg, int n,
+                         int rmax, int rbins, double fallback) {
+    long long *energy = (long long*)malloc(sizeof(long long) * (size_t)n);
+    if (!energy) return fallback;
+    if (hough_energies(e, theta_deg, n, rmax, rbins, energy) != 0) {
+        free(energy);
+        return fallback;
+    }
+
+    double best = fallback;
+    long long best_energy = -1;
+    for (int t = 0; t < n; ++t) {
+        if (energy[t] > best_energy) {
+            best_energy = energy[t];
+            best = theta_deg[t];
         }
+    }
+    free(energy);
+    return best;
+}
 
-        free(accR);
+/* ---------------------------------------------------------------------------
+ * auto_deskew_correction_gray
+ *
+ *  Steps:
+ *    1) Downscale the plane if too wide (speed, nearest neighbor), then
+ *       extract its edge pixels once.
+ *    2) Coarse Hough: x ∈ [-90°,90°], step 1° -> find best orientation.
+ *    3) Fine Hough around best x in [x-1.5°, x+1.5°], step 0.1°.
+ *    4) Fold angle around closest multiple of 90° to get small correction.
+ *  Steps 2 and 3 use the kernel chosen with set_deskew_hough().
+ * -------------------------------------------------------------------------- */
+double auto_deskew_correction_gray(const GrayImage *img) {
+    if (!img) return 0.0;
+
+    /* 1) Optional downscale (for speed) */
+    int W = img->w, H = img->h;
+    int maxw = 1000;                        // max width for analysis
+    double scale = (W > maxw) ? (double)maxw / (double)W : 1.0;
+    int w = (int)lrint(W * scale);
+    int h = (int)lrint(H * scale);
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+
+    GrayImage *small = gray_create(w, h);
+    if (!small) return 0.0;
+
+    for (int y = 0; y < h; ++y) {
+        const Uint8 *src = gray_row(img, (int)((long long)y * H / h));
+        Uint8 *dst = gray_row(small, y);
+        for (int x = 0; x < w; ++x)
+            dst[x] = src[(long long)x * W / w];
     }
 
-    SDL_UnlockSurface(small);
-    SDL_FreeSurface(small);
+    EdgeList edges = { NULL, NULL, 0, 0 };
+    int rc = edge_list_extract(small, &edges);
+    gray_free(small);
+    if (rc != 0) return 0.0;
+
+    int rmax  = (int)ceil(hypot((double)w, (double)h));
+    int rbins = 2 * rmax + 1;               // rho bins in [-rmax, rmax]
+
+    /* 2) Coarse Hough: theta ∈ [-90°, 90°], step 1° */
+    double coarse[181];
+    int th_bins = 0;
+    for (int th = -90; th <= 90; th += 1)
+        coarse[th_bins++] = (double)th;
+
+    double best_theta_coarse = hough_best(&edges, coarse, th_bins, rmax, rbins, 0.0);
+
+    /* 3) Fine search around best theta (1D Hough per angle) */
+    double fine_start = best_theta_coarse - 1.5;
+    double fine_end   = best_theta_coarse + 1.5;
+    double fine_step  = 0.1;
+
+    double fine[31];
+    int fine_bins = (int)floor((fine_end - fine_start) / fine_step + 0.5) + 1;
+    if (fine_bins > (int)(sizeof(fine) / sizeof(fine[0])))
+        fine_bins = (int)(sizeof(fine) / sizeof(fine[0]));
+    for (int k = 0; k < fine_bins; ++k)
+        fine[k] = fine_start + k * fine_step;
+
+    double best_theta_fine = hough_best(&edges, fine, fine_bins, rmax, rbins,
+                                        best_theta_coarse);
+    edge_list_free(&edges);
 
     /* 4) Fold angle to closest horizontal / vertical direction */
     double nearest90 = 90.0 * round(best_theta_fine / 90.0); // { ...,-90,0,90,... }
@@ -2,13 +2,118 @@
 #define ROTATION_H
 
 #include <SDL2/SDL.h>
+#include "../gray_image/gray_image.h"
 
-// Rotate a surface around its center by `angle` degrees.
+// Sampling of the rotated image.
+typedef enum {
+    ROTATE_NEAREST = 0,
+    ROTATE_BILINEAR,
+    ROTATE_SHEAR        // three shears (nearest), for binarized pages
+} RotateFilter;
+
+// Filter and canvas used by rotate() / rotate_gray() (bilinear, same size
+// by default). With expand, the output grows to the bounding box of the
+// rotated page so the corners are not clipped.
+void set_rotate_filter(RotateFilter filter);
+RotateFilter get_rotate_filter(void);
+const char *rotate_filter_name(RotateFilter filter);
+void set_rotate_expand(int expand);
+int get_rotate_expand(void);
+
+// Rotate a 32 bpp surface around its center by `angle` degrees.
 // Returns a NEW surface (caller must SDL_FreeSurface), or NULL on error.
 SDL_Surface *rotate(SDL_Surface *surface, double angle);
 
+// rotate() with an explicit filter and canvas.
+SDL_Surface *rotate_ex(SDL_Surface *surface, double angle, RotateFilter filter,
+                       int expand);
+
 // Estimate the deskew angle (in degrees) of a document-like image.
 // Positive angle means you should call rotate(surface, angle) to deskew.
 double auto_deskew_correction(SDL_Surface *surface);
 
+// Same as rotate() on a luminance plane; uncovered corners become white.
+// Returns a NEW plane (caller must gray_free), or NULL on error.
+GrayImage *rotate_gray(const GrayImage *img, double angle);
+
+GrayImage *rotate_gray_ex(const GrayImage *img, double angle, RotateFilter filter,
+                          int expand);
+
+// Size of the canvas rotate_*_ex produce for a w x h input.
+void rotate_output_size(int w, int h, double angle, int expand, int *dw, int *dh);
+
+/* ---- Virtual rotation ---- */
+
+// Rotated page that is never materialized: the unrotated plane plus the
+// mapping of rotate_gray_ex(). Readers render the regions they analyse
+// with rotate_view_roi() / rotate_view_scaled(), and sample their final
+// pixels (e.g. letter tiles) with rotate_view_sample(), each straight from
+// the source. src must outlive the view.
+typedef struct {
+    const GrayImage *src;
+    double angle;
+    RotateFilter filter;    // ROTATE_SHEAR regions are sampled as nearest
+    int expand;
+    int w, h;               // size of the rotated page
+} GrayView;
+
+void rotate_view_init(GrayView *view, const GrayImage *src, double angle,
+                      RotateFilter filter, int expand);
+
+// Non-zero when the view is the source itself (no resampling at all).
+int rotate_view_is_identity(const GrayView *view);
+
+// w x h window at (x, y) of the rotated page (white outside the page).
+// Same pixels as the matching region of rotate_gray_ex() for
+// ROTATE_NEAREST and ROTATE_BILINEAR; ROTATE_SHEAR views are sampled as
+// ROTATE_NEAREST (the three shears only exist for whole pages), so their
+// pixels may differ slightly from rotate_shear_gray(). Returns a NEW plane
+// (caller must gray_free), or NULL on error.
+GrayImage *rotate_view_roi(const GrayView *view, int x, int y, int w, int h);
+
+// Source point of the rotated page point (x, y).
+void rotate_view_to_source(const GrayView *view, double x, double y,
+                           double *sx, double *sy);
+
+// Rotated page sampled straight from the source on the cols x rows lattice
+// (x0 + i * step, y0 + j * step) of page coordinates, pixel centres on
+// integers: bilinear for ROTATE_BILINEAR views, otherwise the source pixel
+// rotate_view_roi() would copy there (nearest pixel for identity views).
+// White outside the page. Sample (i, j) goes to out[j * stride + i].
+void rotate_view_sample(const GrayView *view, double x0, double y0, double step,
+                        int cols, int rows, Uint8 *out, int stride);
+
+// Whole rotated page reduced by scale (<= 1), each pixel the mean of the
+// samples of its area taken straight from the source. Page point (x, y) is
+// pixel (x * scale, y * scale). Returns a NEW plane (caller must gray_free),
+// or NULL on error.
+GrayImage *rotate_view_scaled(const GrayView *view, double scale);
+
+/* ---- Three-shear rotation (rotation_shear.c) ---- */
+
+// Paeth rotation: shift rows, then columns, then rows again. Every pass is
+// made of contiguous span copies, no per-pixel mapping. Nearest sampling,
+// meant for binarized pages; angles beyond +-90 degrees fall back to the
+// nearest 2D mapping. Same conventions as rotate_ex / rotate_gray_ex.
+SDL_Surface *rotate_shear(SDL_Surface *surface, double angle, int expand);
+GrayImage *rotate_shear_gray(const GrayImage *img, double angle, int expand);
+
+// Same on a packed bitmap (uncovered pixels are white).
+BitImage *rotate_bits(const BitImage *img, double angle, int expand);
+
+// Same as auto_deskew_correction() on a luminance plane.
+double auto_deskew_correction_gray(const GrayImage *img);
+
+// Hough voting used by the deskew estimation: int32 trig tables with the
+// angles split over the thread pool (default), or the double precision
+// single-threaded reference.
+typedef enum {
+    DESKEW_HOUGH_FIXED = 0,
+    DESKEW_HOUGH_DOUBLE
+} DeskewHough;
+
+void set_deskew_hough(DeskewHough mode);
+DeskewHough get_deskew_hough(void);
+const char *deskew_hough_name(DeskewHough mode);
+
 #endif
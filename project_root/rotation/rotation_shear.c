@@ -0,0 +1,421 @@
+// rotation_shear.c
+#include "rotation.h"
+#include "../thread_pool/thread_pool.h"
+
+#include <stdio.h>      // fprintf
+#include <math.h>       // tan, sin, fabs, lround
+#include <stdlib.h>     // malloc, free
+#include <string.h>     // memcpy, memset
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEG2RAD(a) ((a) * (M_PI / 180.0))
+
+// Rows handed to one thread at a time
+#define SHEAR_MIN_ROWS 16
+
+/* ---------------------------------------------------------------------------
+ * Plan
+ *
+ *  rotate() maps a source point p to the destination d = R p (both relative
+ *  to the centers), with R = [[c, -s], [s, c]]. Paeth's decomposition
+ *      R = X(a) Y(b) X(a),   a = -tan(angle / 2),  b = sin(angle)
+ *  with X(a) : x += a * y and Y(b) : y += b * x turns it into three passes
+ *  where every row (X) or column (Y) is shifted by a whole number of pixels:
+ *      pass 1 : I1[y][x] = I0[y][x - o1 - s1(y)]       (rows)
+ *      pass 2 : I2[y][x] = I1[y - o2 - s2(x)][x]       (columns)
+ *      pass 3 : out[Y][X] = I2[y][X - dcx + c1x - s3(y)], y = Y - dcy + c2y
+ *  o1 / o2 make room for the sheared page, the last pass writes the output
+ *  canvas directly. s2 is constant over runs of columns (long ones for
+ *  deskew angles), so pass 2 copies row segments as well.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int x0, x1;     // columns [x0, x1)
+    int shift;
+} ColumnRun;
+
+typedef struct {
+    double a, b;
+    int w, h;           // source
+    int cx, cy;         // rotation center of the source
+    int w1, o1, c1x;    // pass 1 canvas width, offset, center x
+    int h2, o2, c2y;    // pass 2 canvas height, offset, center y
+    int dw, dh;         // output
+    int dcx, dcy;
+    ColumnRun *runs;    // pass 2 shifts
+    int nruns;
+} ShearPlan;
+
+static inline int shear_shift(double k, int t)
+{
+    return (int)lround(k * t);
+}
+
+static int shear_plan_init(ShearPlan *p, int w, int h, double angle, int expand)
+{
+    double rad = DEG2RAD(angle);
+    p->a = -tan(rad / 2.0);
+    p->b = sin(rad);
+    p->w = w;
+    p->h = h;
+    p->cx = w / 2;
+    p->cy = h / 2;
+
+    int s_top = shear_shift(p->a, 0 - p->cy), s_bot = shear_shift(p->a, h - 1 - p->cy);
+    int s_min = s_top < s_bot ? s_top : s_bot;
+    p->o1 = -s_min;
+    p->w1 = w + abs(s_bot - s_top);
+    p->c1x = p->cx + p->o1;
+
+    int s_left = shear_shift(p->b, 0 - p->c1x);
+    int s_right = shear_shift(p->b, p->w1 - 1 - p->c1x);
+    s_min = s_left < s_right ? s_left : s_right;
+    p->o2 = -s_min;
+    p->h2 = h + abs(s_right - s_left);
+    p->c2y = p->cy + p->o2;
+
+    rotate_output_size(w, h, angle, expand, &p->dw, &p->dh);
+    p->dcx = p->dw / 2;
+    p->dcy = p->dh / 2;
+
+    // Runs of columns sharing the same pass 2 shift
+    p->runs = malloc((size_t)p->w1 * sizeof(ColumnRun));
+    if (!p->runs) return -1;
+    p->nruns = 0;
+    for (int x = 0; x < p->w1; ) {
+        int s = shear_shift(p->b, x - p->c1x);
+        int e = x + 1;
+        while (e < p->w1 && shear_shift(p->b, e - p->c1x) == s) e++;
+        p->runs[p->nruns++] = (ColumnRun){ x, e, s };
+        x = e;
+    }
+    return 0;
+}
+
+/* Part of a destination row of length dlen that a source row of length
+ * slen covers when dst[x] = src[x - shift]. Returns the length (0 if none). */
+static inline int span_clip(int dlen, int slen, int shift, int *x0)
+{
+    int lo = shift > 0 ? shift : 0;
+    int hi = slen + shift < dlen ? slen + shift : dlen;
+    *x0 = lo;
+    return hi > lo ? hi - lo : 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Byte planes (1 byte per pixel for gray, 4 for surfaces)
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    Uint8 *data;
+    size_t stride;
+    int w, h;
+} BytePlane;
+
+static inline Uint8 *plane_row(const BytePlane *p, int y)
+{
+    return p->data + (size_t)y * p->stride;
+}
+
+typedef struct {
+    const ShearPlan *plan;
+    const BytePlane *src, *dst;
+    int bpp;
+} BytePassJob;
+
+static void byte_pass1(void *arg, int y0, int y1, int band)
+{
+    BytePassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        int shift = p->o1 + shear_shift(p->a, y - p->cy);
+        int x0, n = span_clip(job->dst->w, job->src->w, shift, &x0);
+        if (n > 0)
+            memcpy(plane_row(job->dst, y) + (size_t)x0 * job->bpp,
+                   plane_row(job->src, y) + (size_t)(x0 - shift) * job->bpp,
+                   (size_t)n * job->bpp);
+    }
+}
+
+static void byte_pass2(void *arg, int y0, int y1, int band)
+{
+    BytePassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        Uint8 *dst = plane_row(job->dst, y);
+        for (int r = 0; r < p->nruns; ++r) {
+            const ColumnRun *run = &p->runs[r];
+            int sy = y - p->o2 - run->shift;
+            if ((unsigned)sy >= (unsigned)job->src->h) continue;
+            const Uint8 *src = plane_row(job->src, sy);
+            size_t off = (size_t)run->x0 * job->bpp;
+            memcpy(dst + off, src + off, (size_t)(run->x1 - run->x0) * job->bpp);
+        }
+    }
+}
+
+static void byte_pass3(void *arg, int y0, int y1, int band)
+{
+    BytePassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        int sy = y - p->dcy + p->c2y;
+        if ((unsigned)sy >= (unsigned)job->src->h) continue;
+        int shift = p->dcx - p->c1x + shear_shift(p->a, sy - p->c2y);
+        int x0, n = span_clip(job->dst->w, job->src->w, shift, &x0);
+        if (n > 0)
+            memcpy(plane_row(job->dst, y) + (size_t)x0 * job->bpp,
+                   plane_row(job->src, sy) + (size_t)(x0 - shift) * job->bpp,
+                   (size_t)n * job->bpp);
+    }
+}
+
+/* Three passes from src to dst (already filled with the background byte bg,
+ * of the plan's output size). Returns 0 on success, -1 on error. */
+static int shear_bytes(const ShearPlan *p, const BytePlane *src,
+                       const BytePlane *dst, int bpp, Uint8 bg)
+{
+    BytePlane i1 = { NULL, (size_t)p->w1 * bpp, p->w1, p->h };
+    BytePlane i2 = { NULL, (size_t)p->w1 * bpp, p->w1, p->h2 };
+    i1.data = malloc(i1.stride * i1.h);
+    i2.data = malloc(i2.stride * i2.h);
+    if (!i1.data || !i2.data) {
+        free(i1.data);
+        free(i2.data);
+        return -1;
+    }
+    memset(i1.data, bg, i1.stride * i1.h);
+    memset(i2.data, bg, i2.stride * i2.h);
+
+    BytePassJob job1 = { p, src, &i1, bpp };
+    parallel_for(i1.h, SHEAR_MIN_ROWS, byte_pass1, &job1);
+    BytePassJob job2 = { p, &i1, &i2, bpp };
+    parallel_for(i2.h, SHEAR_MIN_ROWS, byte_pass2, &job2);
+    BytePassJob job3 = { p, &i2, dst, bpp };
+    parallel_for(dst->h, SHEAR_MIN_ROWS, byte_pass3, &job3);
+
+    free(i1.data);
+    free(i2.data);
+    return 0;
+}
+
+SDL_Surface *rotate_shear(SDL_Surface *surface, double angle, int expand) {
+    if (!surface) return NULL;
+    if (surface->format->BytesPerPixel != 4) {
+        fprintf(stderr, "rotate_shear: need a 32 bpp surface\n");
+        return NULL;
+    }
+    if (fabs(angle) > 90.0)
+        return rotate_ex(surface, angle, ROTATE_NEAREST, expand);
+
+    ShearPlan plan;
+    if (shear_plan_init(&plan, surface->w, surface->h, angle, expand) != 0) {
+        fprintf(stderr, "rotate_shear: out of memory\n");
+        return NULL;
+    }
+
+    SDL_Surface *rotated = SDL_CreateRGBSurface(
+        0, plan.dw, plan.dh,
+        surface->format->BitsPerPixel,
+        surface->format->Rmask,
+        surface->format->Gmask,
+        surface->format->Bmask,
+        surface->format->Amask
+    );
+    if (!rotated) {
+        fprintf(stderr, "rotate_shear: SDL_CreateRGBSurface: %s\n", SDL_GetError());
+        free(plan.runs);
+        return NULL;
+    }
+
+    // Uncovered pixels stay fully transparent black, as with rotate()
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    BytePlane src = { surface->pixels, (size_t)surface->pitch, surface->w, surface->h };
+    BytePlane dst = { rotated->pixels, (size_t)rotated->pitch, rotated->w, rotated->h };
+    int rc = shear_bytes(&plan, &src, &dst, 4, 0);
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+
+    free(plan.runs);
+    if (rc != 0) {
+        fprintf(stderr, "rotate_shear: out of memory\n");
+        SDL_FreeSurface(rotated);
+        return NULL;
+    }
+    return rotated;
+}
+
+GrayImage *rotate_shear_gray(const GrayImage *img, double angle, int expand) {
+    if (!img) return NULL;
+    if (fabs(angle) > 90.0)
+        return rotate_gray_ex(img, angle, ROTATE_NEAREST, expand);
+
+    ShearPlan plan;
+    if (shear_plan_init(&plan, img->w, img->h, angle, expand) != 0) {
+        fprintf(stderr, "rotate_shear_gray: out of memory\n");
+        return NULL;
+    }
+
+    GrayImage *rotated = gray_create(plan.dw, plan.dh);  // white
+    int rc = -1;
+    if (rotated) {
+        BytePlane src = { img->data, (size_t)img->stride, img->w, img->h };
+        BytePlane dst = { rotated->data, (size_t)rotated->stride, rotated->w, rotated->h };
+        rc = shear_bytes(&plan, &src, &dst, 1, 255);
+    }
+
+    free(plan.runs);
+    if (rc != 0) {
+        fprintf(stderr, "rotate_shear_gray: out of memory\n");
+        gray_free(rotated);
+        return NULL;
+    }
+    return rotated;
+}
+
+/* ---------------------------------------------------------------------------
+ * Packed bitmaps
+ * -------------------------------------------------------------------------- */
+
+/* 64 bits of row starting at bit pos (bits past the row read as 0). */
+static inline Uint64 load_bits(const Uint64 *row, int words, int pos)
+{
+    int i = pos >> 6, o = pos & 63;
+    Uint64 v = row[i] >> o;
+    if (o && i + 1 < words) v |= row[i + 1] << (64 - o);
+    return v;
+}
+
+/* Copy n bits from src (at bit sx) to dst (at bit dx). */
+static void bit_copy_span(Uint64 *dst, int dx, const Uint64 *src, int swords,
+                          int sx, int n)
+{
+    while (n > 0) {
+        int o = dx & 63;
+        int k = 64 - o;                 // bits left in this dst word
+        if (k > n) k = n;
+        Uint64 v = load_bits(src, swords, sx);
+        Uint64 mask = (k == 64) ? ~0ULL : ((1ULL << k) - 1);
+        Uint64 *d = &dst[dx >> 6];
+        *d = (*d & ~(mask << o)) | ((v & mask) << o);
+        dx += k;
+        sx += k;
+        n -= k;
+    }
+}
+
+typedef struct {
+    const ShearPlan *plan;
+    const BitImage  *src;
+    BitImage        *dst;
+} BitPassJob;
+
+static void bit_pass1(void *arg, int y0, int y1, int band)
+{
+    BitPassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        int shift = p->o1 + shear_shift(p->a, y - p->cy);
+        int x0, n = span_clip(job->dst->w, job->src->w, shift, &x0);
+        if (n > 0)
+            bit_copy_span(bit_row(job->dst, y), x0, bit_row(job->src, y),
+                          job->src->words, x0 - shift, n);
+    }
+}
+
+static void bit_pass2(void *arg, int y0, int y1, int band)
+{
+    BitPassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        Uint64 *dst = bit_row(job->dst, y);   // all clear
+        for (int r = 0; r < p->nruns; ++r) {
+            const ColumnRun *run = &p->runs[r];
+            int sy = y - p->o2 - run->shift;
+            if ((unsigned)sy >= (unsigned)job->src->h) continue;
+            // Columns do not move in this pass: mask whole words
+            const Uint64 *src = bit_row(job->src, sy);
+            for (int i = run->x0 >> 6; i <= (run->x1 - 1) >> 6; ++i) {
+                Uint64 m = ~0ULL;
+                if (i == run->x0 >> 6) m &= ~0ULL << (run->x0 & 63);
+                if (i == (run->x1 - 1) >> 6 && (run->x1 & 63))
+                    m &= (1ULL << (run->x1 & 63)) - 1;
+                dst[i] |= src[i] & m;
+            }
+        }
+    }
+}
+
+static void bit_pass3(void *arg, int y0, int y1, int band)
+{
+    BitPassJob *job = arg;
+    const ShearPlan *p = job->plan;
+    (void)band;
+
+    for (int y = y0; y < y1; ++y) {
+        int sy = y - p->dcy + p->c2y;
+        if ((unsigned)sy >= (unsigned)job->src->h) continue;
+        int shift = p->dcx - p->c1x + shear_shift(p->a, sy - p->c2y);
+        int x0, n = span_clip(job->dst->w, job->src->w, shift, &x0);
+        if (n > 0)
+            bit_copy_span(bit_row(job->dst, y), x0, bit_row(job->src, sy),
+                          job->src->words, x0 - shift, n);
+    }
+}
+
+BitImage *rotate_bits(const BitImage *img, double angle, int expand) {
+    if (!img) return NULL;
+    if (fabs(angle) > 90.0) {
+        // Through a gray plane: rare, not worth a dedicated path
+        GrayImage *g = gray_create(img->w, img->h);
+        GrayImage *r = NULL;
+        BitImage *out = NULL;
+        if (g && bit_to_gray(img, g) == 0) r = rotate_gray_ex(g, angle, ROTATE_NEAREST, expand);
+        if (r) out = bit_from_gray(r);
+        gray_free(g);
+        gray_free(r);
+        return out;
+    }
+
+    ShearPlan plan;
+    if (shear_plan_init(&plan, img->w, img->h, angle, expand) != 0) {
+        fprintf(stderr, "rotate_bits: out of memory\n");
+        return NULL;
+    }
+
+    BitImage *i1 = bit_create(plan.w1, plan.h);
+    BitImage *i2 = bit_create(plan.w1, plan.h2);
+    BitImage *out = bit_create(plan.dw, plan.dh);
+    if (!i1 || !i2 || !out) {
+        fprintf(stderr, "rotate_bits: out of memory\n");
+        bit_free(i1);
+        bit_free(i2);
+        bit_free(out);
+        free(plan.runs);
+        return NULL;
+    }
+
+    BitPassJob job1 = { &plan, img, i1 };
+    parallel_for(i1->h, SHEAR_MIN_ROWS, bit_pass1, &job1);
+    BitPassJob job2 = { &plan, i1, i2 };
+    parallel_for(i2->h, SHEAR_MIN_ROWS, bit_pass2, &job2);
+    BitPassJob job3 = { &plan, i2, out };
+    parallel_for(out->h, SHEAR_MIN_ROWS, bit_pass3, &job3);
+
+    bit_free(i1);
+    bit_free(i2);
+    free(plan.runs);
+    return out;
+}
@@ -355,12 +355,26 @@ int event_handler(struct image_data *data,
                 actualize_rendering(renderer, texture, *surface);
                 break;
 
-            case SDLK_h:   // Otsu threshold
-                apply_otsu_thresholding(*surface);
+            case SDLK_h:   // threshold (Otsu unless switched with T)
+                apply_thresholding(*surface);
                 save_surface(data, *surface, "otsu_thresholding");
                 actualize_rendering(renderer, texture, *surface);
                 break;
 
+            case SDLK_t: { // cycle Otsu / Sauvola / Bradley
+                ThresholdMethod m = (get_threshold_method() + 1) % 3;
+                set_threshold_method(m);
+                printf("Threshold method: %s\n", threshold_method_name(m));
+                break;
+            }
+
+            case SDLK_b: { // rotation: nearest / bilinear / shear
+                RotateFilter f = (get_rotate_filter() + 1) % 3;
+                set_rotate_filter(f);
+                printf("Rotation filter: %s\n", rotate_filter_name(f));
+                break;
+            }
+
             case SDLK_j:   // noise removal (radius 2)
                 apply_noise_removal(*surface, 2);
                 save_surface(data, *surface, "noise_removal");
@@ -1,11 +1,11 @@
 // solver.c
 #include "solver.h"
 
-#include <ctype.h>   // toupper
+#include <ctype.h>   // toupper, isdigit, isspace
 #include <math.h>    // logf
-#include <stdio.h>   // FILE, fopen, fscanf, perror, fprintf
-#include <stdlib.h>  // malloc, free
-#include <string.h>  // strlen
+#include <stdio.h>   // FILE, fopen, fscanf, fgets, perror, fprintf
+#include <stdlib.h>  // malloc, realloc, free
+#include <string.h>  // strlen, memset
 
 // Small floor value when a letter is missing in top-k.
 #define MIN_EPS_WEIGHT 1e-6f
@@ -65,6 +65,32 @@ void freeMatrix(char **matrix, int rows) {
     free(matrix);
 }
 
+/* Allocate a rows x cols matrix and fill it with the next rows*cols
+ * non-blank characters of `file` (uppercased, '?' past the end). */
+static char **read_grid_body(FILE *file, int rows, int cols) {
+    char **matrix = (char**)malloc((size_t)rows * sizeof(char*));
+    if (!matrix)
+        return NULL;
+
+    for (int i = 0; i < rows; ++i) {
+        matrix[i] = (char*)malloc((size_t)cols * sizeof(char));
+        if (!matrix[i]) {
+            for (int k = 0; k < i; ++k) free(matrix[k]);
+            free(matrix);
+            return NULL;
+        }
+    }
+
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            if (fscanf(file, " %c", &matrix[i][j]) != 1)
+                matrix[i][j] = '?';
+            matrix[i][j] = (char)toupper((unsigned char)matrix[i][j]);
+        }
+    }
+    return matrix;
+}
+
 /* Read grid from text file:
  *  first line: "<rows> <cols>"
  *  then rows*cols characters.
@@ -76,38 +102,139 @@ char **read_grid_from_file(const char *filename, int *rows, int *cols) {
         return NULL;
     }
 
-    if (fscanf(file, "%d %d", rows, cols) != 2) {
+    if (fscanf(file, "%d %d", rows, cols) != 2 || *rows <= 0 || *cols <= 0) {
         fprintf(stderr, "read_grid_from_file: invalid header\n");
         fclose(file);
         return NULL;
     }
 
-    char **matrix = (char**)malloc((size_t)*rows * sizeof(char*));
-    if (!matrix) {
-        fclose(file);
-        return NULL;
-    }
+    char **matrix = read_grid_body(file, *rows, *cols);
+    fclose(file);
+    return matrix;
+}
 
-    for (int i = 0; i < *rows; ++i) {
-        matrix[i] = (char*)malloc((size_t)*cols * sizeof(char));
-        if (!matrix[i]) {
-            for (int k = 0; k < i; ++k) free(matrix[k]);
-            free(matrix);
-            fclose(file);
-            return NULL;
+/* Write one export block: header, grid rows of space-separated letters
+ * (anything but A..Z written as '?'), then one word per line. */
+int write_grid_block(FILE *f, char **grid, int rows, int cols,
+                     char **words, int n_words) {
+    if (!f || !grid || rows <= 0 || cols <= 0) return -1;
+
+    fprintf(f, "%d %d\n", rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            char c = grid[i][j];
+            if (c < 'A' || c > 'Z')
+                c = '?';
+            fputc(c, f);
+            fputc(j + 1 < cols ? ' ' : '\n', f);
         }
     }
+    for (int w = 0; w < n_words; ++w)
+        fprintf(f, "%s\n", (words && words[w]) ? words[w] : "");
+    return ferror(f) ? -1 : 0;
+}
 
-    for (int i = 0; i < *rows; ++i) {
-        for (int j = 0; j < *cols; ++j) {
-            if (fscanf(file, " %c", &matrix[i][j]) != 1)
-                matrix[i][j] = '?';
-            matrix[i][j] = (char)toupper((unsigned char)matrix[i][j]);
+void free_grid_blocks(GridBlock *blocks, int count) {
+    if (!blocks) return;
+    for (int b = 0; b < count; ++b) {
+        freeMatrix(blocks[b].grid, blocks[b].rows);
+        for (int w = 0; w < blocks[b].n_words; ++w)
+            free(blocks[b].words[w]);
+        free(blocks[b].words);
+    }
+    free(blocks);
+}
+
+/* Append a copy of `word` to the word list of `block`. */
+static int block_add_word(GridBlock *block, const char *word, int *cap) {
+    if (block->n_words == *cap) {
+        int ncap = *cap ? *cap * 2 : 16;
+        char **nw = (char**)realloc(block->words, (size_t)ncap * sizeof(char*));
+        if (!nw) return -1;
+        block->words = nw;
+        *cap = ncap;
+    }
+    size_t len = strlen(word);
+    char *copy = (char*)malloc(len + 1);
+    if (!copy) return -1;
+    for (size_t i = 0; i <= len; ++i)
+        copy[i] = (char)toupper((unsigned char)word[i]);
+    block->words[block->n_words++] = copy;
+    return 0;
+}
+
+/* Read every block of an export file. A line starting with a digit opens
+ * the next block; the other non-empty lines after a grid are its words. */
+int read_grid_blocks(const char *filename, GridBlock **out, int *count) {
+    *out = NULL;
+    *count = 0;
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror("read_grid_blocks: fopen");
+        return -1;
+    }
+
+    GridBlock *blocks = NULL;
+    int n = 0, cap = 0, wcap = 0, rc = 0;
+    char line[512];
+    int have = fgets(line, sizeof line, file) != NULL;
+
+    while (have) {
+        char *p = line;
+        while (isspace((unsigned char)*p)) ++p;
+        if (*p == '\0') {                       // blank line
+            have = fgets(line, sizeof line, file) != NULL;
+            continue;
+        }
+
+        if (isdigit((unsigned char)*p)) {       // "<rows> <cols>": new block
+            int rows, cols;
+            if (sscanf(p, "%d %d", &rows, &cols) != 2 || rows <= 0 || cols <= 0) {
+                fprintf(stderr, "read_grid_blocks: invalid header\n");
+                rc = -1;
+                break;
+            }
+            if (n == cap) {
+                int ncap = cap ? cap * 2 : 4;
+                GridBlock *nb = (GridBlock*)realloc(blocks,
+                                                    (size_t)ncap * sizeof(GridBlock));
+                if (!nb) { rc = -1; break; }
+                blocks = nb;
+                cap = ncap;
+            }
+            GridBlock *b = &blocks[n];
+            memset(b, 0, sizeof(*b));
+            b->rows = rows;
+            b->cols = cols;
+            b->grid = read_grid_body(file, rows, cols);
+            if (!b->grid) { rc = -1; break; }
+            ++n;
+            wcap = 0;
+            have = fgets(line, sizeof line, file) != NULL; // end of the grid
+            continue;
         }
+
+        if (n == 0) {                           // words before any grid
+            fprintf(stderr, "read_grid_blocks: missing header\n");
+            rc = -1;
+            break;
+        }
+        char *end = p + strlen(p);
+        while (end > p && isspace((unsigned char)end[-1])) --end;
+        *end = '\0';
+        if (block_add_word(&blocks[n - 1], p, &wcap) != 0) { rc = -1; break; }
+        have = fgets(line, sizeof line, file) != NULL;
     }
 
     fclose(file);
-    return matrix;
+    if (rc != 0) {
+        free_grid_blocks(blocks, n);
+        return -1;
+    }
+    *out = blocks;
+    *count = n;
+    return 0;
 }
 
 /* Internal helper: get weight of class `cls` in a given cell. */
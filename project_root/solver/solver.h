@@ -3,6 +3,7 @@
 #define SOLVER_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 // Number of candidates kept per cell (top-k).
 // Must match the value used by the neural-network code.
@@ -59,8 +60,29 @@ void freeMatrix(char **matrix, int rows);
 /* Debug helper: load a grid from text file with format:
  *   <rows> <cols>
  *   <rows * cols characters...>
+ * (the first block of an export file; see read_grid_blocks for all).
  * Returns newly allocated matrix (or NULL on error).
  */
 char **read_grid_from_file(const char *filename, int *rows, int *cols);
 
+/* One puzzle of an export file: its grid and its word list. */
+typedef struct {
+    int    rows, cols;
+    char **grid;     // rows x cols letters ('?' for unread cells)
+    char **words;    // n_words strings
+    int    n_words;
+} GridBlock;
+
+/* Export files hold one block per puzzle, in reading order:
+ *   <rows> <cols>
+ *   <rows lines of cols space-separated letters>
+ *   <one word per line>
+ * write_grid_block appends one block to f (0 on success, -1 on error).
+ * read_grid_blocks loads every block of the file into *out (count in
+ * *count, release with free_grid_blocks); returns 0 or -1 on error. */
+int  write_grid_block(FILE *f, char **grid, int rows, int cols,
+                      char **words, int n_words);
+int  read_grid_blocks(const char *filename, GridBlock **out, int *count);
+void free_grid_blocks(GridBlock *blocks, int count);
+
 #endif
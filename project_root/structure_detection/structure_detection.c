@@ -2,23 +2,17 @@
 #include <stdlib.h>
 #include <math.h>
 #include "structure_detection.h"
-
-/* ============================================================================
- *  Helper : test "pixel noir" (texte / traits)
- * ============================================================================
- */
-static inline int is_black(Uint32 v)
-{
-    Uint8 a = (Uint8)(v >> 24);
-    Uint8 r = (Uint8)(v >> 16);
-    return (a >= 128 && r < 128);
-}
+#include "../projection/projection.h"
+#include "../rotation/rotation.h"
 
 /* ============================================================================
  *  Bande horizontale dense (pour la LISTE à droite/gauche)
  * ============================================================================
+ *
+ * Les comptes de pixels noirs (valeur < 128) viennent du profil d'encre de
+ * la page (cf. projection.h) : chaque colonne / ligne testée en O(1).
  */
-static int find_dense_band(const Uint32 *P, int pitch,
+static int find_dense_band(const InkProfile *ink,
                            int y1, int y2, int x0, int x1,
                            SDL_Rect *out)
 {
@@ -35,15 +29,7 @@ static int find_dense_band(const Uint32 *P, int pitch,
     int last_x  = -1;
 
     for (int x = x0; x <= x1; ++x) {
-        int has_black = 0;
-        for (int y = y1; y <= y2; ++y) {
-            Uint32 v = P[y * pitch + x];
-            if (is_black(v)) {
-                has_black = 1;
-                break;
-            }
-        }
-        if (has_black) {
+        if (ink_rect(ink, x, y1, x, y2) > 0) {
             if (first_x < 0)
                 first_x = x;
             last_x = x;
@@ -69,15 +55,7 @@ static int find_dense_band(const Uint32 *P, int pitch,
     int last_y  = -1;
 
     for (int y = y1; y <= y2; ++y) {
-        int has_black = 0;
-        for (int x = left; x <= right; ++x) {
-            Uint32 v = P[y * pitch + x];
-            if (is_black(v)) {
-                has_black = 1;
-                break;
-            }
-        }
-        if (has_black) {
+        if (ink_rect(ink, left, y, right, y) > 0) {
             if (first_y < 0)
                 first_y = y;
             last_y = y;
@@ -109,14 +87,10 @@ static int find_dense_band(const Uint32 *P, int pitch,
 /* ============================================================================
  *  Structures pour le fallback “lettres seules”
  * ============================================================================
+ *
+ * Les lettres sont une ComponentList (cf. components.h) : un tableau par
+ * champ, donc tri par cx et recherche du gap sur des tableaux contigus.
  */
-typedef struct {
-    float cx, cy;   /* centre (en float) */
-    int minx, maxx; /* bounding box */
-    int miny, maxy;
-    int area;       /* nombre de pixels */
-} Comp;
-
 typedef struct {
     int count;
     int minx, maxx;
@@ -124,20 +98,52 @@ typedef struct {
     long long sum_area;
 } ClusterStats;
 
-static int cmp_comp_cx(const void *a, const void *b)
+/* Clé de tri compacte : centre horizontal + rang (départage → tri stable) */
+typedef struct {
+    float cx;
+    int   idx;
+} CxKey;
+
+static int cmp_cx_key(const void *a, const void *b)
 {
-    const Comp *A = (const Comp *)a;
-    const Comp *B = (const Comp *)b;
+    const CxKey *A = (const CxKey *)a;
+    const CxKey *B = (const CxKey *)b;
     if (A->cx < B->cx) return -1;
     if (A->cx > B->cx) return 1;
-    return 0;
+    return (A->idx > B->idx) - (A->idx < B->idx);
 }
 
-static void stats_range(Comp *c, int n, int start, int end,
-                        ClusterStats *S, int W, int H)
+/* Réordonne la liste par cx croissant : tri des clés, puis une recopie
+ * des tableaux dans l'ordre trié. */
+static int sort_by_cx(ComponentList *c)
 {
-    (void)n; (void)W; (void)H;
+    CxKey *keys = (CxKey *)malloc(sizeof(CxKey) * (size_t)(c->n ? c->n : 1));
+    if (!keys)
+        return -1;
+    for (int i = 0; i < c->n; ++i) {
+        keys[i].cx  = c->cx[i];
+        keys[i].idx = i;
+    }
+    qsort(keys, (size_t)c->n, sizeof(CxKey), cmp_cx_key);
+
+    ComponentList sorted = {0};
+    int ok = components_reserve(&sorted, c->n) == 0;
+    for (int i = 0; ok && i < c->n; ++i)
+        ok = components_append(&sorted, c, keys[i].idx) == 0;
+    free(keys);
+    if (!ok) {
+        components_free(&sorted);
+        return -1;
+    }
+
+    components_free(c);
+    *c = sorted;
+    return 0;
+}
 
+static void stats_range(const ComponentList *c, int start, int end,
+                        ClusterStats *S)
+{
     S->count = 0;
     S->minx =  1000000000;
     S->maxx = -1000000000;
@@ -146,149 +152,65 @@ static void stats_range(Comp *c, int n, int start, int end,
     S->sum_area = 0;
 
     for (int i = start; i <= end; ++i) {
-        if (c[i].minx < S->minx) S->minx = c[i].minx;
-        if (c[i].maxx > S->maxx) S->maxx = c[i].maxx;
-        if (c[i].miny < S->miny) S->miny = c[i].miny;
-        if (c[i].maxy > S->maxy) S->maxy = c[i].maxy;
-        S->sum_area += c[i].area;
+        if (c->minx[i] < S->minx) S->minx = c->minx[i];
+        if (c->maxx[i] > S->maxx) S->maxx = c->maxx[i];
+        if (c->miny[i] < S->miny) S->miny = c->miny[i];
+        if (c->maxy[i] > S->maxy) S->maxy = c->maxy[i];
+        S->sum_area += c->area[i];
         S->count++;
     }
 }
 
 /* ============================================================================
- *  Helper 1 : flood-fill → grosse composante + petites composantes (lettres)
+ *  Helper 1 : composantes → grosse composante + petites composantes (lettres)
  * ============================================================================
  *
- * - Parcourt toute l'image ARGB8888.
- * - Flood-fill sur les pixels noirs.
+ * - Parcourt la liste des composantes (ordre de balayage de la page).
  * - Retourne :
  *     *bestBox  / *bestArea : plus grande composante "massive" (candidat grille)
- *     *comps_out / *ncomp_out : tableau des petites composantes (lettres)
+ *     *letters : copie des petites composantes (lettres), vide en entrée
  *     gmin/gmax : bounding box globale des lettres
  */
-static int flood_fill_components(SDL_Surface *s32,
-                                 SDL_Rect *bestBox, int *bestArea,
-                                 Comp **comps_out, int *ncomp_out,
-                                 int *gminx, int *gmaxx, int *gminy, int *gmaxy)
-{
-    int W = s32->w;
-    int H = s32->h;
-    const Uint32 *P = (const Uint32 *)s32->pixels;
-    int pitch = s32->pitch / 4;
-
-    unsigned char *vis = (unsigned char *)calloc((size_t)W * H, 1);
-    int *stack = (int *)malloc(sizeof(int) * (W * H / 4 + 1024));
-    if (!vis || !stack) {
-        free(vis);
-        free(stack);
-        return -1;
-    }
-
-    int max_comp = 8192;
-    Comp *comps = (Comp *)malloc((size_t)max_comp * sizeof(Comp));
-    if (!comps) {
-        free(vis);
-        free(stack);
+static int split_components(const ComponentList *cc, int W, int H,
+                            SDL_Rect *bestBox, int *bestArea,
+                            ComponentList *letters,
+                            int *gminx, int *gmaxx, int *gminy, int *gmaxy)
+{
+    if (components_reserve(letters, cc->n) != 0)
         return -1;
-    }
 
-    int ncomp = 0;
     int bestA = 0;
     SDL_Rect best = (SDL_Rect){0,0,0,0};
     int minLetterArea = 10;
 
     int ggminx = W, ggmaxx = -1, ggminy = H, ggmaxy = -1;
 
-    for (int y = 0; y < H; ++y) {
-        const Uint32 *row = P + y * pitch;
-        for (int x = 0; x < W; ++x) {
-            int id = y * W + x;
-            if (vis[id]) continue;
-
-            if (!is_black(row[x])) {
-                vis[id] = 1;
-                continue;
-            }
-
-            int sp = 0;
-            vis[id] = 1;
-            stack[sp++] = id;
-
-            int minx = x, maxx = x, miny = y, maxy = y;
-            int area = 0;
-
-            while (sp) {
-                int idx = stack[--sp];
-                int cy = idx / W;
-                int cx = idx % W;
-                area++;
-                if (cx < minx) minx = cx;
-                if (cx > maxx) maxx = cx;
-                if (cy < miny) miny = cy;
-                if (cy > maxy) maxy = cy;
-
-                for (int dy = -1; dy <= 1; ++dy) {
-                    int ny = cy + dy;
-                    if ((unsigned)ny >= (unsigned)H)
-                        continue;
-                    const Uint32 *r2 = P + ny * pitch;
-                    for (int dx = -1; dx <= 1; ++dx) {
-                        if (dx == 0 && dy == 0)
-                            continue;
-                        int nx = cx + dx;
-                        if ((unsigned)nx >= (unsigned)W)
-                            continue;
-                        int nid = ny * W + nx;
-                        if (vis[nid])
-                            continue;
-                        if (!is_black(r2[nx])) {
-                            vis[nid] = 1;
-                            continue;
-                        }
-                        vis[nid] = 1;
-                        stack[sp++] = nid;
-                    }
-                }
-            }
-
-            int bw = maxx - minx + 1;
-            int bh = maxy - miny + 1;
+    for (int i = 0; i < cc->n; ++i) {
+        int bw = cc->maxx[i] - cc->minx[i] + 1;
+        int bh = cc->maxy[i] - cc->miny[i] + 1;
+
+        /* Candidat "grille avec traits" si composante assez grosse */
+        if (bw >= W / 10 && bh >= H / 10 && cc->area[i] > bestA) {
+            bestA     = cc->area[i];
+            best.x    = cc->minx[i];
+            best.y    = cc->miny[i];
+            best.w    = bw;
+            best.h    = bh;
+        }
 
-            /* Candidat "grille avec traits" si composante assez grosse */
-            if (bw >= W / 10 && bh >= H / 10 && area > bestA) {
-                bestA     = area;
-                best.x    = minx;
-                best.y    = miny;
-                best.w    = bw;
-                best.h    = bh;
-            }
+        /* Stockage des petites composantes (lettres) pour fallback CAS 2 */
+        if (cc->area[i] >= minLetterArea) {
+            components_append(letters, cc, i);   /* place déjà réservée */
 
-            /* Stockage des petites composantes (lettres) pour fallback CAS 2 */
-            if (area >= minLetterArea && ncomp < max_comp) {
-                comps[ncomp].minx = minx;
-                comps[ncomp].maxx = maxx;
-                comps[ncomp].miny = miny;
-                comps[ncomp].maxy = maxy;
-                comps[ncomp].area = area;
-                comps[ncomp].cx   = 0.5f * (float)(minx + maxx);
-                comps[ncomp].cy   = 0.5f * (float)(miny + maxy);
-                ncomp++;
-
-                if (minx < ggminx) ggminx = minx;
-                if (maxx > ggmaxx) ggmaxx = maxx;
-                if (miny < ggminy) ggminy = miny;
-                if (maxy > ggmaxy) ggmaxy = maxy;
-            }
+            if (cc->minx[i] < ggminx) ggminx = cc->minx[i];
+            if (cc->maxx[i] > ggmaxx) ggmaxx = cc->maxx[i];
+            if (cc->miny[i] < ggminy) ggminy = cc->miny[i];
+            if (cc->maxy[i] > ggmaxy) ggmaxy = cc->maxy[i];
         }
     }
 
-    free(vis);
-    free(stack);
-
     *bestBox   = best;
     *bestArea  = bestA;
-    *comps_out = comps;
-    *ncomp_out = ncomp;
     *gminx     = ggminx;
     *gmaxx     = ggmaxx;
     *gminy     = ggminy;
@@ -301,7 +223,7 @@ static int flood_fill_components(SDL_Surface *s32,
  *  Helper 2 : CAS 1 – grande grille avec traits → liste à droite/gauche
  * ============================================================================
  */
-static void detect_case1_grid_list(const Uint32 *P, int pitch, int W, 
+static void detect_case1_grid_list(const InkProfile *ink, int W,
                                    const SDL_Rect *bestBox,
                                    SDL_Rect *grid, SDL_Rect *list)
 {
@@ -318,14 +240,14 @@ static void detect_case1_grid_list(const Uint32 *P, int pitch, int W,
     int rx0 = G.x + G.w + margin;
     int rx1 = W - 1 - margin;
     if (rx0 <= rx1)
-        find_dense_band(P, pitch, y1, y2, rx0, rx1, &L);
+        find_dense_band(ink, y1, y2, rx0, rx1, &L);
 
     /* Si rien à droite, tente à gauche */
     if (L.w <= 0 || L.h <= 0) {
         int lx0 = margin;
         int lx1 = G.x - margin - 1;
         if (lx0 <= lx1)
-            find_dense_band(P, pitch, y1, y2, lx0, lx1, &L);
+            find_dense_band(ink, y1, y2, lx0, lx1, &L);
     }
 
     if (L.w > 0 && L.h > 0) {
@@ -365,8 +287,8 @@ static void detect_case1_grid_list(const Uint32 *P, int pitch, int W,
  *   - checks de fiabilité (taille, overlap vertical, largeur relative)
  *   - ajustements horizontaux + extension de la grille
  */
-static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
-                                      Comp *comps, int ncomp,
+static void detect_case2_letters_only(const InkProfile *ink, int W, int H,
+                                      ComponentList *comps,
                                       int gminx, int gmaxx, int gminy, int gmaxy,
                                       SDL_Rect *grid, SDL_Rect *list)
 {
@@ -392,14 +314,26 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
     }
 
     /* Trie par centre horizontal (cx) : gauche→droite */
-    qsort(comps, (size_t)ncomp, sizeof(Comp), cmp_comp_cx);
+    if (sort_by_cx(comps) != 0) {
+        /* mémoire : pas de split, tout = grille */
+        grid->x = gminx;
+        grid->y = gminy;
+        grid->w = globalW;
+        grid->h = globalH;
+        list->x = list->y = list->w = list->h = 0;
+        return;
+    }
+
+    int ncomp = comps->n;
+    const float *cx = comps->cx;
+    const float *cy = comps->cy;
 
     /* Cherche le plus gros "gap" entre deux comp. consécutives */
     int   bestSplit = -1;
     float bestGap   = 0.0f;
 
     for (int i = 0; i < ncomp - 1; ++i) {
-        float gap = comps[i + 1].cx - comps[i].cx;
+        float gap = cx[i + 1] - cx[i];
         if (gap > bestGap) {
             bestGap   = gap;
             bestSplit = i;
@@ -429,8 +363,8 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
 
     /* Stats sur chaque côté du split */
     ClusterStats left, right;
-    stats_range(comps, ncomp, 0,           bestSplit,   &left,  W, H);
-    stats_range(comps, ncomp, bestSplit+1, ncomp - 1,   &right, W, H);
+    stats_range(comps, 0,           bestSplit,   &left);
+    stats_range(comps, bestSplit+1, ncomp - 1,   &right);
 
     if (left.count < 4 || right.count < 2) {
         /* pas assez de lettres d’un côté → on ne sépare pas */
@@ -497,8 +431,8 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
     }
 
     /* Coupure à mi-distance dans le gap */
-    float cxLeft  = comps[bestSplit].cx;
-    float cxRight = comps[bestSplit + 1].cx;
+    float cxLeft  = cx[bestSplit];
+    float cxRight = cx[bestSplit + 1];
     float midx_f  = 0.5f * (cxLeft + cxRight);
     int   midx    = (int)floorf(midx_f);
 
@@ -596,13 +530,7 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
             if (col) {
                 int cmax = 0;
                 for (int ix = 0; ix < Wg; ++ix) {
-                    int x = x0 + ix;
-                    int c = 0;
-                    for (int y = y0; y <= y1; ++y) {
-                        Uint32 v = P[y * pitch + x];
-                        if (is_black(v))
-                            c++;
-                    }
+                    int c = ink_rect(ink, x0 + ix, y0, x0 + ix, y1);
                     col[ix] = c;
                     if (c > cmax) cmax = c;
                 }
@@ -650,21 +578,19 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
         int    cnt_dx    = 0;
 
         for (int i = 0; i < ncomp; ++i) {
-            float cx = comps[i].cx;
-            float cy = comps[i].cy;
-            if (cx < gx0 || cx > gx1) continue;
-            if (cy < gy0 || cy > gy1) continue;
+            if (cx[i] < gx0 || cx[i] > gx1) continue;
+            if (cy[i] < gy0 || cy[i] > gy1) continue;
 
             if (!have_prev) {
-                prev_cx   = cx;
+                prev_cx   = cx[i];
                 have_prev = 1;
             } else {
-                double d = (double)(cx - prev_cx);
+                double d = (double)(cx[i] - prev_cx);
                 if (d > 0.5) {
                     sum_dx += d;
                     cnt_dx++;
                 }
-                prev_cx = cx;
+                prev_cx = cx[i];
             }
         }
 
@@ -703,6 +629,322 @@ static void detect_case2_letters_only(const Uint32 *P, int pitch, int W, int H,
     *list = Lrect;
 }
 
+/* ============================================================================
+ *  Redressement à partir des centres des lettres
+ * ============================================================================
+ *
+ * Sur une page de mots mêlés les lettres forment un réseau régulier : l'angle
+ * se lit directement sur leurs centres, sans transformée de Hough.
+ *   1) lettres : composantes de hauteur proche de la médiane
+ *   2) angle grossier : direction des plus proches voisins, repliée modulo
+ *      90°, histogramme au demi-degré
+ *   3) dans le repère tourné de cet angle : regroupement en lignes (y') et en
+ *      colonnes (x'), pente commune par moindres carrés avec rejet itératif
+ *      des points à plus de 2.5 sigma (MAD)
+ *   4) ajustement jugé fiable si assez de points, résidu faible devant la
+ *      hauteur des lettres et lignes / colonnes d'accord
+ */
+
+#define DESKEW_MIN_LETTERS 12   /* points retenus au minimum */
+#define DESKEW_NN          4    /* voisins par lettre pour l'angle grossier */
+#define DESKEW_HIST_BINS   180  /* demi-degrés sur [-45°, 45°) */
+#define DESKEW_MAX_RMS     0.12 /* résidu max (en hauteur de lettre) */
+#define DESKEW_MAX_SPLIT   0.5  /* écart max lignes / colonnes (degrés) */
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    double x, y;
+} LetterPt;
+
+static int cmp_int(const void *a, const void *b)
+{
+    int A = *(const int *)a, B = *(const int *)b;
+    return (A > B) - (A < B);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double A = *(const double *)a, B = *(const double *)b;
+    return (A > B) - (A < B);
+}
+
+static int cmp_pt_x(const void *a, const void *b)
+{
+    return cmp_double(&((const LetterPt *)a)->x, &((const LetterPt *)b)->x);
+}
+
+/* Angle replié dans [-45°, 45°) */
+static double fold90(double deg)
+{
+    return deg - 90.0 * floor((deg + 45.0) / 90.0);
+}
+
+/* Angle grossier du réseau (degrés, repère image, y vers le bas) à partir
+ * des DESKEW_NN plus proches voisins de chaque point (p trié par x).
+ * Retourne 0, ou -1 si aucun voisin. */
+static int lattice_coarse_angle(const LetterPt *p, int n, double hmed,
+                                double *angle)
+{
+    double R = 4.0 * hmed;          /* rayon de recherche */
+    double dmin2 = 0.09 * hmed * hmed;
+
+    double *ang = (double *)malloc(sizeof(double) * (size_t)n * DESKEW_NN);
+    if (!ang)
+        return -1;
+    int nang = 0;
+    double hist[DESKEW_HIST_BINS] = {0};
+
+    for (int i = 0; i < n; ++i) {
+        double bd[DESKEW_NN];
+        int    bj[DESKEW_NN];
+        int    k = 0;
+
+        for (int dir = -1; dir <= 1; dir += 2) {
+            for (int j = i + dir; j >= 0 && j < n; j += dir) {
+                double dx = p[j].x - p[i].x;
+                if (fabs(dx) > R)
+                    break;
+                double dy = p[j].y - p[i].y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 < dmin2 || d2 > R * R)
+                    continue;
+                /* insertion dans les k meilleurs */
+                if (k < DESKEW_NN) {
+                    k++;
+                } else if (d2 >= bd[k - 1]) {
+                    continue;
+                }
+                int m = k - 1;
+                while (m > 0 && bd[m - 1] > d2) {
+                    bd[m] = bd[m - 1];
+                    bj[m] = bj[m - 1];
+                    m--;
+                }
+                bd[m] = d2;
+                bj[m] = j;
+            }
+        }
+
+        for (int m = 0; m < k; ++m) {
+            double a = fold90(atan2(p[bj[m]].y - p[i].y, p[bj[m]].x - p[i].x)
+                              * 180.0 / M_PI);
+            int b = (int)((a + 45.0) * 2.0);
+            if (b < 0) b = 0;
+            if (b >= DESKEW_HIST_BINS) b = DESKEW_HIST_BINS - 1;
+            hist[b] += 1.0;
+            ang[nang++] = a;
+        }
+    }
+
+    if (nang == 0) {
+        free(ang);
+        return -1;
+    }
+
+    /* Mode de l'histogramme lissé [1 2 1] (circulaire) */
+    int best = 0;
+    double bestV = -1.0;
+    for (int b = 0; b < DESKEW_HIST_BINS; ++b) {
+        double v = hist[(b + DESKEW_HIST_BINS - 1) % DESKEW_HIST_BINS]
+                 + 2.0 * hist[b]
+                 + hist[(b + 1) % DESKEW_HIST_BINS];
+        if (v > bestV) {
+            bestV = v;
+            best = b;
+        }
+    }
+    double mode = -45.0 + 0.5 * best + 0.25;
+
+    /* Moyenne des directions à moins de 2° du mode */
+    double sum = 0.0;
+    int cnt = 0;
+    for (int i = 0; i < nang; ++i) {
+        double d = fold90(ang[i] - mode);
+        if (fabs(d) <= 2.0) {
+            sum += d;
+            cnt++;
+        }
+    }
+    free(ang);
+
+    *angle = mode + (cnt ? sum / cnt : 0.0);
+    return 0;
+}
+
+typedef struct {
+    double v;
+    int    i;
+} VKey;
+
+static int cmp_vkey(const void *a, const void *b)
+{
+    const VKey *A = (const VKey *)a;
+    const VKey *B = (const VKey *)b;
+    if (A->v < B->v) return -1;
+    if (A->v > B->v) return 1;
+    return (A->i > B->i) - (A->i < B->i);
+}
+
+typedef struct {
+    double slope;   /* dv / du commune à toutes les lignes */
+    double suu;     /* poids : somme des (u - moyenne)^2 des points gardés */
+    double rms;     /* résidu des points gardés */
+    int    inliers;
+    int    lines;   /* lignes avec au moins 3 points gardés */
+} LineFit;
+
+/* Pente commune des alignements de points (u le long, v en travers) :
+ * points regroupés par v (écart > gap entre deux groupes), groupes trop
+ * courts ou trop épais ignorés, puis moindres carrés robustes.
+ * Retourne 0, ou -1 si rien d'exploitable. */
+static int fit_parallel_lines(const double *u, const double *v, int n,
+                              double hmed, LineFit *fit)
+{
+    double gap = 0.5 * hmed;
+
+    int    *ord   = (int *)malloc(sizeof(int) * (size_t)n);
+    int    *grp   = (int *)malloc(sizeof(int) * (size_t)n); /* début du groupe */
+    char   *keep  = (char *)malloc((size_t)n);
+    double *res   = (double *)malloc(sizeof(double) * (size_t)n);
+    double *tmp   = (double *)malloc(sizeof(double) * (size_t)n);
+    if (!ord || !grp || !keep || !res || !tmp) {
+        free(ord); free(grp); free(keep); free(res); free(tmp);
+        return -1;
+    }
+
+    /* Tri par v */
+    VKey *key = (VKey *)malloc(sizeof(VKey) * (size_t)n);
+    if (!key) {
+        free(ord); free(grp); free(keep); free(res); free(tmp);
+        return -1;
+    }
+    for (int i = 0; i < n; ++i) {
+        key[i].v = v[i];
+        key[i].i = i;
+    }
+    qsort(key, (size_t)n, sizeof(VKey), cmp_vkey);
+    for (int i = 0; i < n; ++i)
+        ord[i] = key[i].i;
+    free(key);
+
+    /* Groupes contigus dans l'ordre trié ; grp[k] = début, -1 si rejeté */
+    int start = 0;
+    for (int k = 1; k <= n; ++k) {
+        if (k < n && v[ord[k]] - v[ord[k - 1]] <= gap)
+            continue;
+        int cnt = k - start;
+        double umin = 1e300, umax = -1e300, sv = 0.0, svv = 0.0;
+        for (int m = start; m < k; ++m) {
+            double uu = u[ord[m]], vv = v[ord[m]];
+            if (uu < umin) umin = uu;
+            if (uu > umax) umax = uu;
+            sv += vv;
+            svv += vv * vv;
+        }
+        double var = cnt ? svv / cnt - (sv / cnt) * (sv / cnt) : 0.0;
+        int ok = cnt >= 3 && umax - umin >= 3.0 * hmed
+              && var <= (0.35 * hmed) * (0.35 * hmed);
+        for (int m = start; m < k; ++m) {
+            grp[m]  = ok ? start : -1;
+            keep[m] = (char)ok;
+        }
+        start = k;
+    }
+
+    double slope = 0.0, suu = 0.0, rms = 0.0;
+    int inliers = 0, lines = 0;
+
+    for (int iter = 0; iter < 4; ++iter) {
+        /* Pente commune : sommes centrées groupe par groupe */
+        double Suv = 0.0, Suu = 0.0;
+        for (int a = 0; a < n; ) {
+            int b = a + 1;
+            while (b < n && grp[b] == grp[a]) b++;
+            if (grp[a] >= 0) {
+                double su = 0.0, sv = 0.0;
+                int c = 0;
+                for (int m = a; m < b; ++m)
+                    if (keep[m]) { su += u[ord[m]]; sv += v[ord[m]]; c++; }
+                if (c >= 2) {
+                    su /= c; sv /= c;
+                    for (int m = a; m < b; ++m) {
+                        if (!keep[m]) continue;
+                        double du = u[ord[m]] - su;
+                        Suv += du * (v[ord[m]] - sv);
+                        Suu += du * du;
+                    }
+                }
+            }
+            a = b;
+        }
+        if (Suu <= 0.0)
+            break;
+        slope = Suv / Suu;
+        suu = Suu;
+
+        /* Résidus par rapport à la droite de chaque groupe */
+        int nr = 0;
+        for (int a = 0; a < n; ) {
+            int b = a + 1;
+            while (b < n && grp[b] == grp[a]) b++;
+            if (grp[a] >= 0) {
+                double su = 0.0, sv = 0.0;
+                int c = 0;
+                for (int m = a; m < b; ++m)
+                    if (keep[m]) { su += u[ord[m]]; sv += v[ord[m]]; c++; }
+                if (c) { su /= c; sv /= c; }
+                for (int m = a; m < b; ++m) {
+                    res[m] = v[ord[m]] - sv - slope * (u[ord[m]] - su);
+                    tmp[nr++] = fabs(res[m]);
+                }
+            }
+            a = b;
+        }
+
+        /* Rejet à 2.5 sigma robuste (au moins un demi-pixel) */
+        qsort(tmp, (size_t)nr, sizeof(double), cmp_double);
+        double sigma = 1.4826 * tmp[nr / 2];
+        double lim = 2.5 * sigma;
+        if (lim < 0.5) lim = 0.5;
+
+        inliers = 0;
+        lines = 0;
+        double sr = 0.0;
+        for (int a = 0; a < n; ) {
+            int b = a + 1;
+            while (b < n && grp[b] == grp[a]) b++;
+            if (grp[a] >= 0) {
+                int c = 0;
+                for (int m = a; m < b; ++m) {
+                    keep[m] = (char)(fabs(res[m]) <= lim);
+                    if (keep[m]) {
+                        c++;
+                        sr += res[m] * res[m];
+                    }
+                }
+                inliers += c;
+                if (c >= 3) lines++;
+            }
+            a = b;
+        }
+        rms = inliers ? sqrt(sr / inliers) : 0.0;
+    }
+
+    free(ord); free(grp); free(keep); free(res); free(tmp);
+
+    if (suu <= 0.0 || lines == 0)
+        return -1;
+    fit->slope   = slope;
+    fit->suu     = suu;
+    fit->rms     = rms;
+    fit->inliers = inliers;
+    fit->lines   = lines;
+    return 0;
+}
+
 /* ============================================================================
  *  API principale : detect_grid_and_list
  * ============================================================================
@@ -712,58 +954,661 @@ int detect_grid_and_list(SDL_Surface *src, SDL_Rect *grid, SDL_Rect *list)
     if (!src || !grid || !list)
         return -1;
 
-    SDL_Surface *s32 = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
-    if (!s32)
+    GrayImage *img = gray_from_surface(src);
+    if (!img)
+        return -1;
+
+    int ret = detect_grid_and_list_gray(img, grid, list);
+
+    gray_free(img);
+    return ret;
+}
+
+int detect_grid_and_list_gray(const GrayImage *img, SDL_Rect *grid, SDL_Rect *list)
+{
+    if (!img || !grid || !list)
+        return -1;
+
+    ComponentList cc;
+    if (components_label(img, &cc) != 0)
         return -1;
-    if (SDL_LockSurface(s32) != 0) {
-        SDL_FreeSurface(s32);
+
+    int ret = detect_grid_and_list_components(img, &cc, NULL, grid, list);
+
+    components_free(&cc);
+    return ret;
+}
+
+int detect_grid_and_list_components(const GrayImage *img, const ComponentList *cc,
+                                    const InkProfile *ink, SDL_Rect *grid,
+                                    SDL_Rect *list)
+{
+    if (!img || !cc || !grid || !list)
         return -1;
-    }
 
-    const Uint32 *P = (const Uint32 *)s32->pixels;
-    int pitch = s32->pitch / 4;
-    int W = s32->w;
-    int H = s32->h;
+    int W = img->w;
+    int H = img->h;
 
     SDL_Rect bestBox;
     int bestArea = 0;
-    Comp *comps = NULL;
-    int ncomp = 0;
+    ComponentList comps = {0};
     int gminx, gmaxx, gminy, gmaxy;
 
-    if (flood_fill_components(s32,
-                              &bestBox, &bestArea,
-                              &comps, &ncomp,
-                              &gminx, &gmaxx, &gminy, &gmaxy) != 0) {
-        SDL_UnlockSurface(s32);
-        SDL_FreeSurface(s32);
+    if (split_components(cc, W, H,
+                         &bestBox, &bestArea,
+                         &comps,
+                         &gminx, &gmaxx, &gminy, &gmaxy) != 0) {
+        components_free(&comps);
         return -1;
     }
 
+    /* Comptes de noir par rectangle : profil fourni, sinon une passe */
+    InkProfile *own = NULL;
+    if (!ink) {
+        ink = own = ink_profile_gray(img, 128);
+        if (!ink) {
+            components_free(&comps);
+            return -1;
+        }
+    }
+
     int ret = 0;
 
     if (bestArea > 0) {
         /* ===================== CAS 1 : grande grille avec traits ===================== */
-        detect_case1_grid_list(P, pitch, W, &bestBox, grid, list);
+        detect_case1_grid_list(ink, W, &bestBox, grid, list);
     } else {
         /* ===================== CAS 2 : fallback lettres seules ===================== */
 
-        if (ncomp == 0) {
+        if (comps.n == 0) {
             /* aucune lettre → erreur */
             grid->x = grid->y = grid->w = grid->h = 0;
             list->x = list->y = list->w = list->h = 0;
             ret = -1;
         } else {
-            detect_case2_letters_only(P, pitch, W, H,
-                                      comps, ncomp,
+            detect_case2_letters_only(ink, W, H,
+                                      &comps,
                                       gminx, gmaxx, gminy, gmaxy,
                                       grid, list);
         }
     }
 
-    free(comps);
-    SDL_UnlockSurface(s32);
-    SDL_FreeSurface(s32);
+    ink_profile_free(own);
+    components_free(&comps);
+
+    return ret;
+}
+
+/* ============================================================================
+ *  API : plusieurs puzzles sur une page
+ * ============================================================================
+ *
+ * Pages de cahier d'activités : plusieurs puzzles (grille + liste) séparés
+ * par des marges blanches.
+ *   1) découpage XY récursif aux gouttières blanches d'au moins
+ *      PUZZLE_GUTTER hauteurs de lettre, coupées en leur milieu : les
+ *      cellules obtenues partitionnent la page
+ *   2) detect_grid_and_list_gray sur chaque cellule ; c'est un puzzle si
+ *      les lettres de la grille trouvée forment un réseau (assez de lignes,
+ *      autant de lettres sur chacune, colonnes alignées)
+ *   3) les autres cellules (liste écartée de sa grille, titre) rejoignent
+ *      le puzzle le plus proche, tant que la zone ne recouvre pas une autre
+ *      grille
+ * Avec moins de deux puzzles, la page entière en est un : même résultat
+ * que detect_grid_and_list_components.
+ */
+
+#define PUZZLE_MAX_BLOCKS 64    /* blocs du découpage au plus */
+#define PUZZLE_GUTTER     3.0   /* gouttière min (en hauteur de lettre) */
+#define PUZZLE_MIN_GUTTER 8     /* ... et en pixels */
+#define PUZZLE_MIN_LINES  4     /* lignes / colonnes d'une grille au minimum */
+
+typedef struct {
+    SDL_Rect cell;   /* cellule du découpage */
+    SDL_Rect box;    /* boîte de l'encre de la cellule */
+    int      puzzle; /* indice du puzzle, -1 si le bloc n'en est pas un */
+} PageBlock;
+
+/* Boîte de l'encre de r ; 0 si r est blanc. */
+static int ink_bbox(const InkProfile *ink, SDL_Rect r, SDL_Rect *box)
+{
+    int x0 = r.x, x1 = r.x + r.w - 1;
+    int y0 = r.y, y1 = r.y + r.h - 1;
+    if (ink_rect(ink, x0, y0, x1, y1) == 0)
+        return 0;
+
+    while (ink_rect(ink, x0, y0, x0, y1) == 0) x0++;
+    while (ink_rect(ink, x1, y0, x1, y1) == 0) x1--;
+    while (ink_rect(ink, x0, y0, x1, y0) == 0) y0++;
+    while (ink_rect(ink, x0, y1, x1, y1) == 0) y1--;
+
+    *box = (SDL_Rect){ x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+    return 1;
+}
+
+/* Milieux des gouttières (colonnes blanches si vertical, lignes sinon) d'au
+ * moins gutter pixels à l'intérieur de box. Retourne leur nombre. */
+static int find_gutters(const InkProfile *ink, SDL_Rect box, int vertical,
+                        int gutter, int *cuts, int max)
+{
+    int origin = vertical ? box.x : box.y;
+    int len    = vertical ? box.w : box.h;
+    int n = 0, run = 0;
+
+    /* box commence et finit sur de l'encre : pas de marge à ignorer */
+    for (int i = 0; i < len; ++i) {
+        int p = origin + i;
+        int blank = vertical
+            ? ink_rect(ink, p, box.y, p, box.y + box.h - 1) == 0
+            : ink_rect(ink, box.x, p, box.x + box.w - 1, p) == 0;
+        if (blank) {
+            run++;
+            continue;
+        }
+        if (run >= gutter && n < max)
+            cuts[n++] = p - run + run / 2;
+        run = 0;
+    }
+    return n;
+}
+
+/* Découpage XY de cell : colonnes d'abord, puis lignes ; les feuilles vont
+ * dans blocks, dans l'ordre de lecture. */
+static void xy_cut(const InkProfile *ink, SDL_Rect cell, int gutter,
+                   PageBlock *blocks, int *n)
+{
+    SDL_Rect box;
+    if (*n >= PUZZLE_MAX_BLOCKS || !ink_bbox(ink, cell, &box))
+        return;
+
+    int cuts[PUZZLE_MAX_BLOCKS];
+    for (int vertical = 1; vertical >= 0; --vertical) {
+        int nc = find_gutters(ink, box, vertical, gutter, cuts, PUZZLE_MAX_BLOCKS);
+        if (nc == 0)
+            continue;
+
+        int lo  = vertical ? cell.x : cell.y;
+        int end = vertical ? cell.x + cell.w : cell.y + cell.h;
+        for (int k = 0; k <= nc; ++k) {
+            int hi = k < nc ? cuts[k] : end;
+            SDL_Rect sub = cell;
+            if (vertical) { sub.x = lo; sub.w = hi - lo; }
+            else          { sub.y = lo; sub.h = hi - lo; }
+            xy_cut(ink, sub, gutter, blocks, n);
+            lo = hi;
+        }
+        return;
+    }
+
+    blocks[(*n)++] = (PageBlock){ cell, box, -1 };
+}
+
+static int cmp_pt_y(const void *a, const void *b)
+{
+    return cmp_double(&((const LetterPt *)a)->y, &((const LetterPt *)b)->y);
+}
+
+static double median_of(double *v, int n)
+{
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    return v[n / 2];
+}
+
+/* Les lettres de box forment-elles une grille ? Dans une grille le pas
+ * horizontal entre lettres voisines d'une ligne est du même ordre que le
+ * pas entre lignes ; dans une liste les lettres d'un mot se touchent
+ * presque. p, tmp : tableaux de travail de cc->n cases, sizes aussi. */
+static int is_letter_grid(const ComponentList *cc, SDL_Rect box, double hmed,
+                          LetterPt *p, double *tmp, int *sizes)
+{
+    int n = 0;
+    for (int i = 0; i < cc->n; ++i) {
+        int bw = cc->maxx[i] - cc->minx[i] + 1;
+        int bh = cc->maxy[i] - cc->miny[i] + 1;
+        if (cc->area[i] < 10 || bh < 0.5 * hmed || bh > 2.0 * hmed
+            || bw > 3.0 * hmed)
+            continue;
+        if (cc->cx[i] < box.x || cc->cx[i] >= box.x + box.w
+            || cc->cy[i] < box.y || cc->cy[i] >= box.y + box.h)
+            continue;
+        p[n].x = cc->cx[i];
+        p[n].y = cc->cy[i];
+        n++;
+    }
+    if (n < PUZZLE_MIN_LINES * PUZZLE_MIN_LINES)
+        return 0;
+
+    /* Lignes : centres espacés de moins d'une demi-lettre en y ; écarts en
+     * x entre voisins de ligne dans tmp[0..ndx), y des lignes ensuite */
+    qsort(p, (size_t)n, sizeof(LetterPt), cmp_pt_y);
+    int rows = 0, ndx = 0;
+    for (int s = 0, e; s < n; s = e) {
+        for (e = s + 1; e < n && p[e].y - p[e - 1].y <= 0.5 * hmed; ++e)
+            ;
+        qsort(p + s, (size_t)(e - s), sizeof(LetterPt), cmp_pt_x);
+        for (int i = s + 1; i < e; ++i)
+            tmp[ndx++] = p[i].x - p[i - 1].x;
+        sizes[rows] = e - s;
+        p[rows].y = p[s + (e - s) / 2].y;   /* p[0..s) déjà lu */
+        rows++;
+    }
+    if (rows < PUZZLE_MIN_LINES || ndx == 0)
+        return 0;
+
+    /* Autant de lettres (à 25 % près) sur les deux tiers des lignes */
+    qsort(sizes, (size_t)rows, sizeof(int), cmp_int);
+    int per_row = sizes[rows / 2];
+    int regular = 0;
+    for (int r = 0; r < rows; ++r)
+        regular += 4 * abs(sizes[r] - per_row) <= per_row;
+
+    double *dy = tmp + ndx;
+    for (int r = 1; r < rows; ++r)
+        dy[r - 1] = p[r].y - p[r - 1].y;
+    double pitch_x = median_of(tmp, ndx);
+    double pitch_y = median_of(dy, rows - 1);
+
+    return per_row >= PUZZLE_MIN_LINES && 3 * regular >= 2 * rows
+        && 5.0 * pitch_x >= 3.0 * pitch_y && 3.0 * pitch_x <= 5.0 * pitch_y;
+}
+
+static SDL_Rect rect_union(SDL_Rect a, SDL_Rect b)
+{
+    int x0 = a.x < b.x ? a.x : b.x;
+    int y0 = a.y < b.y ? a.y : b.y;
+    int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    return (SDL_Rect){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+static int rect_overlap(SDL_Rect a, SDL_Rect b)
+{
+    return a.x < b.x + b.w && b.x < a.x + a.w
+        && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/* Distance² entre deux rectangles (0 s'ils se touchent). */
+static long long rect_dist2(SDL_Rect a, SDL_Rect b)
+{
+    long long dx = 0, dy = 0;
+    if (a.x + a.w < b.x) dx = b.x - (a.x + a.w);
+    else if (b.x + b.w < a.x) dx = a.x - (b.x + b.w);
+    if (a.y + a.h < b.y) dy = b.y - (a.y + a.h);
+    else if (b.y + b.h < a.y) dy = a.y - (b.y + b.h);
+    return dx * dx + dy * dy;
+}
+
+/* Grille et liste de la zone a de la page, ramenées dans le repère de la
+ * page ; les comptes de noir lisent le profil ink de la page. Retourne 0,
+ * ou -1 si rien n'est détecté. */
+static int detect_in_area(const GrayImage *img, const InkProfile *ink,
+                          SDL_Rect a, PuzzleRegion *r)
+{
+    GrayImage sub = gray_sub(img, a.x, a.y, a.w, a.h);
+    InkProfile isub = ink_profile_sub(ink, a.x, a.y, a.w, a.h);
+    ComponentList cc;
+    if (components_label(&sub, &cc) != 0)
+        return -1;
+    int ret = detect_grid_and_list_components(&sub, &cc, &isub, &r->grid,
+                                              &r->list);
+    components_free(&cc);
+    if (ret != 0)
+        return -1;
+
+    r->area = a;
+    r->grid.x += a.x;
+    r->grid.y += a.y;
+    if (r->list.w > 0 && r->list.h > 0) {
+        r->list.x += a.x;
+        r->list.y += a.y;
+    }
+    return 0;
+}
+
+/* Rattache chaque bloc sans grille au puzzle dont la grille est la plus
+ * proche, si la zone agrandie ne recouvre aucune autre grille (sinon le
+ * bloc est ignoré). Les zones rattachées sont redétectées. */
+static void attach_blocks(const GrayImage *img, const InkProfile *ink,
+                          const PageBlock *blocks, int nb,
+                          PuzzleRegion *reg, int np)
+{
+    SDL_Rect areas[PUZZLE_MAX_BLOCKS];
+    int grown[PUZZLE_MAX_BLOCKS] = {0};
+    for (int p = 0; p < np; ++p)
+        areas[p] = reg[p].area;
+
+    for (int b = 0; b < nb; ++b) {
+        if (blocks[b].puzzle >= 0)
+            continue;
+
+        unsigned long long tried = 0;   /* np <= PUZZLE_MAX_BLOCKS */
+        for (int k = 0; k < np; ++k) {
+            int best = -1;
+            long long bestD = 0;
+            for (int p = 0; p < np; ++p) {
+                if (tried & (1ULL << p))
+                    continue;
+                long long d = rect_dist2(blocks[b].box, reg[p].grid);
+                if (best < 0 || d < bestD) {
+                    best  = p;
+                    bestD = d;
+                }
+            }
+            tried |= 1ULL << best;
+
+            SDL_Rect area = rect_union(areas[best], blocks[b].cell);
+            int clear = 1;
+            for (int p = 0; p < np && clear; ++p)
+                if (p != best && rect_overlap(area, reg[p].grid))
+                    clear = 0;
+            if (clear) {
+                areas[best] = area;
+                grown[best] = 1;
+                break;
+            }
+        }
+    }
+
+    /* Échec de la redétection : on garde la zone d'origine */
+    for (int p = 0; p < np; ++p) {
+        PuzzleRegion r;
+        if (grown[p] && detect_in_area(img, ink, areas[p], &r) == 0)
+            reg[p] = r;
+    }
+}
 
+/* Découpe la page en puzzles. Retourne le nombre de zones trouvées (*out
+ * alloué), 0 si la page ne compte pas au moins deux puzzles, -1 si erreur. */
+static int split_puzzles(const GrayImage *img, const ComponentList *cc,
+                         const InkProfile *ink, PuzzleRegion **out)
+{
+    /* 1) Hauteur médiane des lettres → largeur des gouttières */
+    int *hs = (int *)malloc(sizeof(int) * (size_t)(cc->n + 1));
+    if (!hs)
+        return -1;
+    int nl = 0;
+    for (int i = 0; i < cc->n; ++i)
+        if (cc->area[i] >= 10)
+            hs[nl++] = cc->maxy[i] - cc->miny[i] + 1;
+    if (nl < 2 * PUZZLE_MIN_LINES * PUZZLE_MIN_LINES) {
+        free(hs);
+        return 0;
+    }
+    qsort(hs, (size_t)nl, sizeof(int), cmp_int);
+    double hmed = hs[nl / 2];
+    free(hs);
+
+    int gutter = (int)(PUZZLE_GUTTER * hmed + 0.5);
+    if (gutter < PUZZLE_MIN_GUTTER)
+        gutter = PUZZLE_MIN_GUTTER;
+
+    /* 2) Blocs séparés par des gouttières */
+    PageBlock blocks[PUZZLE_MAX_BLOCKS];
+    int nb = 0;
+    xy_cut(ink, (SDL_Rect){ 0, 0, img->w, img->h }, gutter, blocks, &nb);
+    if (nb < 2)
+        return 0;
+
+    /* 3) Puzzles : blocs dont la grille détectée est un réseau de lettres */
+    PuzzleRegion *reg = (PuzzleRegion *)malloc(sizeof(PuzzleRegion) * (size_t)nb);
+    LetterPt *pts = (LetterPt *)malloc(sizeof(LetterPt) * (size_t)cc->n);
+    double *tmp = (double *)malloc(sizeof(double) * (size_t)cc->n);
+    int *sizes = (int *)malloc(sizeof(int) * (size_t)cc->n);
+    if (!reg || !pts || !tmp || !sizes) {
+        free(reg);
+        free(pts);
+        free(tmp);
+        free(sizes);
+        return -1;
+    }
+    int np = 0;
+    for (int b = 0; b < nb; ++b) {
+        if (detect_in_area(img, ink, blocks[b].cell, &reg[np]) == 0
+            && is_letter_grid(cc, reg[np].grid, hmed, pts, tmp, sizes))
+            blocks[b].puzzle = np++;
+    }
+    free(pts);
+    free(tmp);
+    free(sizes);
+    if (np < 2) {
+        free(reg);
+        return 0;
+    }
+
+    /* 4) Listes séparées de leur grille, titres : au puzzle le plus proche */
+    attach_blocks(img, ink, blocks, nb, reg, np);
+
+    *out = reg;
+    return np;
+}
+
+int detect_puzzles_gray(const GrayImage *img, const ComponentList *cc,
+                        PuzzleRegion **out, int *count)
+{
+    if (!img || !out || !count)
+        return -1;
+    *out = NULL;
+    *count = 0;
+
+    /* Composantes fournies (déjà étiquetées pour le redressement), sinon
+     * étiquetées ici */
+    ComponentList own = {0};
+    if (!cc) {
+        if (components_label(img, &own) != 0)
+            return -1;
+        cc = &own;
+    }
+
+    /* Profil d'encre de la page, construit une fois pour toutes les zones */
+    InkProfile *ink = ink_profile_gray(img, 128);
+    if (!ink) {
+        components_free(&own);
+        return -1;
+    }
+
+    PuzzleRegion *reg = NULL;
+    int n = split_puzzles(img, cc, ink, &reg);
+
+    /* Un seul puzzle (ou découpage impossible) : la page entière */
+    if (n <= 0) {
+        reg = (PuzzleRegion *)malloc(sizeof(PuzzleRegion));
+        if (!reg || detect_grid_and_list_components(img, cc, ink, &reg->grid,
+                                                    &reg->list) != 0) {
+            free(reg);
+            ink_profile_free(ink);
+            components_free(&own);
+            return -1;
+        }
+        reg->area = (SDL_Rect){ 0, 0, img->w, img->h };
+        n = 1;
+    }
+
+    ink_profile_free(ink);
+    components_free(&own);
+    *out = reg;
+    *count = n;
+    return 0;
+}
+
+/* ============================================================================
+ *  API : redressement
+ * ============================================================================
+ */
+static DeskewMethod deskew_method = DESKEW_LETTERS;
+
+void set_deskew_method(DeskewMethod method)
+{
+    deskew_method = method;
+}
+
+DeskewMethod get_deskew_method(void)
+{
+    return deskew_method;
+}
+
+const char *deskew_method_name(DeskewMethod method)
+{
+    switch (method) {
+    case DESKEW_LETTERS: return "letters";
+    case DESKEW_HOUGH:   return "hough";
+    }
+    return "?";
+}
+
+/* Étapes 2 à 4 sur les centres p (n >= DESKEW_MIN_LETTERS).
+ * Retourne 0 et la correction dans *angle, -1 si l'ajustement est mauvais. */
+static int fit_letter_lattice(LetterPt *p, int n, double hmed, double *angle)
+{
+    /* 2) Angle grossier du réseau */
+    double coarse;
+    qsort(p, (size_t)n, sizeof(LetterPt), cmp_pt_x);
+    if (lattice_coarse_angle(p, n, hmed, &coarse) != 0)
+        return -1;
+
+    /* 3) Lignes puis colonnes dans le repère tourné de l'angle grossier */
+    double *u = (double *)malloc(sizeof(double) * (size_t)n);
+    double *v = (double *)malloc(sizeof(double) * (size_t)n);
+    if (!u || !v) {
+        free(u);
+        free(v);
+        return -1;
+    }
+    double c = cos(coarse * M_PI / 180.0), s = sin(coarse * M_PI / 180.0);
+    for (int i = 0; i < n; ++i) {
+        u[i] =  p[i].x * c + p[i].y * s;
+        v[i] = -p[i].x * s + p[i].y * c;
+    }
+    LineFit rows, cols;
+    int has_rows = fit_parallel_lines(u, v, n, hmed, &rows) == 0;
+    int has_cols = fit_parallel_lines(v, u, n, hmed, &cols) == 0;
+    free(u);
+    free(v);
+
+    /* 4) Fiabilité */
+    double wsum = 0.0, dsum = 0.0;
+    double dr = 0.0, dc = 0.0;
+    int inliers = 0, lines = 0;
+    if (has_rows) {
+        if (rows.rms > DESKEW_MAX_RMS * hmed)
+            return -1;
+        dr = atan(rows.slope) * 180.0 / M_PI;
+        wsum += rows.suu;
+        dsum += rows.suu * dr;
+        inliers += rows.inliers;
+        lines += rows.lines;
+    }
+    if (has_cols) {
+        if (cols.rms > DESKEW_MAX_RMS * hmed)
+            return -1;
+        dc = -atan(cols.slope) * 180.0 / M_PI;   /* x' = -tan(d) y' */
+        wsum += cols.suu;
+        dsum += cols.suu * dc;
+        inliers += cols.inliers;
+        lines += cols.lines;
+    }
+    if (wsum <= 0.0 || inliers < DESKEW_MIN_LETTERS || lines < 2)
+        return -1;
+    if (has_rows && has_cols && rows.lines >= 2 && cols.lines >= 2
+        && fabs(dr - dc) > DESKEW_MAX_SPLIT)
+        return -1;
+
+    /* Les lignes font l'angle phi avec l'horizontale : rotate(-phi) */
+    double corr = -fold90(coarse + dsum / wsum);
+    if (corr < -45.0 + 1e-9)
+        corr += 90.0;
+
+    /* Au pas de la recherche fine de Hough : une page droite donne
+     * exactement 0 et n'est pas rééchantillonnée */
+    *angle = round(corr * 10.0) / 10.0;
+    return 0;
+}
+
+/* Redressement à partir des composantes étiquetées cc de img. */
+static int deskew_from_components(const GrayImage *img, const ComponentList *cc,
+                                  double *angle)
+{
+    SDL_Rect bestBox;
+    int bestArea = 0;
+    ComponentList comps = {0};
+    int gminx, gmaxx, gminy, gmaxy;
+
+    if (split_components(cc, img->w, img->h, &bestBox, &bestArea, &comps,
+                         &gminx, &gmaxx, &gminy, &gmaxy) != 0
+        || comps.n < DESKEW_MIN_LETTERS) {
+        components_free(&comps);
+        return -1;
+    }
+    int ncomp = comps.n;
+
+    /* 1) Hauteur médiane, puis lettres de taille comparable */
+    int *hs = (int *)malloc(sizeof(int) * (size_t)ncomp);
+    LetterPt *p = (LetterPt *)malloc(sizeof(LetterPt) * (size_t)ncomp);
+    if (!hs || !p) {
+        free(hs);
+        free(p);
+        components_free(&comps);
+        return -1;
+    }
+    for (int i = 0; i < ncomp; ++i)
+        hs[i] = comps.maxy[i] - comps.miny[i] + 1;
+    qsort(hs, (size_t)ncomp, sizeof(int), cmp_int);
+    double hmed = hs[ncomp / 2];
+    free(hs);
+
+    int n = 0;
+    for (int i = 0; i < ncomp; ++i) {
+        int bw = comps.maxx[i] - comps.minx[i] + 1;
+        int bh = comps.maxy[i] - comps.miny[i] + 1;
+        if (bh < 0.5 * hmed || bh > 2.0 * hmed || bw > 3.0 * hmed)
+            continue;
+        p[n].x = comps.cx[i];
+        p[n].y = comps.cy[i];
+        n++;
+    }
+    components_free(&comps);
+
+    int ret = n >= DESKEW_MIN_LETTERS ? fit_letter_lattice(p, n, hmed, angle) : -1;
+    free(p);
     return ret;
 }
+
+int deskew_from_letters_gray(const GrayImage *img, const ComponentList *cc,
+                             double *angle)
+{
+    if (!img || !angle)
+        return -1;
+    if (cc)
+        return deskew_from_components(img, cc, angle);
+
+    ComponentList own;
+    if (components_label(img, &own) != 0)
+        return -1;
+
+    int ret = deskew_from_components(img, &own, angle);
+
+    components_free(&own);
+    return ret;
+}
+
+double estimate_deskew_gray(const GrayImage *img, const ComponentList *cc)
+{
+    double angle;
+    if (deskew_method == DESKEW_LETTERS
+        && deskew_from_letters_gray(img, cc, &angle) == 0)
+        return angle;
+    return auto_deskew_correction_gray(img);
+}
+
+double estimate_deskew(SDL_Surface *src)
+{
+    if (!src)
+        return 0.0;
+
+    GrayImage *img = gray_from_surface(src);
+    if (!img)
+        return 0.0;
+
+    double angle = estimate_deskew_gray(img, NULL);
+    gray_free(img);
+    return angle;
+}
@@ -2,13 +2,16 @@
 #define STRUCTURE_DETECTION_H
 
 #include <SDL2/SDL.h>
+#include "../gray_image/gray_image.h"
+#include "../components/components.h"
+#include "../projection/projection.h"
 
 /*
  * Détection de la zone GRILLE (mots croisés) et de la zone LISTE (mots à trouver)
  * à partir d'une image couleur SDL.
  *
  * Entrée :
- *   - src  : surface SDL (n'importe quel format, sera convertie en ARGB8888)
+ *   - src  : surface SDL (n'importe quel format, réduite à un plan de luminance)
  *
  * Sortie :
  *   - grid : rectangle contenant la grille (en pixels, coordonnées dans src)
@@ -29,4 +32,90 @@
  */
 int detect_grid_and_list(SDL_Surface *src, SDL_Rect *grid, SDL_Rect *list);
 
+/*
+ * Même détection, directement sur le plan de luminance déjà calculé
+ * (pixel "noir" = valeur < 128).
+ */
+int detect_grid_and_list_gray(const GrayImage *img, SDL_Rect *grid, SDL_Rect *list);
+
+/*
+ * Même détection à partir des composantes déjà étiquetées de img
+ * (components_label), pour ne pas refaire l'étiquetage, et du profil
+ * d'encre de img au seuil 128 (ink_profile_gray, ou ink_profile_sub d'une
+ * page) ; ink NULL : le profil est construit ici.
+ */
+int detect_grid_and_list_components(const GrayImage *img, const ComponentList *cc,
+                                    const InkProfile *ink, SDL_Rect *grid,
+                                    SDL_Rect *list);
+
+/*
+ * Plusieurs puzzles sur une même page (cahiers d'activités).
+ *
+ * Zone d'un puzzle, en coordonnées de la page :
+ *   - area : partie de la page attribuée au puzzle
+ *   - grid / list : comme detect_grid_and_list (list peut être vide)
+ */
+typedef struct {
+    SDL_Rect area;
+    SDL_Rect grid;
+    SDL_Rect list;
+} PuzzleRegion;
+
+/*
+ * Découpe la page aux larges marges blanches, repère les blocs en forme de
+ * grille et leur rattache les blocs voisins (listes), puis détecte grille et
+ * liste dans chaque zone. Zones dans l'ordre de lecture.
+ *
+ * Entrée :
+ *   - cc : composantes déjà étiquetées de img (components_label), ou NULL
+ *          pour les étiqueter ici
+ *
+ * Sortie :
+ *   - *out   : tableau de *count zones (à libérer avec free)
+ *   - *count : au moins 1 ; une page à une seule grille donne une zone
+ *              couvrant la page, avec le résultat de detect_grid_and_list_gray
+ *
+ * Retour :
+ *   0  : succès
+ *  -1  : erreur, ou aucune grille trouvée (*out = NULL, *count = 0)
+ */
+int detect_puzzles_gray(const GrayImage *img, const ComponentList *cc,
+                        PuzzleRegion **out, int *count);
+
+/*
+ * Redressement à partir des lettres : droites ajustées (moindres carrés
+ * robustes) sur les centres des composantes, lignes et colonnes du réseau.
+ *
+ * Entrée :
+ *   - cc : composantes déjà étiquetées de img, ou NULL pour les étiqueter
+ *          ici ; l'appelant qui les garde les réutilise pour la détection
+ *          si elle porte sur le même plan (page droite, non réduite)
+ *
+ * Sortie :
+ *   - angle : correction en degrés, même convention que
+ *             auto_deskew_correction_gray() (rotate_gray(img, angle) redresse)
+ *
+ * Retour :
+ *   0  : ajustement fiable
+ *  -1  : trop peu de lettres ou ajustement mauvais (*angle inchangé)
+ */
+int deskew_from_letters_gray(const GrayImage *img, const ComponentList *cc,
+                             double *angle);
+
+/* Méthode de estimate_deskew() : lettres (Hough si l'ajustement est mauvais)
+ * ou Hough seul. Lettres par défaut. */
+typedef enum {
+    DESKEW_LETTERS = 0,
+    DESKEW_HOUGH
+} DeskewMethod;
+
+void set_deskew_method(DeskewMethod method);
+DeskewMethod get_deskew_method(void);
+const char *deskew_method_name(DeskewMethod method);
+
+/* Angle de redressement selon la méthode choisie (cc : comme pour
+ * deskew_from_letters_gray). */
+double estimate_deskew_gray(const GrayImage *img, const ComponentList *cc);
+double estimate_deskew(SDL_Surface *src);
+
 #endif
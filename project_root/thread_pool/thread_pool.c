@@ -0,0 +1,173 @@
+// thread_pool.c
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdint.h>     // uintptr_t
+#include <stdlib.h>     // getenv, atoi
+#include <unistd.h>     // sysconf
+
+/* ---------------------------------------------------------------------------
+ * Pool state
+ *
+ * One job at a time: parallel_for callers are serialized by call_lock, the
+ * job itself is described by the job_* fields and protected by pool_lock.
+ * Workers sleep on work_cv until the generation counter changes, then grab
+ * band indices until none are left; the caller grabs bands too and waits on
+ * done_cv for the stragglers.
+ * -------------------------------------------------------------------------- */
+
+static pthread_mutex_t call_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_cv   = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done_cv   = PTHREAD_COND_INITIALIZER;
+
+static pthread_t workers[THREAD_POOL_MAX];
+static int       nworkers   = 0;    // running worker threads (caller excluded)
+static int       pool_size  = 0;    // 0 : not decided yet
+static int       stopping   = 0;
+static unsigned  generation = 0;
+
+static parallel_fn job_fn;
+static void       *job_ctx;
+static int         job_n;
+static int         job_bands;
+static int         next_band;
+static int         bands_left;
+
+static __thread int in_band = 0;   // set while running a band (nesting guard)
+
+static int decide_pool_size(void)
+{
+    int n = 0;
+    const char *env = getenv("OCR_THREADS");
+    if (env) n = atoi(env);
+    if (n <= 0) n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > THREAD_POOL_MAX) n = THREAD_POOL_MAX;
+    return n;
+}
+
+/* Run bands of the current job until none are left. Called and returns
+ * with pool_lock held. */
+static void run_bands_locked(void)
+{
+    while (next_band < job_bands) {
+        int b = next_band++;
+        parallel_fn fn = job_fn;
+        void *ctx = job_ctx;
+        int begin = parallel_band_begin(job_n, job_bands, b);
+        int end   = parallel_band_begin(job_n, job_bands, b + 1);
+
+        pthread_mutex_unlock(&pool_lock);
+        in_band = 1;
+        fn(ctx, begin, end, b);
+        in_band = 0;
+        pthread_mutex_lock(&pool_lock);
+
+        if (--bands_left == 0) pthread_cond_signal(&done_cv);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    // Generation at spawn time, so a job posted before this thread first
+    // takes the lock is not missed
+    unsigned seen = (unsigned)(uintptr_t)arg;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!stopping && generation == seen)
+            pthread_cond_wait(&work_cv, &pool_lock);
+        if (stopping) break;
+        seen = generation;
+        run_bands_locked();
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+/* Start the workers if needed. Called with call_lock held. */
+static void pool_start(void)
+{
+    if (nworkers > 0 || pool_size <= 1) return;
+
+    pthread_mutex_lock(&pool_lock);
+    stopping = 0;
+    unsigned gen = generation;
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < pool_size - 1; ++i) {
+        if (pthread_create(&workers[i], NULL, worker_main,
+                           (void*)(uintptr_t)gen) != 0) break;
+        nworkers++;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * API
+ * -------------------------------------------------------------------------- */
+
+int thread_pool_size(void)
+{
+    pthread_mutex_lock(&call_lock);
+    if (pool_size == 0) pool_size = decide_pool_size();
+    int n = pool_size;
+    pthread_mutex_unlock(&call_lock);
+    return n;
+}
+
+int parallel_bands(int n, int min_chunk)
+{
+    if (in_band || n <= 0) return 1;
+    if (min_chunk < 1) min_chunk = 1;
+
+    int nb = thread_pool_size();
+    if (nb > n / min_chunk) nb = n / min_chunk;
+    return nb < 1 ? 1 : nb;
+}
+
+void parallel_for(int n, int min_chunk, parallel_fn fn, void *ctx)
+{
+    if (n <= 0) return;
+
+    int nb = parallel_bands(n, min_chunk);
+    if (nb == 1) {
+        fn(ctx, 0, n, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&call_lock);
+    pool_start();
+
+    pthread_mutex_lock(&pool_lock);
+    job_fn = fn;
+    job_ctx = ctx;
+    job_n = n;
+    job_bands = nb;
+    next_band = 0;
+    bands_left = nb;
+    generation++;
+    pthread_cond_broadcast(&work_cv);
+
+    run_bands_locked();
+    while (bands_left > 0)
+        pthread_cond_wait(&done_cv, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&call_lock);
+}
+
+void thread_pool_shutdown(void)
+{
+    pthread_mutex_lock(&call_lock);
+
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&work_cv);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < nworkers; ++i) pthread_join(workers[i], NULL);
+    nworkers = 0;
+
+    pthread_mutex_unlock(&call_lock);
+}
@@ -0,0 +1,35 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/* Upper bound on the number of bands (and threads) of a parallel_for. */
+#define THREAD_POOL_MAX 64
+
+/* Body of a parallel_for: processes [begin, end). band is the index of the
+ * slice (0 .. nbands - 1), usable to address per-band scratch buffers. */
+typedef void (*parallel_fn)(void *ctx, int begin, int end, int band);
+
+/* Number of threads of the pool (including the caller). The pool is created
+ * on first use with one thread per core, or OCR_THREADS if set. */
+int thread_pool_size(void);
+
+/* Number of bands parallel_for(n, min_chunk, ...) will use. */
+int parallel_bands(int n, int min_chunk);
+
+/* First item of band b when [0, n) is split into nbands bands (band b is
+ * [parallel_band_begin(n, nbands, b), parallel_band_begin(n, nbands, b + 1))). */
+static inline int parallel_band_begin(int n, int nbands, int b)
+{
+    return (int)((long long)n * b / nbands);
+}
+
+/* Split [0, n) into parallel_bands(n, min_chunk) contiguous bands of at
+ * least min_chunk items and run fn on each, the caller taking part. Returns
+ * once every band is done. The split only depends on n, min_chunk and the
+ * pool size, so results that are merged in band order are deterministic.
+ * Nested calls from inside a band run serially. */
+void parallel_for(int n, int min_chunk, parallel_fn fn, void *ctx);
+
+/* Stop and join the worker threads (the pool restarts on next use). */
+void thread_pool_shutdown(void);
+
+#endif
@@ -0,0 +1,83 @@
+// tile_batch.c
+#include "tile_batch.h"
+#include "../gray_image/gray_image.h"   // GRAY_ALIGN
+
+#include <stdio.h>      // fprintf
+#include <stdlib.h>     // aligned_alloc, calloc, free
+#include <string.h>     // memset, memcpy
+
+static size_t used_words(int count)
+{
+    return ((size_t)count + 31) / 32;
+}
+
+/* Room for cap tiles; the tiles past count are blank and unused. */
+static int tile_batch_grow(TileBatch *b, int cap)
+{
+    size_t bytes = (size_t)cap * TILE_PIXELS;
+    bytes = (bytes + GRAY_ALIGN - 1) & ~(size_t)(GRAY_ALIGN - 1);
+
+    Uint8 *pixels = aligned_alloc(GRAY_ALIGN, bytes);
+    uint32_t *used = calloc(used_words(cap), sizeof(uint32_t));
+    TileInfo *info = calloc((size_t)cap, sizeof(TileInfo));
+    if (!pixels || !used || !info) {
+        fprintf(stderr, "tile_batch: out of memory\n");
+        free(pixels);
+        free(used);
+        free(info);
+        return -1;
+    }
+
+    size_t kept = (size_t)b->count * TILE_PIXELS;
+    if (b->count) {
+        memcpy(pixels, b->pixels, kept);
+        memcpy(used, b->used, used_words(b->count) * sizeof(uint32_t));
+        memcpy(info, b->info, (size_t)b->count * sizeof(TileInfo));
+    }
+    memset(pixels + kept, 255, bytes - kept);
+
+    free(b->pixels);
+    free(b->used);
+    free(b->info);
+    b->pixels = pixels;
+    b->used = used;
+    b->info = info;
+    b->cap = cap;
+    return 0;
+}
+
+int tile_batch_init(TileBatch *b, int rows, int cols)
+{
+    memset(b, 0, sizeof(*b));
+    if (rows <= 0 || cols <= 0) return -1;
+    if (tile_batch_grow(b, rows * cols) != 0) return -1;
+
+    b->rows = rows;
+    b->cols = cols;
+    b->count = rows * cols;
+    return 0;
+}
+
+int tile_batch_append(TileBatch *b, int n)
+{
+    if (n < 0) return -1;
+    if (b->count + n > b->cap) {
+        int cap = b->cap ? b->cap : 64;
+        while (cap < b->count + n) cap *= 2;
+        if (tile_batch_grow(b, cap) != 0) return -1;
+    }
+
+    int first = b->count;
+    b->count += n;
+    b->rows = 1;
+    b->cols = b->count;
+    return first;
+}
+
+void tile_batch_free(TileBatch *b)
+{
+    free(b->pixels);
+    free(b->used);
+    free(b->info);
+    memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,73 @@
+#ifndef TILE_BATCH_H
+#define TILE_BATCH_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+#define TILE_SIDE   28
+#define TILE_PIXELS (TILE_SIDE * TILE_SIDE)   // 784, one network input
+
+/* Where a tile was cut from. */
+typedef struct {
+    SDL_Rect src;   // ink bounding box, in the coordinates of the extracted area
+    int      ink;   // ink pixels of the letter
+} TileInfo;
+
+/* 28x28 tiles (0 = ink, 255 = paper) stored back to back in one
+ * GRAY_ALIGN-aligned buffer: tile k is pixels + k * TILE_PIXELS, so the
+ * whole batch can be handed to the network at once.
+ *  - grid batch : rows x cols tiles, tile of cell (r, c) at k = r * cols + c
+ *  - sequence   : rows = 1, tiles added with tile_batch_append
+ * Bit k of used is set when tile k holds a letter; the other tiles are
+ * blank with a zero TileInfo. A zeroed TileBatch is a valid empty
+ * sequence. */
+typedef struct {
+    Uint8    *pixels;
+    uint32_t *used;   // occupancy bitmap, 32 tiles per word
+    TileInfo *info;
+    int       rows, cols;
+    int       count, cap;
+} TileBatch;
+
+/* Grid batch of rows x cols blank, unused tiles.
+ * Returns 0 on success, -1 on error (b is then empty). */
+int tile_batch_init(TileBatch *b, int rows, int cols);
+
+/* Append n blank, unused tiles to a sequence (amortized growth).
+ * Returns the index of the first one, or -1 on error (b unchanged). */
+int tile_batch_append(TileBatch *b, int n);
+
+/* Free the arrays of b (the struct itself is the caller's) and leave it
+ * empty. */
+void tile_batch_free(TileBatch *b);
+
+static inline Uint8 *tile_pixels(const TileBatch *b, int k)
+{
+    return b->pixels + (size_t)k * TILE_PIXELS;
+}
+
+static inline int tile_used(const TileBatch *b, int k)
+{
+    return (int)((b->used[k >> 5] >> (k & 31)) & 1u);
+}
+
+static inline void tile_set_used(TileBatch *b, int k)
+{
+    b->used[k >> 5] |= 1u << (k & 31);
+}
+
+/* Same as tile_set_used for tiles filled on several threads: neighbour
+ * tiles share a bitmap word. */
+static inline void tile_set_used_atomic(TileBatch *b, int k)
+{
+    __atomic_fetch_or(&b->used[k >> 5], 1u << (k & 31), __ATOMIC_RELAXED);
+}
+
+/* Tile of cell (r, c) of a grid batch, NULL if the cell is empty. */
+static inline const Uint8 *tile_cell(const TileBatch *b, int r, int c)
+{
+    int k = r * b->cols + c;
+    return tile_used(b, k) ? tile_pixels(b, k) : NULL;
+}
+
+#endif